@@ -0,0 +1,14 @@
+#!/usr/bin/env bash
+# Builds the FGL BST with each node lock backend and reports node size and
+# throughput per backend.
+for lock in mutex spin ticket futex
+do
+   rm -rf out/$lock
+   cmake -B out/$lock -DCMAKE_BUILD_TYPE=Release -DCMAKE_MAKE_PROGRAM=make -DCMAKE_C_COMPILER=gcc -DBST_FGL_LOCK=$lock > /dev/null
+   cmake --build out/$lock --target all > /dev/null
+   ./out/$lock/bst -i | grep FGL
+   for j in 1 2 4 8
+   do
+      ./out/$lock/bst -n 100000 -l -s insert -s write -s read -s read_write -r 5 -t $j
+   done
+done
@@ -0,0 +1,284 @@
+/*
+Universidade Aberta
+File: bst_arena.c
+Author: Hugo Gonçalves, 2100562
+
+Node arena with transparent huge page support
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "include/bst_arena.h"
+
+#define BST_ARENA_CLASSES (BST_ARENA_MAX_SIZE / BST_ARENA_ALIGN)
+
+// Most regions tracked for bst_arena_huge_bytes(), the node arena plus one
+// per live node pool
+#define BST_ARENA_MAX_REGIONS 64
+
+// Largest and smallest address space reservation for the node arena, nodes
+// are carved from it in BST_ARENA_HUGE_PAGE chunks
+#define BST_ARENA_MAX_RESERVE ((size_t)64 << 30)
+#define BST_ARENA_MIN_RESERVE ((size_t)1 << 30)
+
+/**
+ * Nodes of one size. Released nodes hold the next released node in their
+ * first bytes.
+ */
+typedef struct bst_arena_class {
+    pthread_mutex_t mtx;
+    void *free;
+    char *cursor;
+    char *limit;
+} bst_arena_class_t;
+
+typedef struct bst_arena_region {
+    char *base;
+    size_t size;
+} bst_arena_region_t;
+
+static _Atomic bst_arena_mode_t mode = BST_ARENA_MALLOC;
+
+static pthread_mutex_t regions_mtx = PTHREAD_MUTEX_INITIALIZER;
+static bst_arena_region_t regions[BST_ARENA_MAX_REGIONS];
+
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+static char *arena_base = NULL;
+static size_t arena_size = 0;
+static atomic_size_t arena_used = 0;
+
+static bst_arena_class_t classes[BST_ARENA_CLASSES];
+
+void bst_arena_set_mode(const bst_arena_mode_t mode_) { mode = mode_; }
+
+bst_arena_mode_t bst_arena_mode(void) { return mode; }
+
+static void bst_arena_region_add(char *base, const size_t size) {
+    pthread_mutex_lock(&regions_mtx);
+
+    for (int i = 0; i < BST_ARENA_MAX_REGIONS; i++) {
+        if (regions[i].base == NULL) {
+            regions[i].base = base;
+            regions[i].size = size;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&regions_mtx);
+}
+
+static void bst_arena_region_remove(const char *base) {
+    pthread_mutex_lock(&regions_mtx);
+
+    for (int i = 0; i < BST_ARENA_MAX_REGIONS; i++) {
+        if (regions[i].base == base) {
+            regions[i].base = NULL;
+            regions[i].size = 0;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&regions_mtx);
+}
+
+void *bst_arena_reserve(const size_t size, const int prot) {
+    const int huge = mode == BST_ARENA_HUGEPAGES;
+
+    // Over reserve by a huge page so the region can be aligned to one
+    const size_t total = huge ? size + BST_ARENA_HUGE_PAGE : size;
+
+    char *base = mmap(NULL, total, prot,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (huge) {
+        char *aligned =
+            (char *)(((uintptr_t)base + BST_ARENA_HUGE_PAGE - 1) &
+                     ~((uintptr_t)BST_ARENA_HUGE_PAGE - 1));
+
+        if (aligned > base) {
+            munmap(base, aligned - base);
+        }
+
+        if (base + total > aligned + size) {
+            munmap(aligned + size, base + total - (aligned + size));
+        }
+
+        base = aligned;
+
+        // Fails with EINVAL without transparent huge page support, the
+        // region then simply stays on normal pages
+        madvise(base, size, MADV_HUGEPAGE);
+    }
+
+    bst_arena_region_add(base, size);
+
+    return base;
+}
+
+void bst_arena_unreserve(void *base, const size_t size) {
+    if (base == NULL) {
+        return;
+    }
+
+    bst_arena_region_remove(base);
+    munmap(base, size);
+}
+
+static void bst_arena_init(void) {
+    for (int i = 0; i < BST_ARENA_CLASSES; i++) {
+        pthread_mutex_init(&classes[i].mtx, NULL);
+    }
+
+    for (size_t size = BST_ARENA_MAX_RESERVE; size >= BST_ARENA_MIN_RESERVE;
+         size /= 2) {
+        arena_base = bst_arena_reserve(size, PROT_READ | PROT_WRITE);
+
+        if (arena_base != NULL) {
+            arena_size = size;
+            return;
+        }
+    }
+}
+
+// Hands out the next BST_ARENA_HUGE_PAGE chunk of the node arena
+static char *bst_arena_chunk(void) {
+    const size_t offset = atomic_fetch_add(&arena_used, BST_ARENA_HUGE_PAGE);
+
+    if (arena_base == NULL || offset + BST_ARENA_HUGE_PAGE > arena_size) {
+        return NULL;
+    }
+
+    return arena_base + offset;
+}
+
+void *bst_arena_alloc(const size_t size) {
+    if (mode == BST_ARENA_MALLOC || size == 0 || size > BST_ARENA_MAX_SIZE) {
+        return malloc(size);
+    }
+
+    pthread_once(&arena_once, bst_arena_init);
+
+    const size_t c = (size - 1) / BST_ARENA_ALIGN;
+    const size_t class_size = (c + 1) * BST_ARENA_ALIGN;
+    bst_arena_class_t *cls = &classes[c];
+    void *ptr = NULL;
+
+    pthread_mutex_lock(&cls->mtx);
+
+    if (cls->free != NULL) {
+        ptr = cls->free;
+        cls->free = *(void **)ptr;
+    } else {
+        if (cls->cursor == NULL || cls->cursor + class_size > cls->limit) {
+            char *chunk = bst_arena_chunk();
+
+            if (chunk != NULL) {
+                cls->cursor = chunk;
+                cls->limit = chunk + BST_ARENA_HUGE_PAGE;
+            }
+        }
+
+        if (cls->cursor != NULL && cls->cursor + class_size <= cls->limit) {
+            ptr = cls->cursor;
+            cls->cursor += class_size;
+        }
+    }
+
+    pthread_mutex_unlock(&cls->mtx);
+
+    return ptr;
+}
+
+void bst_arena_free(void *ptr, const size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (mode == BST_ARENA_MALLOC || size == 0 || size > BST_ARENA_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+
+    bst_arena_class_t *cls = &classes[(size - 1) / BST_ARENA_ALIGN];
+
+    pthread_mutex_lock(&cls->mtx);
+    *(void **)ptr = cls->free;
+    cls->free = ptr;
+    pthread_mutex_unlock(&cls->mtx);
+}
+
+// Returns 1 if [start, end) overlaps an arena region, regions_mtx held
+static int bst_arena_in_region(const uintptr_t start, const uintptr_t end) {
+    for (int i = 0; i < BST_ARENA_MAX_REGIONS; i++) {
+        const uintptr_t base = (uintptr_t)regions[i].base;
+
+        if (base != 0 && start < base + regions[i].size && end > base) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+size_t bst_arena_huge_bytes(void) {
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+
+    if (smaps == NULL) {
+        return 0;
+    }
+
+    char line[512];
+    size_t kb = 0;
+    int in_region = 0;
+
+    pthread_mutex_lock(&regions_mtx);
+
+    while (fgets(line, sizeof(line), smaps) != NULL) {
+        uintptr_t start, end;
+        size_t value;
+
+        // Mapping headers start with <start>-<end>, field lines with a name
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            in_region = bst_arena_in_region(start, end);
+        } else if (in_region &&
+                   sscanf(line, "AnonHugePages: %zu kB", &value) == 1) {
+            kb += value;
+        }
+    }
+
+    pthread_mutex_unlock(&regions_mtx);
+
+    fclose(smaps);
+
+    return kb * 1024;
+}
@@ -28,60 +28,229 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
 FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 IN THE SOFTWARE.
 */
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "../include/bst_arena.h"
 #include "../include/bst_common.h"
+#include "../include/bst_snapshot.h"
 #include "include/bst_at.h"
 
 #include <unistd.h>
 
+// Hazard pointer slots
+enum { HP_PARENT = 0, HP_CURRENT = 1, HP_SUCCESSOR = 2 };
+
+// Hazard pointer record states. A record is ACTIVE while owned by a thread,
+// FREE when it can be adopted by another thread and ORPHANED when the BST was
+// freed while a thread still owned it, the owner frees it on release.
+enum { HP_FREE = 0, HP_ACTIVE = 1, HP_ORPHANED = 2 };
+
+// Record owned by the calling thread, cached across operations
+static _Thread_local bst_at_hp_record_t *hp_local = NULL;
+
+static pthread_key_t hp_key;
+static pthread_once_t hp_key_once = PTHREAD_ONCE_INIT;
+
+static void hp_record_destroy(bst_at_hp_record_t *rec) {
+    free(rec->retired);
+    free(rec->snapshot);
+    free(rec);
+}
+
 // Hazard pointers handling funtions
-static hazard_pointer_t *acquire_hazard_pointer(bst_at_t *bst) {
-    hazard_pointer_t *hp = malloc(sizeof(hazard_pointer_t));
-    atomic_store(&hp->pointer, NULL);
-    hp->next = NULL;
+static void hp_record_release(bst_at_hp_record_t *rec) {
+    for (int i = 0; i < BST_AT_HP_SLOTS; i++) {
+        atomic_store(&rec->slots[i], NULL);
+    }
+
+    // Retired nodes stay in the record, the next owner or bst_at_free will
+    // reclaim them.
+    if (atomic_exchange(&rec->state, HP_FREE) == HP_ORPHANED) {
+        hp_record_destroy(rec);
+    }
+}
+
+static void hp_thread_exit(void *rec) {
+    hp_record_release(rec);
+}
 
-    // Insert into global hazard pointer list
-    hazard_pointer_t *old_head = NULL;
+static void hp_key_create(void) { pthread_key_create(&hp_key, hp_thread_exit); }
+
+static bst_at_hp_record_t *hp_record_acquire(bst_at_t *bst) {
+    pthread_once(&hp_key_once, hp_key_create);
+
+    // Adopt a record released by a thread that is gone
+    bst_at_hp_record_t *rec = atomic_load(&bst->hp_records);
+    while (rec != NULL) {
+        int expected = HP_FREE;
+        if (atomic_load(&rec->state) == HP_FREE &&
+            atomic_compare_exchange_strong(&rec->state, &expected,
+                                           HP_ACTIVE)) {
+            return rec;
+        }
+        rec = rec->next;
+    }
+
+    rec = calloc(1, sizeof(bst_at_hp_record_t));
+    if (rec == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < BST_AT_HP_SLOTS; i++) {
+        atomic_store(&rec->slots[i], NULL);
+    }
+    atomic_store(&rec->state, HP_ACTIVE);
+    rec->bst = bst;
+
+    // Insert into the BST hazard pointer record list
+    bst_at_hp_record_t *old_head = NULL;
     do {
-        old_head = atomic_load(&bst->hazard_pointers);
-        hp->next = old_head;
-    } while (
-        !atomic_compare_exchange_weak(&bst->hazard_pointers, &old_head, hp));
+        old_head = atomic_load(&bst->hp_records);
+        rec->next = old_head;
+    } while (!atomic_compare_exchange_weak(&bst->hp_records, &old_head, rec));
 
-    return hp;
+    atomic_fetch_add(&bst->hp_record_count, 1);
+
+    return rec;
 }
 
-static void set_hazard_pointer(hazard_pointer_t *hp, bst_at_node_t *node) {
-    atomic_store(&hp->pointer, node);
+// Returns the calling thread record for bst, registering one on first use.
+static bst_at_hp_record_t *hp_record(bst_at_t *bst) {
+    bst_at_hp_record_t *rec = hp_local;
+
+    if (rec != NULL && rec->bst == bst &&
+        atomic_load(&rec->state) == HP_ACTIVE) {
+        return rec;
+    }
+
+    if (rec != NULL) {
+        hp_record_release(rec);
+    }
+
+    rec = hp_record_acquire(bst);
+    hp_local = rec;
+    pthread_setspecific(hp_key, rec);
+
+    return rec;
 }
 
-static void release_hazard_pointer(hazard_pointer_t *hp) {
-    atomic_store(&hp->pointer, NULL);
+static void set_hazard_pointer(bst_at_hp_record_t *hp, const int slot,
+                               bst_at_node_t *node) {
+    atomic_store(&hp->slots[slot], node);
 }
 
-static bool is_node_hazardous(bst_at_t *bst, bst_at_node_t *node) {
-    hazard_pointer_t *current = atomic_load(&bst->hazard_pointers);
-    while (current != NULL) {
-        if (atomic_load(&current->pointer) == node) {
-            return true;
+static void release_hazard_pointers(bst_at_hp_record_t *hp) {
+    for (int i = 0; i < BST_AT_HP_SLOTS; i++) {
+        atomic_store(&hp->slots[i], NULL);
+    }
+}
+
+static size_t hp_hash(const bst_at_node_t *node, const int bits) {
+    return (size_t)(((uint64_t)(uintptr_t)node * 0x9E3779B97F4A7C15ull) >>
+                    (64 - bits));
+}
+
+// Frees every retired node that is not protected by a hazard pointer. The
+// hazard pointers are snapshotted into an open addressing hash set, so each
+// retired node costs O(1) to check.
+static void hp_scan(bst_at_t *bst, bst_at_hp_record_t *rec) {
+    bst_at_hp_record_t *head = atomic_load(&bst->hp_records);
+
+    size_t records = 0;
+    for (const bst_at_hp_record_t *r = head; r != NULL; r = r->next) {
+        records++;
+    }
+
+    int bits = 4;
+    while (((size_t)1 << bits) < 2 * records * BST_AT_HP_SLOTS) {
+        bits++;
+    }
+    const size_t buckets = (size_t)1 << bits;
+
+    if (rec->snapshot_capacity < buckets) {
+        bst_at_node_t **snapshot =
+            realloc(rec->snapshot, buckets * sizeof(bst_at_node_t *));
+        if (snapshot == NULL) {
+            return; // Try again on the next retire
         }
-        current = current->next;
+        rec->snapshot = snapshot;
+        rec->snapshot_capacity = buckets;
     }
-    return false;
+
+    const size_t mask = buckets - 1;
+    memset(rec->snapshot, 0, buckets * sizeof(bst_at_node_t *));
+
+    for (bst_at_hp_record_t *r = head; r != NULL; r = r->next) {
+        for (int i = 0; i < BST_AT_HP_SLOTS; i++) {
+            bst_at_node_t *node = atomic_load(&r->slots[i]);
+            if (node == NULL) {
+                continue;
+            }
+
+            size_t h = hp_hash(node, bits);
+            while (rec->snapshot[h] != NULL && rec->snapshot[h] != node) {
+                h = (h + 1) & mask;
+            }
+            rec->snapshot[h] = node;
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < rec->retired_count; i++) {
+        bst_at_node_t *node = rec->retired[i];
+
+        size_t h = hp_hash(node, bits);
+        while (rec->snapshot[h] != NULL && rec->snapshot[h] != node) {
+            h = (h + 1) & mask;
+        }
+
+        if (rec->snapshot[h] == node) {
+            rec->retired[kept++] = node; // Still hazardous, defer
+        } else {
+            bst_arena_free(node, sizeof(bst_at_node_t));
+            atomic_fetch_add(&bst->frees, 1);
+        }
+    }
+
+    rec->retired_count = kept;
 }
 
-static void retire_node(bst_at_t *bst, bst_at_node_t *node) {
-    if (!is_node_hazardous(bst, node)) {
-        free(node);
+static void retire_node(bst_at_t *bst, bst_at_hp_record_t *rec,
+                        bst_at_node_t *node) {
+    if (rec->retired_count == rec->retired_capacity) {
+        const size_t capacity =
+            rec->retired_capacity == 0 ? 16 : rec->retired_capacity * 2;
+        bst_at_node_t **retired =
+            realloc(rec->retired, capacity * sizeof(bst_at_node_t *));
+
+        if (retired == NULL) {
+            hp_scan(bst, rec);
+            if (rec->retired_count == rec->retired_capacity) {
+                return; // Out of memory, the node is leaked
+            }
+        } else {
+            rec->retired = retired;
+            rec->retired_capacity = capacity;
+        }
+    }
+
+    rec->retired[rec->retired_count++] = node;
+
+    const size_t threshold = BST_AT_HP_SCAN_FACTOR * BST_AT_HP_SLOTS *
+                             atomic_load(&bst->hp_record_count);
+    if (rec->retired_count >= threshold) {
+        hp_scan(bst, rec);
     }
 }
 
-static bst_at_node_t *bst_at_node_new(const int64_t value) {
-    bst_at_node_t *node = malloc(sizeof(bst_at_node_t));
+static bst_at_node_t *bst_at_node_new(bst_at_t *bst, const int64_t value) {
+    bst_at_node_t *node = bst_arena_alloc(sizeof(bst_at_node_t));
 
     if (node) {
+        atomic_fetch_add(&bst->allocs, 1);
         node->value = value;
         atomic_store(&node->left, NULL);
         atomic_store(&node->right, NULL);
@@ -96,7 +265,10 @@ bst_at_t *bst_at_new(BST_ERROR *err) {
     if (bst) {
         atomic_store(&bst->count, 0);
         atomic_store(&bst->root, NULL);
-        atomic_store(&bst->hazard_pointers, NULL);
+        atomic_store(&bst->hp_records, NULL);
+        atomic_store(&bst->hp_record_count, 0);
+        atomic_store(&bst->allocs, 0);
+        atomic_store(&bst->frees, 0);
 
         if (err) {
             *err = SUCCESS;
@@ -115,40 +287,47 @@ BST_ERROR bst_at_add(bst_at_t **bst, const int64_t value) {
 
     bst_at_t *bst_ = *bst;
 
-    bst_at_node_t *new_node = bst_at_node_new(value);
+    bst_at_hp_record_t *hp = hp_record(bst_);
+
+    if (hp == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    bst_at_node_t *new_node = bst_at_node_new(bst_, value);
+
+    if (new_node == NULL) {
+        return MALLOC_FAILURE;
+    }
 
     while (1) {
         bst_at_node_t *parent = NULL;
         bst_at_node_t *current = atomic_load(&bst_->root);
-        hazard_pointer_t *hp_parent = acquire_hazard_pointer(bst_);
-        hazard_pointer_t *hp_current = acquire_hazard_pointer(bst_);
 
         while (current != NULL) {
-            set_hazard_pointer(hp_current, current);
+            set_hazard_pointer(hp, HP_CURRENT, current);
 
             if (!compare(value, current->value)) {
-                release_hazard_pointer(hp_parent);
-                release_hazard_pointer(hp_current);
-                free(new_node);
+                release_hazard_pointers(hp);
+                bst_arena_free(new_node, sizeof(bst_at_node_t));
+                atomic_fetch_add(&bst_->frees, 1);
                 return VALUE_EXISTS;
             }
 
             parent = current;
-            set_hazard_pointer(hp_parent, parent);
+            set_hazard_pointer(hp, HP_PARENT, parent);
 
             if (compare(value, current->value) < 0) {
                 current = atomic_load(&current->left);
             } else {
                 current = atomic_load(&current->right);
             }
-            set_hazard_pointer(hp_current, current);
+            set_hazard_pointer(hp, HP_CURRENT, current);
         }
 
         if (parent == NULL) {
             if (atomic_compare_exchange_weak(&bst_->root, &current,
                                                new_node)) {
-                release_hazard_pointer(hp_parent);
-                release_hazard_pointer(hp_current);
+                release_hazard_pointers(hp);
                 atomic_fetch_add(&bst_->count, 1);
                 return SUCCESS;
             }
@@ -156,23 +335,20 @@ BST_ERROR bst_at_add(bst_at_t **bst, const int64_t value) {
             if (compare(value, parent->value) < 0) {
                 if (atomic_compare_exchange_weak(&parent->left, &current,
                                                    new_node)) {
-                    release_hazard_pointer(hp_parent);
-                    release_hazard_pointer(hp_current);
+                    release_hazard_pointers(hp);
                     atomic_fetch_add(&bst_->count, 1);
                     return SUCCESS;
                 }
             } else {
                 if (atomic_compare_exchange_weak(&parent->right, &current,
                                                    new_node)) {
-                    release_hazard_pointer(hp_parent);
-                    release_hazard_pointer(hp_current);
+                    release_hazard_pointers(hp);
                     atomic_fetch_add(&bst_->count, 1);
                     return SUCCESS;
                 }
             }
         }
-        release_hazard_pointer(hp_parent);
-        release_hazard_pointer(hp_current);
+        release_hazard_pointers(hp);
     }
 }
 
@@ -183,11 +359,16 @@ BST_ERROR bst_at_search(bst_at_t **bst, const int64_t value) {
 
     bst_at_t *bst_ = *bst;
 
-    hazard_pointer_t *hp = acquire_hazard_pointer(bst_);
+    bst_at_hp_record_t *hp = hp_record(bst_);
+
+    if (hp == NULL) {
+        return MALLOC_FAILURE;
+    }
+
     bst_at_node_t *current = atomic_load(&bst_->root);
 
     while (current != NULL) {
-        set_hazard_pointer(hp, current);
+        set_hazard_pointer(hp, HP_CURRENT, current);
 
         int64_t cmp = compare(value, current->value);
 
@@ -196,12 +377,12 @@ BST_ERROR bst_at_search(bst_at_t **bst, const int64_t value) {
         } else if (cmp > 0) {
             current = atomic_load(&current->right);
         } else {
-            release_hazard_pointer(hp);
+            release_hazard_pointers(hp);
             return SUCCESS;
         }
     }
 
-    release_hazard_pointer(hp);
+    release_hazard_pointers(hp);
 
     return VALUE_NONEXISTENT;
 }
@@ -213,24 +394,29 @@ BST_ERROR bst_at_min(bst_at_t **bst, int64_t *value) {
 
     bst_at_t *bst_ = *bst;
 
-    hazard_pointer_t *hp = acquire_hazard_pointer(bst_);
+    bst_at_hp_record_t *hp = hp_record(bst_);
+
+    if (hp == NULL) {
+        return MALLOC_FAILURE;
+    }
+
     bst_at_node_t *current = atomic_load(&bst_->root);
 
     if (current == NULL) {
-        release_hazard_pointer(hp);
+        release_hazard_pointers(hp);
         return BST_EMPTY;
     }
 
     while (atomic_load(&current->left) != NULL) {
-        set_hazard_pointer(hp, current);
+        set_hazard_pointer(hp, HP_CURRENT, current);
         current = atomic_load(&current->left);
     }
 
-    set_hazard_pointer(hp, current);
+    set_hazard_pointer(hp, HP_CURRENT, current);
     if (value) {
         *value = current->value;
     }
-    release_hazard_pointer(hp);
+    release_hazard_pointers(hp);
 
     return SUCCESS;
 }
@@ -242,24 +428,29 @@ BST_ERROR bst_at_max(bst_at_t **bst, int64_t *value) {
 
     bst_at_t *bst_ = *bst;
 
-    hazard_pointer_t *hp = acquire_hazard_pointer(bst_);
+    bst_at_hp_record_t *hp = hp_record(bst_);
+
+    if (hp == NULL) {
+        return MALLOC_FAILURE;
+    }
+
     bst_at_node_t *current = atomic_load(&bst_->root);
 
     if (current == NULL) {
-        release_hazard_pointer(hp);
+        release_hazard_pointers(hp);
         return BST_EMPTY;
     }
 
     while (atomic_load(&current->right) != NULL) {
-        set_hazard_pointer(hp, current);
+        set_hazard_pointer(hp, HP_CURRENT, current);
         current = atomic_load(&current->right);
     }
 
-    set_hazard_pointer(hp, current);
+    set_hazard_pointer(hp, HP_CURRENT, current);
     if (value) {
         *value = current->value;
     }
-    release_hazard_pointer(hp);
+    release_hazard_pointers(hp);
 
     return SUCCESS;
 }
@@ -301,36 +492,36 @@ BST_ERROR bst_at_delete(bst_at_t **bst, const int64_t value) {
 
     bst_at_t *bst_ = *bst;
 
-    hazard_pointer_t *hp_parent = acquire_hazard_pointer(bst_);
-    hazard_pointer_t *hp_current = acquire_hazard_pointer(bst_);
-    hazard_pointer_t *hp_successor = acquire_hazard_pointer(bst_);
+    bst_at_hp_record_t *hp = hp_record(bst_);
+
+    if (hp == NULL) {
+        return MALLOC_FAILURE;
+    }
 
     while (1) {
         bst_at_node_t *parent = NULL;
         bst_at_node_t *current = atomic_load(&bst_->root);
 
         while (current != NULL) {
-            set_hazard_pointer(hp_current, current);
+            set_hazard_pointer(hp, HP_CURRENT, current);
 
             if (!compare(value, current->value)) {
                 break;
             }
 
             parent = current;
-            set_hazard_pointer(hp_parent, parent);
+            set_hazard_pointer(hp, HP_PARENT, parent);
 
             if (compare(value, current->value) < 0) {
                 current = atomic_load(&current->left);
             } else {
                 current = atomic_load(&current->right);
             }
-            set_hazard_pointer(hp_current, current);
+            set_hazard_pointer(hp, HP_CURRENT, current);
         }
 
         if (current == NULL) {
-            release_hazard_pointer(hp_parent);
-            release_hazard_pointer(hp_current);
-            release_hazard_pointer(hp_successor);
+            release_hazard_pointers(hp);
             return VALUE_NONEXISTENT;
         }
 
@@ -342,22 +533,20 @@ BST_ERROR bst_at_delete(bst_at_t **bst, const int64_t value) {
                 left_child != NULL ? left_child : right_child;
 
             if (bst_replace_node(bst_, parent, current, child)) {
-                release_hazard_pointer(hp_parent);
-                release_hazard_pointer(hp_current);
-                release_hazard_pointer(hp_successor);
-                retire_node(bst_, current);
+                release_hazard_pointers(hp);
+                retire_node(bst_, hp, current);
                 atomic_fetch_sub(&bst_->count, 1);
                 return SUCCESS;
             }
         } else {
             bst_at_node_t *successor_parent = current;
             bst_at_node_t *successor = right_child;
-            set_hazard_pointer(hp_successor, successor);
+            set_hazard_pointer(hp, HP_SUCCESSOR, successor);
 
             while (atomic_load(&successor->left) != NULL) {
                 successor_parent = successor;
                 successor = atomic_load(&successor->left);
-                set_hazard_pointer(hp_successor, successor);
+                set_hazard_pointer(hp, HP_SUCCESSOR, successor);
             }
 
             const int64_t successor_value = successor->value;
@@ -374,11 +563,9 @@ BST_ERROR bst_at_delete(bst_at_t **bst, const int64_t value) {
                              atomic_load(&successor->right));
             }
 
-            release_hazard_pointer(hp_parent);
-            release_hazard_pointer(hp_current);
-            release_hazard_pointer(hp_successor);
+            release_hazard_pointers(hp);
 
-            retire_node(bst_, successor);
+            retire_node(bst_, hp, successor);
             atomic_fetch_sub(&bst_->count, 1);
             return SUCCESS;
         }
@@ -389,15 +576,208 @@ static void bst_at_free_node(bst_at_node_t *root) {
     if (root) {
         bst_at_free_node(root->left);
         bst_at_free_node(root->right);
-        free(root);
+        bst_arena_free(root, sizeof(bst_at_node_t));
+    }
+}
+
+// Reclaims every retired node and releases the hazard pointer records. Records
+// still owned by a live thread are orphaned and freed by their owner.
+static void bst_at_free_hp(bst_at_t *bst) {
+    bst_at_hp_record_t *rec = atomic_load(&bst->hp_records);
+
+    while (rec != NULL) {
+        bst_at_hp_record_t *next = rec->next;
+
+        for (size_t i = 0; i < rec->retired_count; i++) {
+            bst_arena_free(rec->retired[i], sizeof(bst_at_node_t));
+        }
+        rec->retired_count = 0;
+
+        if (rec == hp_local) {
+            hp_local = NULL;
+            pthread_setspecific(hp_key, NULL);
+            hp_record_destroy(rec);
+        } else if (atomic_exchange(&rec->state, HP_ORPHANED) == HP_FREE) {
+            hp_record_destroy(rec);
+        }
+
+        rec = next;
+    }
+
+    atomic_store(&bst->hp_records, NULL);
+}
+
+BST_ERROR bst_at_memory_stats(bst_at_t **bst, bst_memory_stats_t *stats) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
     }
+
+    bst_at_t *bst_ = *bst;
+
+    if (stats == NULL) {
+        return SUCCESS;
+    }
+
+    const size_t allocs = atomic_load(&bst_->allocs);
+    const size_t frees = atomic_load(&bst_->frees);
+
+    stats->live_nodes = allocs - frees;
+    stats->node_bytes = stats->live_nodes * sizeof(bst_at_node_t);
+    stats->lock_bytes = 0;
+    stats->meta_bytes = sizeof(bst_at_t);
+    stats->pending_nodes = 0;
+
+    for (const bst_at_hp_record_t *rec = atomic_load(&bst_->hp_records);
+         rec != NULL; rec = rec->next) {
+        stats->meta_bytes +=
+            sizeof(bst_at_hp_record_t) +
+            rec->retired_capacity * sizeof(bst_at_node_t *) +
+            rec->snapshot_capacity * sizeof(bst_at_node_t *);
+        stats->pending_nodes += rec->retired_count;
+    }
+
+    stats->pending_bytes = stats->pending_nodes * sizeof(bst_at_node_t);
+    stats->allocs = allocs;
+    stats->frees = frees;
+
+    return SUCCESS;
 }
 
-static void bst_at_free_hp(hazard_pointer_t *hp) {
-    if (hp) {
-        bst_at_free_hp(hp->next);
-        free(hp);
+// Appends every value in order, returns 0 if the traversal stack can't grow
+static int bst_at_save_nodes(bst_at_t *bst, bst_snapshot_writer_t *writer) {
+    size_t capacity = 64, top = 0;
+    bst_at_node_t **stack = malloc(capacity * sizeof(bst_at_node_t *));
+
+    if (stack == NULL) {
+        return 0;
     }
+
+    bst_at_node_t *node = atomic_load(&bst->root);
+
+    while (node != NULL || top > 0) {
+        while (node != NULL) {
+            if (top == capacity) {
+                bst_at_node_t **s =
+                    realloc(stack, 2 * capacity * sizeof(bst_at_node_t *));
+
+                if (s == NULL) {
+                    free(stack);
+                    return 0;
+                }
+
+                stack = s;
+                capacity *= 2;
+            }
+
+            stack[top++] = node;
+            node = atomic_load(&node->left);
+        }
+
+        node = stack[--top];
+        bst_snapshot_writer_append(writer, node->value);
+        node = atomic_load(&node->right);
+    }
+
+    free(stack);
+
+    return 1;
+}
+
+BST_ERROR bst_at_save(bst_at_t **bst, const char *path) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_at_t *bst_ = *bst;
+    bst_snapshot_writer_t writer;
+
+    BST_ERROR err = bst_snapshot_writer_open(&writer, path);
+
+    if (!IS_SUCCESS(err)) {
+        return err;
+    }
+
+    const int saved = bst_at_save_nodes(bst_, &writer);
+
+    err = bst_snapshot_writer_close(&writer, !saved);
+
+    return saved ? err : MALLOC_FAILURE;
+}
+
+// Builds a balanced subtree from the sorted keys [lo, hi), the middle key is
+// the subtree root. Stops allocating after the first failure, err is set and
+// the partial tree stays linked so it can be freed.
+static bst_at_node_t *bst_at_build(bst_at_t *bst, const int64_t *keys,
+                                   const size_t lo, const size_t hi,
+                                   BST_ERROR *err) {
+    if (lo >= hi || !IS_SUCCESS(*err)) {
+        return NULL;
+    }
+
+    const size_t mid = lo + (hi - lo) / 2;
+    bst_at_node_t *node = bst_at_node_new(bst, keys[mid]);
+
+    if (node == NULL) {
+        *err = MALLOC_FAILURE;
+        return NULL;
+    }
+
+    bst_at_node_t *left = bst_at_build(bst, keys, lo, mid, err);
+    bst_at_node_t *right = bst_at_build(bst, keys, mid + 1, hi, err);
+
+    atomic_store(&node->left, left);
+    atomic_store(&node->right, right);
+
+    return node;
+}
+
+bst_at_t *bst_at_load(const char *path, BST_ERROR *err) {
+    bst_snapshot_t snap;
+    BST_ERROR e = bst_snapshot_map(path, &snap);
+
+    if (!IS_SUCCESS(e)) {
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst_at_t *bst = bst_at_new(&e);
+
+    if (bst == NULL) {
+        bst_snapshot_unmap(&snap);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    const size_t count = snap.count;
+    bst_at_node_t *root = bst_at_build(bst, snap.keys, 0, count, &e);
+    bst_snapshot_unmap(&snap);
+
+    atomic_store(&bst->root, root);
+
+    if (!IS_SUCCESS(e)) {
+        bst_at_free(&bst);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    atomic_store(&bst->count, count);
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return bst;
 }
 
 BST_ERROR bst_at_free(bst_at_t **bst) {
@@ -409,8 +789,66 @@ BST_ERROR bst_at_free(bst_at_t **bst) {
     *bst = NULL;
 
     bst_at_free_node(atomic_load(&bst_->root));
-    bst_at_free_hp(atomic_load(&bst_->hazard_pointers));
+    bst_at_free_hp(bst_);
     free(bst_);
 
     return 0;
-}
\ No newline at end of file
+}
+
+// The bst_at_engine wrappers, see bst_engine.h
+static void *bst_at_engine_new(const bst_engine_config_t *config,
+                               BST_ERROR *err) {
+    (void)config;
+    return bst_at_new(err);
+}
+
+static BST_ERROR bst_at_engine_free(void **bst) {
+    return bst_at_free((bst_at_t **)bst);
+}
+
+static BST_ERROR bst_at_engine_add(void **bst, const int64_t value) {
+    return bst_at_add((bst_at_t **)bst, value);
+}
+
+static BST_ERROR bst_at_engine_search(void **bst, const int64_t value) {
+    return bst_at_search((bst_at_t **)bst, value);
+}
+
+static BST_ERROR bst_at_engine_min(void **bst, int64_t *value) {
+    return bst_at_min((bst_at_t **)bst, value);
+}
+
+static BST_ERROR bst_at_engine_max(void **bst, int64_t *value) {
+    return bst_at_max((bst_at_t **)bst, value);
+}
+
+static BST_ERROR bst_at_engine_delete(void **bst, const int64_t value) {
+    return bst_at_delete((bst_at_t **)bst, value);
+}
+
+static BST_ERROR bst_at_engine_count(void **bst, size_t *value) {
+    return bst_at_node_count((bst_at_t **)bst, value);
+}
+
+static BST_ERROR bst_at_engine_stats(void **bst, bst_engine_stats_t *stats) {
+    *stats = (bst_engine_stats_t){0};
+    return bst_at_memory_stats((bst_at_t **)bst, &stats->memory);
+}
+
+const bst_engine_ops bst_at_engine = {
+    .abi_version = BST_ENGINE_ABI_VERSION,
+    .name = "AT",
+    .threaded = 1,
+    .node_size = sizeof(bst_at_node_t),
+    .node_lock = "none",
+    .new = bst_at_engine_new,
+    .free = bst_at_engine_free,
+    .add = bst_at_engine_add,
+    .search = bst_at_engine_search,
+    .min = bst_at_engine_min,
+    .max = bst_at_engine_max,
+    .delete = bst_at_engine_delete,
+    .count = bst_at_engine_count,
+    .stats = bst_at_engine_stats,
+    .save_background = NULL,
+};
@@ -34,6 +34,7 @@ IN THE SOFTWARE.
 #include <stdint.h>
 
 #include "../../include/bst_common.h"
+#include "../../include/bst_engine.h"
 
 /**
  * Holds a tree node with pointers to both children nodes
@@ -44,10 +45,33 @@ typedef struct bst_at_node {
     _Atomic(struct bst_at_node *) right;
 } bst_at_node_t;
 
-typedef struct hazard_pointer {
-    _Atomic(bst_at_node_t *) pointer;
-    struct hazard_pointer *next;
-} hazard_pointer_t;
+/**
+ * Number of hazard pointer slots owned by each thread: parent, current and
+ * successor cover every traversal in the BST.
+ */
+#define BST_AT_HP_SLOTS 3
+
+/**
+ * A thread scans its retired list once it holds more than
+ * BST_AT_HP_SCAN_FACTOR times the total number of hazard pointer slots.
+ */
+#define BST_AT_HP_SCAN_FACTOR 2
+
+/**
+ * Per thread hazard pointer record. Registered once per thread and BST and
+ * reused by every operation, released to other threads when the owner exits.
+ */
+typedef struct bst_at_hp_record {
+    _Atomic(bst_at_node_t *) slots[BST_AT_HP_SLOTS];
+    atomic_int state;
+    struct bst_at *bst;
+    struct bst_at_hp_record *next;
+    bst_at_node_t **retired;
+    size_t retired_count;
+    size_t retired_capacity;
+    bst_at_node_t **snapshot;
+    size_t snapshot_capacity;
+} bst_at_hp_record_t;
 
 /**
  * The BST
@@ -55,7 +79,10 @@ typedef struct hazard_pointer {
 typedef struct bst_at {
     atomic_size_t count;
     _Atomic(bst_at_node_t *) root;
-    _Atomic(hazard_pointer_t *) hazard_pointers;
+    _Atomic(bst_at_hp_record_t *) hp_records;
+    atomic_size_t hp_record_count;
+    atomic_size_t allocs;
+    atomic_size_t frees;
 } bst_at_t;
 
 // Prototypes
@@ -177,6 +204,59 @@ BST_ERROR bst_at_node_count(bst_at_t **bst, size_t *value);
  */
 BST_ERROR bst_at_delete(bst_at_t **bst, int64_t value);
 
+/**
+ * Finds and places in stats the memory held by the BST - Thread safe,
+ * exact when no operation runs concurrently.
+ *
+ * @param bst   the BST to measure.
+ * @param stats pointer to store the memory stats, memory must be
+ * pre-allocated.
+ * @return
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * SUCCESS                  - stats are stored in stats, if stats is not NULL.
+ */
+BST_ERROR bst_at_memory_stats(bst_at_t **bst, bst_memory_stats_t *stats);
+
+/**
+ * Writes a snapshot of the BST to path, see bst_snapshot.h for the format. The
+ * snapshot is written to a temporary file and renamed over path once synced.
+ * Callers make sure no write operation is running.
+ *
+ * @param bst  the BST to save.
+ * @param path the snapshot file path.
+ * @return
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * MALLOC_FAILURE           - failed to allocate the traversal stack, path is
+ *  untouched.
+ *
+ * IO_FAILURE               - failed to write the snapshot, path is untouched.
+ *
+ * SUCCESS                  - snapshot written.
+ */
+BST_ERROR bst_at_save(bst_at_t **bst, const char *path);
+
+/**
+ * Creates a BST from a snapshot written by any bst_*_save(). The file is
+ * mapped and the tree is built balanced straight from the sorted keys, no
+ * comparisons are made.
+ *
+ * Check the bitmask of err for possible error combinations:
+ * SUCCESS          - pointer to BST is returned.
+ *
+ * MALLOC_FAILURE   - failed to allocate the BST or its nodes.
+ *
+ * IO_FAILURE       - failed to open or map path.
+ *
+ * INVALID_SNAPSHOT - path is not a valid snapshot.
+ *
+ * @param path the snapshot file path.
+ * @param err NULL (no effect) or allocated pointer to store any errors
+ * @return NULL or BST
+ */
+bst_at_t *bst_at_load(const char *path, BST_ERROR *err);
+
 /**
  * Frees a BST.
  *
@@ -187,4 +267,9 @@ BST_ERROR bst_at_delete(bst_at_t **bst, int64_t value);
  * SUCCESS                   - bst and all nodes freed.
  */
 BST_ERROR bst_at_free(bst_at_t **bst);
+
+/**
+ * The AT BST as a bst_engine_ops, see bst_engine.h.
+ */
+extern const bst_engine_ops bst_at_engine;
 #endif // BST_AT_H_
\ No newline at end of file
@@ -37,5 +37,6 @@ int64_t compare(const int64_t a, const int64_t b) {
     for (int i = 0; i < COMPARE_INSTRUCTIONS; i++)
         a0[i] = b0[i] + i + a0[i];
 
-    return a - b;
+    // a - b overflows for keys far apart, imported key sets have them
+    return (a > b) - (a < b);
 }
\ No newline at end of file
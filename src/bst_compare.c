@@ -0,0 +1,449 @@
+/*
+Universidade Aberta
+File: bst_compare.c
+Author: Hugo Gonçalves, 2100562
+
+Compares the -j results of a baseline and a candidate build
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/bst_common.h"
+#include "include/bst_result.h"
+
+const char *usage() {
+    const char *msg = "\
+Usage:\n\
+    $ bst-compare <options> <baseline> <candidate>\n\
+\n\
+Compares two files written by bst -j, run by run of every configuration:\n\
+the BST type, the strategy, the threads, the key distribution and the -n,\n\
+-o and -D options. Writes a CSV line per metric with the means, the change\n\
+and the p-value of Welch's t-test, exits with 2 when a metric regressed.\n\
+\n\
+Options:\n\
+\t-h Print this help message\n\
+\t-a <alpha> Significance level of the t-test, defaults to 0.05\n\
+\t-t <pct> Smallest change in percent reported as a regression or an improvement, defaults to 5\n\
+\n\
+Verdicts:\n\
+\tregression  - significantly worse by at least -t percent\n\
+\timprovement - significantly better by at least -t percent\n\
+\tsame        - no significant change of at least -t percent\n\
+\tunknown     - less than 2 runs on a side\n\
+\tmissing     - the configuration is only in one of the files\n\
+\n\
+Example:\n\
+    $ bst -n 100000 -r 10 -j base.jsonl\n\
+    $ bst -n 100000 -r 10 -j cand.jsonl\n\
+    $ bst-compare base.jsonl cand.jsonl\n\
+";
+    return msg;
+}
+
+// Fields that identify a configuration, runs of other -n, -o or -D are
+// different workloads
+#define KEYS 7
+static const char *keys[KEYS] = {"bst_type",   "strategy",
+                                  "threads",    "key_dist",
+                                  "requested_operations",
+                                  "write_prob", "duration"};
+
+// Compared metrics, higher_better is 0 for the latencies
+#define METRICS 11
+static const struct {
+    const char *name;
+    int higher_better;
+} metrics[METRICS] = {
+    {"ops_per_sec", 1},      {"add_p50_ns", 0},     {"add_p99_ns", 0},
+    {"search_p50_ns", 0},    {"search_p99_ns", 0},  {"min_p50_ns", 0},
+    {"min_p99_ns", 0},       {"max_p50_ns", 0},     {"max_p99_ns", 0},
+    {"delete_p50_ns", 0},    {"delete_p99_ns", 0},
+};
+
+/**
+ * Runs of one configuration in both files.
+ */
+typedef struct config {
+    char *key[KEYS];
+    bst_result_t *runs[2]; // of the baseline and the candidate
+    size_t count[2];
+} config_t;
+
+typedef struct configs {
+    config_t *configs;
+    size_t count;
+    size_t capacity;
+} configs_t;
+
+// Finds the configuration of a run, appending it when it is new
+config_t *find_config(configs_t *configs, const bst_result_t *run) {
+    const char *key[KEYS];
+
+    for (int i = 0; i < KEYS; i++) {
+        key[i] = bst_result_get(run, keys[i]);
+        if (key[i] == NULL) {
+            key[i] = "";
+        }
+    }
+
+    for (size_t i = 0; i < configs->count; i++) {
+        int equal = 1;
+
+        for (int j = 0; j < KEYS && equal; j++) {
+            equal = strcmp(configs->configs[i].key[j], key[j]) == 0;
+        }
+
+        if (equal) {
+            return &configs->configs[i];
+        }
+    }
+
+    if (configs->count == configs->capacity) {
+        const size_t capacity =
+            configs->capacity == 0 ? 16 : configs->capacity * 2;
+        config_t *grown =
+            realloc(configs->configs, capacity * sizeof(config_t));
+
+        if (grown == NULL) {
+            PANIC("Failed to allocate the configurations");
+        }
+
+        configs->configs = grown;
+        configs->capacity = capacity;
+    }
+
+    config_t *config = &configs->configs[configs->count++];
+    memset(config, 0, sizeof(config_t));
+
+    for (int i = 0; i < KEYS; i++) {
+        config->key[i] = strdup(key[i]);
+        if (config->key[i] == NULL) {
+            PANIC("Failed to allocate the configurations");
+        }
+    }
+
+    return config;
+}
+
+// Reads every run of a file into side 0 or 1 of the configurations
+void read_runs(configs_t *configs, const char *path, const int side) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        exit(1);
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    size_t number = 0;
+
+    while (getline(&line, &size, f) != -1) {
+        number++;
+
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+
+        bst_result_t run = {0};
+        const BST_ERROR err = bst_result_parse_json(line, &run);
+
+        if (err & MALLOC_FAILURE) {
+            PANIC("Failed to allocate the results");
+        } else if (err != SUCCESS) {
+            fprintf(stderr, "%s:%zu: not a result of bst -j\n", path, number);
+            exit(1);
+        }
+
+        config_t *config = find_config(configs, &run);
+        bst_result_t *runs = realloc(
+            config->runs[side], (config->count[side] + 1) * sizeof(run));
+
+        if (runs == NULL) {
+            PANIC("Failed to allocate the results");
+        }
+
+        runs[config->count[side]++] = run;
+        config->runs[side] = runs;
+    }
+
+    free(line);
+
+    if (ferror(f)) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        exit(1);
+    }
+
+    fclose(f);
+}
+
+/**
+ * Mean and sample variance of a metric over the runs that measured it.
+ *
+ * @return the number of runs that measured it
+ */
+size_t sample(const bst_result_t *runs, const size_t count, const char *name,
+              double *mean, double *variance) {
+    size_t n = 0;
+    double m = 0, m2 = 0;
+
+    // Welford's online algorithm
+    for (size_t i = 0; i < count; i++) {
+        const char *v = bst_result_get(&runs[i], name);
+        char *end;
+
+        if (v == NULL || *v == '\0') {
+            continue;
+        }
+
+        const double x = strtod(v, &end);
+        if (*end != '\0' || !isfinite(x)) {
+            continue;
+        }
+
+        n++;
+        const double d = x - m;
+        m += d / n;
+        m2 += d * (x - m);
+    }
+
+    *mean = m;
+    *variance = n > 1 ? m2 / (n - 1) : 0;
+    return n;
+}
+
+// Continued fraction of the incomplete beta function, Numerical Recipes 6.4
+double beta_cf(const double a, const double b, const double x) {
+    const double tiny = 1e-300;
+    double c = 1, d = 1 - (a + b) * x / (a + 1);
+
+    d = 1 / (fabs(d) < tiny ? tiny : d);
+    double h = d;
+
+    for (int m = 1; m <= 300; m++) {
+        const int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((a + m2 - 1) * (a + m2));
+
+        d = 1 + aa * d;
+        d = 1 / (fabs(d) < tiny ? tiny : d);
+        c = 1 + aa / c;
+        c = fabs(c) < tiny ? tiny : c;
+        h *= d * c;
+
+        aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1));
+        d = 1 + aa * d;
+        d = 1 / (fabs(d) < tiny ? tiny : d);
+        c = 1 + aa / c;
+        c = fabs(c) < tiny ? tiny : c;
+
+        const double del = d * c;
+        h *= del;
+
+        if (fabs(del - 1) < 1e-12) {
+            break;
+        }
+    }
+
+    return h;
+}
+
+// Regularized incomplete beta function I_x(a, b)
+double beta_inc(const double a, const double b, const double x) {
+    if (x <= 0) {
+        return 0;
+    } else if (x >= 1) {
+        return 1;
+    }
+
+    const double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) +
+                             a * log(x) + b * log(1 - x));
+
+    if (x < (a + 1) / (a + b + 2)) {
+        return front * beta_cf(a, b, x) / a;
+    }
+
+    return 1 - front * beta_cf(b, a, 1 - x) / b;
+}
+
+/**
+ * Two sided p-value of Welch's t-test, both samples need 2 runs.
+ */
+double welch(const size_t n1, const double m1, const double v1,
+             const size_t n2, const double m2, const double v2) {
+    const double s1 = v1 / n1, s2 = v2 / n2;
+
+    if (s1 + s2 == 0) {
+        return m1 == m2 ? 1 : 0;
+    }
+
+    const double t = (m2 - m1) / sqrt(s1 + s2);
+    const double df =
+        (s1 + s2) * (s1 + s2) / (s1 * s1 / (n1 - 1) + s2 * s2 / (n2 - 1));
+
+    return beta_inc(df / 2, 0.5, df / (df + t * t));
+}
+
+int main(const int argc, char **argv) {
+    double alpha = 0.05, threshold = 5;
+
+    opterr = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "ha:t:")) != -1)
+        switch (c) {
+        case 'h':
+            fprintf(stdout, "%s", usage());
+            exit(0);
+        case 'a': {
+            char *end;
+            alpha = strtod(optarg, &end);
+
+            if (*end != '\0' || !(alpha > 0 && alpha < 1)) {
+                PANIC("Invalid value for option -a");
+            }
+
+            break;
+        }
+        case 't': {
+            char *end;
+            threshold = strtod(optarg, &end);
+
+            if (*end != '\0' || !(threshold >= 0)) {
+                PANIC("Invalid value for option -t");
+            }
+
+            break;
+        }
+        case '?':
+            if (optopt == 'a') {
+                PANIC("Option -a requires an argument.");
+            } else if (optopt == 't') {
+                PANIC("Option -t requires an argument.");
+            } else {
+                fprintf(stderr, "Unknown option -%c.\n", optopt);
+                exit(1);
+            }
+        default:
+            abort();
+        }
+
+    if (argc - optind != 2) {
+        fprintf(stderr, "%s", usage());
+        exit(1);
+    }
+
+    configs_t configs = {0};
+    read_runs(&configs, argv[optind], 0);
+    read_runs(&configs, argv[optind + 1], 1);
+
+    int regressions = 0;
+
+    fprintf(stdout, "bst_type,strategy,threads,key_dist,requested_operations,"
+                    "write_prob,duration,metric,baseline_n,"
+                    "baseline_mean,candidate_n,candidate_mean,change_pct,"
+                    "p_value,verdict\n");
+
+    for (size_t i = 0; i < configs.count; i++) {
+        config_t *config = &configs.configs[i];
+
+        for (int j = 0; j < METRICS; j++) {
+            double m[2], v[2];
+            size_t n[2];
+
+            for (int side = 0; side < 2; side++) {
+                n[side] = sample(config->runs[side], config->count[side],
+                                 metrics[j].name, &m[side], &v[side]);
+            }
+
+            // Not measured by either build, e.g. the mins of -s insert
+            if ((n[0] == 0 || m[0] == 0) && (n[1] == 0 || m[1] == 0)) {
+                continue;
+            }
+
+            for (int k = 0; k < KEYS; k++) {
+                fprintf(stdout, "%s,", config->key[k]);
+            }
+
+            fprintf(stdout, "%s", metrics[j].name);
+
+            for (int side = 0; side < 2; side++) {
+                if (n[side] > 0) {
+                    fprintf(stdout, ",%zu,%f", n[side], m[side]);
+                } else {
+                    fprintf(stdout, ",0,");
+                }
+            }
+
+            fprintf(stdout, ",");
+
+            if (n[0] == 0 || n[1] == 0) {
+                fprintf(stdout, ",,missing\n");
+                continue;
+            }
+
+            const double change =
+                m[0] != 0 ? (m[1] - m[0]) / fabs(m[0]) * 100 : 0;
+            fprintf(stdout, "%f,", change);
+
+            if (n[0] < 2 || n[1] < 2) {
+                fprintf(stdout, ",unknown\n");
+                continue;
+            }
+
+            const double p = welch(n[0], m[0], v[0], n[1], m[1], v[1]);
+            const double better = metrics[j].higher_better ? change : -change;
+            const char *verdict = "same";
+
+            if (p < alpha && better <= -threshold) {
+                verdict = "regression";
+                regressions++;
+            } else if (p < alpha && better >= threshold) {
+                verdict = "improvement";
+            }
+
+            fprintf(stdout, "%g,%s\n", p, verdict);
+        }
+
+        for (int side = 0; side < 2; side++) {
+            for (size_t k = 0; k < config->count[side]; k++) {
+                bst_result_free(&config->runs[side][k]);
+            }
+
+            free(config->runs[side]);
+        }
+
+        for (int k = 0; k < KEYS; k++) {
+            free(config->key[k]);
+        }
+    }
+
+    free(configs.configs);
+
+    return regressions > 0 ? 2 : 0;
+}
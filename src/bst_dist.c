@@ -0,0 +1,130 @@
+/*
+Universidade Aberta
+File: bst_dist.c
+Author: Hugo Gonçalves, 2100562
+
+Skewed key selection for the test harness
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <math.h>
+
+#include "include/bst_dist.h"
+
+// log(1 + x) / x, accurate near 0
+static inline double bst_dist_helper1(const double x) {
+    if (fabs(x) > 1e-8) {
+        return log1p(x) / x;
+    }
+    return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+// (exp(x) - 1) / x, accurate near 0
+static inline double bst_dist_helper2(const double x) {
+    if (fabs(x) > 1e-8) {
+        return expm1(x) / x;
+    }
+    return 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+}
+
+// h(x) = x^-theta, the unnormalized probability of rank x
+static inline double bst_dist_h(const double theta, const double x) {
+    return exp(-theta * log(x));
+}
+
+// H(x), the integral of h, also defined for theta = 1
+static inline double bst_dist_hi(const double theta, const double x) {
+    const double lx = log(x);
+    return bst_dist_helper2((1 - theta) * lx) * lx;
+}
+
+// H^-1(x)
+static inline double bst_dist_hi_inv(const double theta, const double x) {
+    double t = x * (1 - theta);
+    if (t < -1) {
+        t = -1;
+    }
+    return exp(bst_dist_helper1(t) * x);
+}
+
+void bst_dist_init(bst_dist_t *dist, const bst_dist_kind_t kind,
+                   const double theta, const double hot_frac,
+                   const double hot_prob) {
+    dist->kind = kind;
+    dist->theta = theta;
+    dist->hot_frac = hot_frac;
+    dist->hot_prob = hot_prob;
+    dist->h_x1 = bst_dist_hi(theta, 1.5) - 1;
+    dist->s = 2 - bst_dist_hi_inv(theta, bst_dist_hi(theta, 2.5) -
+                                             bst_dist_h(theta, 2));
+}
+
+// Zipfian rank from 1 to n
+static size_t bst_dist_zipf(const bst_dist_t *dist, bst_rand_t *rng,
+                            const size_t n) {
+    const double theta = dist->theta;
+    const double h_n = bst_dist_hi(theta, n + 0.5);
+
+    for (;;) {
+        const double u = h_n + bst_rand_double(rng) * (dist->h_x1 - h_n);
+        const double x = bst_dist_hi_inv(theta, u);
+        double k = floor(x + 0.5);
+
+        if (k < 1) {
+            k = 1;
+        } else if (k > n) {
+            k = n;
+        }
+
+        // Accepted right away for most picks, the test is cheap
+        if (k - x <= dist->s ||
+            u >= bst_dist_hi(theta, k + 0.5) - bst_dist_h(theta, k)) {
+            return (size_t)k;
+        }
+    }
+}
+
+size_t bst_dist_next(const bst_dist_t *dist, bst_rand_t *rng,
+                     const size_t n) {
+    switch (dist->kind) {
+    case BST_DIST_ZIPF:
+        return bst_dist_zipf(dist, rng, n) - 1;
+    case BST_DIST_LATEST:
+        return n - bst_dist_zipf(dist, rng, n);
+    case BST_DIST_HOTSPOT: {
+        size_t hot = (size_t)(dist->hot_frac * n);
+        if (hot < 1) {
+            hot = 1;
+        }
+
+        if (hot >= n || bst_rand_double(rng) < dist->hot_prob) {
+            return bst_rand_below(rng, hot);
+        }
+
+        return hot + bst_rand_below(rng, n - hot);
+    }
+    case BST_DIST_UNIFORM:
+    default:
+        return bst_rand_below(rng, n);
+    }
+}
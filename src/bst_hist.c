@@ -0,0 +1,110 @@
+/*
+Universidade Aberta
+File: bst_hist.c
+Author: Hugo Gonçalves, 2100562
+
+Log bucketed latency histograms
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <string.h>
+
+#include "include/bst_hist.h"
+
+static inline size_t bst_hist_bucket(const uint64_t value) {
+    if (value < BST_HIST_SUB_BUCKETS) {
+        return value;
+    }
+
+    // Highest set bit picks the power of two range, the next
+    // BST_HIST_SUB_BITS bits the bucket within it
+    const unsigned e = 63 - __builtin_clzll(value);
+    const unsigned shift = e - BST_HIST_SUB_BITS;
+
+    return (size_t)(shift + 1) * BST_HIST_SUB_BUCKETS +
+           (size_t)((value >> shift) - BST_HIST_SUB_BUCKETS);
+}
+
+void bst_hist_reset(bst_hist_t *hist) { memset(hist, 0, sizeof(bst_hist_t)); }
+
+void bst_hist_record(bst_hist_t *hist, const uint64_t value) {
+    hist->buckets[bst_hist_bucket(value)]++;
+    hist->count++;
+
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+void bst_hist_merge(bst_hist_t *into, const bst_hist_t *from) {
+    for (size_t i = 0; i < BST_HIST_BUCKETS; i++) {
+        into->buckets[i] += from->buckets[i];
+    }
+
+    into->count += from->count;
+
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+}
+
+uint64_t bst_hist_bucket_max(const size_t bucket) {
+    if (bucket < BST_HIST_SUB_BUCKETS) {
+        return bucket;
+    }
+
+    const unsigned shift = bucket / BST_HIST_SUB_BUCKETS - 1;
+    const uint64_t m = bucket % BST_HIST_SUB_BUCKETS + BST_HIST_SUB_BUCKETS;
+
+    // Wraps to 0 for the last bucket, which ends at UINT64_MAX
+    return ((m + 1) << shift) - 1;
+}
+
+uint64_t bst_hist_percentile(const bst_hist_t *hist, const double percentile) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    // Rank of the value, 1 based, rounded up so p50 of two values is the
+    // first
+    uint64_t rank = (uint64_t)(percentile / 100 * hist->count);
+    if ((double)rank < percentile / 100 * hist->count) {
+        rank++;
+    }
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < BST_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+
+        if (seen >= rank) {
+            const uint64_t v = bst_hist_bucket_max(i);
+            return v < hist->max ? v : hist->max;
+        }
+    }
+
+    return hist->max;
+}
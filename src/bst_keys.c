@@ -0,0 +1,511 @@
+/*
+Universidade Aberta
+File: bst_keys.c
+Author: Hugo Gonçalves, 2100562
+
+Key set import from files and streams
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/bst_keys.h"
+
+// Smallest text chunk worth a thread of its own
+#define BST_KEYS_MIN_CHUNK (1 << 20)
+
+/**
+ * Part of a text file parsed by one thread, between line boundaries.
+ */
+typedef struct bst_keys_chunk {
+    const char *begin;
+    const char *end;
+    int64_t *out;
+    size_t lines; // upper bound of the keys in the chunk
+    size_t count; // keys parsed, SIZE_MAX on a malformed line
+} bst_keys_chunk_t;
+
+static inline int bst_keys_blank(const char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline int bst_keys_digit(const char c) { return c >= '0' && c <= '9'; }
+
+static int bst_keys_is_text(const char *data, size_t size) {
+    if (size > BST_KEYS_SNIFF_BYTES) {
+        size = BST_KEYS_SNIFF_BYTES;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        const char c = data[i];
+
+        if (!bst_keys_digit(c) && !bst_keys_blank(c) && c != '\n' &&
+            c != '-' && c != '+') {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Checks 8 bytes for ASCII digits and converts them with three multiplies,
+// little endian byte order
+static inline int bst_keys_is_eight_digits(const uint64_t x) {
+    return ((x & 0xF0F0F0F0F0F0F0F0ull) |
+            (((x + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+           0x3333333333333333ull;
+}
+
+static inline uint64_t bst_keys_eight_digits(uint64_t x) {
+    const uint64_t mask = 0x000000FF000000FFull;
+
+    x -= 0x3030303030303030ull;
+    x = x * 10 + (x >> 8);
+
+    return ((x & mask) * (100 + (1000000ull << 32)) +
+            ((x >> 16) & mask) * (1 + (10000ull << 32))) >>
+           32;
+}
+
+static size_t bst_keys_count_lines(const char *p, const char *end) {
+    size_t lines = 0;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+
+        lines++;
+        if (nl == NULL) {
+            break;
+        }
+
+        p = nl + 1;
+    }
+
+    return lines;
+}
+
+// Parses the lines of [p, end) into out, at most one key per line. Returns the
+// number of keys or SIZE_MAX on a malformed line.
+static size_t bst_keys_parse(const char *p, const char *end, int64_t *out) {
+    size_t n = 0;
+
+    while (p < end) {
+        while (p < end && bst_keys_blank(*p)) {
+            p++;
+        }
+
+        if (p == end) {
+            break;
+        }
+
+        if (*p == '\n') {
+            p++;
+            continue;
+        }
+
+        const int negative = *p == '-';
+        if (*p == '-' || *p == '+') {
+            p++;
+        }
+
+        const char *digits = p;
+        uint64_t v = 0;
+
+        // Up to 16 digits eight at a time, an int64_t has at most 19
+        while (end - p >= 8 && p - digits < 16) {
+            uint64_t x;
+            memcpy(&x, p, sizeof(x));
+            x = le64toh(x);
+
+            if (!bst_keys_is_eight_digits(x)) {
+                break;
+            }
+
+            v = v * 100000000 + bst_keys_eight_digits(x);
+            p += 8;
+        }
+
+        while (p < end && bst_keys_digit(*p)) {
+            if (p - digits == 19) {
+                return SIZE_MAX;
+            }
+
+            v = v * 10 + (*p - '0');
+            p++;
+        }
+
+        if (p == digits || v > (uint64_t)INT64_MAX + negative) {
+            return SIZE_MAX;
+        }
+
+        while (p < end && bst_keys_blank(*p)) {
+            p++;
+        }
+
+        if (p < end && *p != '\n') {
+            return SIZE_MAX;
+        }
+
+        out[n++] = negative ? (int64_t)(0 - v) : (int64_t)v;
+    }
+
+    return n;
+}
+
+static void *bst_keys_count_thread(void *arg) {
+    bst_keys_chunk_t *chunk = arg;
+
+    chunk->lines = bst_keys_count_lines(chunk->begin, chunk->end);
+
+    return NULL;
+}
+
+static void *bst_keys_parse_thread(void *arg) {
+    bst_keys_chunk_t *chunk = arg;
+
+    chunk->count = bst_keys_parse(chunk->begin, chunk->end, chunk->out);
+
+    return NULL;
+}
+
+// Runs fn over every chunk, the first one on the calling thread. Chunks whose
+// thread can't be created run on the calling thread as well.
+static void bst_keys_run(bst_keys_chunk_t *chunks, const size_t n,
+                         void *(*fn)(void *)) {
+    pthread_t threads[n];
+    int started[n];
+
+    for (size_t i = 1; i < n; i++) {
+        started[i] = pthread_create(&threads[i], NULL, fn, &chunks[i]) == 0;
+    }
+
+    fn(&chunks[0]);
+
+    for (size_t i = 1; i < n; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            fn(&chunks[i]);
+        }
+    }
+}
+
+// Parses a text key file. Lines are counted first to size the key array, then
+// every chunk parses straight into its slice of it.
+static BST_ERROR bst_keys_load_text(const char *data, const size_t size,
+                                    size_t threads, bst_keys_t *keys) {
+    if (threads > size / BST_KEYS_MIN_CHUNK + 1) {
+        threads = size / BST_KEYS_MIN_CHUNK + 1;
+    }
+
+    bst_keys_chunk_t *chunks = calloc(threads, sizeof(bst_keys_chunk_t));
+
+    if (chunks == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    const char *end = data + size;
+    const char *begin = data;
+
+    for (size_t i = 0; i < threads; i++) {
+        const char *split = i + 1 < threads ? data + size / threads * (i + 1)
+                                            : end;
+
+        // Move the split past the end of its line
+        if (split < begin) {
+            split = begin;
+        }
+
+        if (split < end && i + 1 < threads) {
+            const char *nl = memchr(split, '\n', end - split);
+            split = nl != NULL ? nl + 1 : end;
+        }
+
+        chunks[i].begin = begin;
+        chunks[i].end = split;
+        begin = split;
+    }
+
+    bst_keys_run(chunks, threads, bst_keys_count_thread);
+
+    size_t lines = 0;
+    for (size_t i = 0; i < threads; i++) {
+        lines += chunks[i].lines;
+    }
+
+    int64_t *parsed = malloc((lines > 0 ? lines : 1) * sizeof(int64_t));
+
+    if (parsed == NULL) {
+        free(chunks);
+        return MALLOC_FAILURE;
+    }
+
+    for (size_t i = 0, at = 0; i < threads; i++) {
+        chunks[i].out = &parsed[at];
+        at += chunks[i].lines;
+    }
+
+    bst_keys_run(chunks, threads, bst_keys_parse_thread);
+
+    // Close the gaps left by empty lines
+    size_t count = 0;
+
+    for (size_t i = 0; i < threads; i++) {
+        if (chunks[i].count == SIZE_MAX) {
+            free(parsed);
+            free(chunks);
+            return INVALID_KEY_FILE;
+        }
+
+        if (chunks[i].out != &parsed[count]) {
+            memmove(&parsed[count], chunks[i].out,
+                    chunks[i].count * sizeof(int64_t));
+        }
+
+        count += chunks[i].count;
+    }
+
+    free(chunks);
+
+    keys->parsed = parsed;
+    keys->keys = parsed;
+    keys->count = count;
+
+    return SUCCESS;
+}
+
+static int bst_keys_reserve(bst_keys_t *keys, size_t *capacity,
+                            const size_t need) {
+    if (need <= *capacity) {
+        return 1;
+    }
+
+    size_t grown = *capacity > 0 ? 2 * *capacity : 65536;
+    if (grown < need) {
+        grown = need;
+    }
+
+    int64_t *parsed = realloc(keys->parsed, grown * sizeof(int64_t));
+
+    if (parsed == NULL) {
+        return 0;
+    }
+
+    keys->parsed = parsed;
+    *capacity = grown;
+
+    return 1;
+}
+
+// Reads keys from a stream as they arrive. Text is parsed a buffer of whole
+// lines at a time, binary keys are appended as they are.
+static BST_ERROR bst_keys_load_stream(const int fd, bst_keys_t *keys) {
+    char *buf = malloc(BST_KEYS_STREAM_BYTES);
+
+    if (buf == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    size_t capacity = 0, count = 0, carry = 0;
+    int text = -1;
+    BST_ERROR err = SUCCESS;
+
+    for (;;) {
+        const ssize_t n = read(fd, buf + carry, BST_KEYS_STREAM_BYTES - carry);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            err = IO_FAILURE;
+            break;
+        }
+
+        const size_t len = carry + n;
+
+        if (text < 0 && len > 0) {
+            text = bst_keys_is_text(buf, len);
+        }
+
+        if (text == 0) {
+            const size_t whole = len / sizeof(int64_t);
+
+            if (!bst_keys_reserve(keys, &capacity, count + whole)) {
+                err = MALLOC_FAILURE;
+                break;
+            }
+
+            memcpy(&keys->parsed[count], buf, whole * sizeof(int64_t));
+            count += whole;
+            carry = len - whole * sizeof(int64_t);
+            memmove(buf, buf + whole * sizeof(int64_t), carry);
+        } else {
+            // Whole lines only, the last line waits for the rest of it
+            size_t parse = len;
+
+            if (n > 0) {
+                while (parse > 0 && buf[parse - 1] != '\n') {
+                    parse--;
+                }
+
+                if (parse == 0 && len == BST_KEYS_STREAM_BYTES) {
+                    err = INVALID_KEY_FILE; // No key is that long
+                    break;
+                }
+            }
+
+            const size_t lines = bst_keys_count_lines(buf, buf + parse);
+
+            if (!bst_keys_reserve(keys, &capacity, count + lines)) {
+                err = MALLOC_FAILURE;
+                break;
+            }
+
+            const size_t parsed =
+                bst_keys_parse(buf, buf + parse, &keys->parsed[count]);
+
+            if (parsed == SIZE_MAX) {
+                err = INVALID_KEY_FILE;
+                break;
+            }
+
+            count += parsed;
+            carry = len - parse;
+            memmove(buf, buf + parse, carry);
+        }
+
+        if (n == 0) {
+            if (carry > 0) {
+                err = INVALID_KEY_FILE; // A partial binary key
+            }
+            break;
+        }
+    }
+
+    free(buf);
+
+    if (!IS_SUCCESS(err)) {
+        free(keys->parsed);
+        keys->parsed = NULL;
+        return err;
+    }
+
+    keys->keys = keys->parsed;
+    keys->count = count;
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_keys_load(const char *path, size_t threads, bst_keys_t *keys) {
+    memset(keys, 0, sizeof(bst_keys_t));
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    if (strcmp(path, "-") == 0) {
+        return bst_keys_load_stream(STDIN_FILENO, keys);
+    }
+
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return IO_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return IO_FAILURE;
+    }
+
+    const size_t size = st.st_size;
+
+    if (size == 0) {
+        close(fd);
+        return SUCCESS;
+    }
+
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return IO_FAILURE;
+    }
+
+    if (size >= 8 && (memcmp(data, BST_SNAPSHOT_MAGIC, 8) == 0 ||
+                      memcmp(data, BST_SNAPSHOT_PACKED_MAGIC, 8) == 0)) {
+        munmap(data, size);
+
+        const BST_ERROR err = bst_snapshot_map(path, &keys->snap);
+
+        if (IS_SUCCESS(err)) {
+            keys->keys = keys->snap.keys;
+            keys->count = keys->snap.count;
+        }
+
+        return err;
+    }
+
+    if (bst_keys_is_text(data, size)) {
+        madvise(data, size, MADV_SEQUENTIAL);
+
+        const BST_ERROR err = bst_keys_load_text(data, size, threads, keys);
+        munmap(data, size);
+
+        return err;
+    }
+
+    if (size % sizeof(int64_t) != 0) {
+        munmap(data, size);
+        return INVALID_KEY_FILE;
+    }
+
+    keys->map = data;
+    keys->map_size = size;
+    keys->keys = (const int64_t *)data;
+    keys->count = size / sizeof(int64_t);
+
+    return SUCCESS;
+}
+
+void bst_keys_free(bst_keys_t *keys) {
+    if (keys->map != NULL) {
+        munmap(keys->map, keys->map_size);
+    }
+
+    free(keys->parsed);
+    bst_snapshot_unmap(&keys->snap);
+
+    memset(keys, 0, sizeof(bst_keys_t));
+}
@@ -32,11 +32,42 @@ IN THE SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../include/bst_arena.h"
 #include "../include/bst_common.h"
+#include "../include/bst_snapshot.h"
 #include "include/bst_mt_cgl.h"
 
-bst_mt_cgl_node_t *bst_mt_grwl_node_new(const int64_t value, BST_ERROR *err) {
-    bst_mt_cgl_node_t *node = malloc(sizeof(bst_mt_cgl_node_t));
+static inline bst_mt_cgl_node_t *bst_mt_cgl_node(const bst_mt_cgl_t *bst,
+                                                 const bst_mt_cgl_ref_t ref) {
+#ifdef BST_COMPACT_NODES
+    return ref == BST_MT_CGL_NIL ? NULL
+                                 : (bst_mt_cgl_node_t *)bst->pool.base + ref;
+#else
+    (void)bst;
+    return ref;
+#endif
+}
+
+static inline bst_mt_cgl_ref_t bst_mt_cgl_ref(const bst_mt_cgl_t *bst,
+                                              bst_mt_cgl_node_t *node) {
+#ifdef BST_COMPACT_NODES
+    return node == NULL
+               ? BST_MT_CGL_NIL
+               : (bst_mt_cgl_ref_t)(node - (bst_mt_cgl_node_t *)bst->pool.base);
+#else
+    (void)bst;
+    return node;
+#endif
+}
+
+bst_mt_cgl_node_t *bst_mt_grwl_node_new(bst_mt_cgl_t *bst, const int64_t value,
+                                        BST_ERROR *err) {
+#ifdef BST_COMPACT_NODES
+    bst_mt_cgl_node_t *node =
+        bst_mt_cgl_node(bst, bst_pool_alloc(&bst->pool));
+#else
+    bst_mt_cgl_node_t *node = bst_arena_alloc(sizeof(bst_mt_cgl_node_t));
+#endif
 
     if (node == NULL) {
         if (err != NULL) {
@@ -47,8 +78,9 @@ bst_mt_cgl_node_t *bst_mt_grwl_node_new(const int64_t value, BST_ERROR *err) {
     }
 
     node->value = value;
-    node->left = NULL;
-    node->right = NULL;
+    node->left = BST_MT_CGL_NIL;
+    node->right = BST_MT_CGL_NIL;
+    bst->allocs++;
 
     if (err != NULL) {
         *err = SUCCESS;
@@ -57,6 +89,17 @@ bst_mt_cgl_node_t *bst_mt_grwl_node_new(const int64_t value, BST_ERROR *err) {
     return node;
 }
 
+static void bst_mt_grwl_node_release(bst_mt_cgl_t *bst,
+                                     bst_mt_cgl_node_t *node) {
+    bst->frees++;
+
+#ifdef BST_COMPACT_NODES
+    bst_pool_release(&bst->pool, bst_mt_cgl_ref(bst, node));
+#else
+    bst_arena_free(node, sizeof(bst_mt_cgl_node_t));
+#endif
+}
+
 bst_mt_cgl_t *bst_mt_cgl_new(BST_ERROR *err) {
     bst_mt_cgl_t *bst = malloc(sizeof(bst_mt_cgl_t));
 
@@ -86,8 +129,23 @@ bst_mt_cgl_t *bst_mt_cgl_new(BST_ERROR *err) {
         return NULL;
     }
 
+#ifdef BST_COMPACT_NODES
+    if (!IS_SUCCESS(bst_pool_init(&bst->pool, sizeof(bst_mt_cgl_node_t)))) {
+        pthread_rwlock_destroy(&bst->rwl);
+        free(bst);
+
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+
+        return NULL;
+    }
+#endif
+
     bst->count = 0;
-    bst->root = NULL;
+    bst->root = BST_MT_CGL_NIL;
+    bst->allocs = 0;
+    bst->frees = 0;
 
     if (err != NULL) {
         *err = SUCCESS;
@@ -107,12 +165,12 @@ BST_ERROR bst_mt_cgl_add(bst_mt_cgl_t **bst, const int64_t value) {
         return PT_RWLOCK_LOCK_FAILURE;
     }
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_MT_CGL_NIL) {
         BST_ERROR err;
-        bst_mt_cgl_node_t *node = bst_mt_grwl_node_new(value, &err);
+        bst_mt_cgl_node_t *node = bst_mt_grwl_node_new(bst_, value, &err);
 
         if ((err & SUCCESS) == SUCCESS) {
-            bst_->root = node;
+            bst_->root = bst_mt_cgl_ref(bst_, node);
             bst_->count++;
 
             if (pthread_rwlock_unlock(&bst_->rwl)) {
@@ -129,16 +187,17 @@ BST_ERROR bst_mt_cgl_add(bst_mt_cgl_t **bst, const int64_t value) {
         return err;
     }
 
-    bst_mt_cgl_node_t *root = bst_->root;
+    bst_mt_cgl_node_t *root = bst_mt_cgl_node(bst_, bst_->root);
 
     while (root != NULL) {
         if (compare(value, root->value) < 0) {
-            if (root->left == NULL) {
+            if (root->left == BST_MT_CGL_NIL) {
                 BST_ERROR err;
-                bst_mt_cgl_node_t *node = bst_mt_grwl_node_new(value, &err);
+                bst_mt_cgl_node_t *node =
+                    bst_mt_grwl_node_new(bst_, value, &err);
 
                 if (IS_SUCCESS(err)) {
-                    root->left = node;
+                    root->left = bst_mt_cgl_ref(bst_, node);
                     bst_->count++;
 
                     if (pthread_rwlock_unlock(&bst_->rwl)) {
@@ -155,14 +214,15 @@ BST_ERROR bst_mt_cgl_add(bst_mt_cgl_t **bst, const int64_t value) {
                 return err;
             }
 
-            root = root->left;
+            root = bst_mt_cgl_node(bst_, root->left);
         } else if (compare(value, root->value) > 0) {
-            if (root->right == NULL) {
+            if (root->right == BST_MT_CGL_NIL) {
                 BST_ERROR err;
-                bst_mt_cgl_node_t *node = bst_mt_grwl_node_new(value, &err);
+                bst_mt_cgl_node_t *node =
+                    bst_mt_grwl_node_new(bst_, value, &err);
 
                 if (IS_SUCCESS(err)) {
-                    root->right = node;
+                    root->right = bst_mt_cgl_ref(bst_, node);
                     bst_->count++;
 
                     if (pthread_rwlock_unlock(&bst_->rwl)) {
@@ -179,7 +239,7 @@ BST_ERROR bst_mt_cgl_add(bst_mt_cgl_t **bst, const int64_t value) {
                 return err;
             }
 
-            root = root->right;
+            root = bst_mt_cgl_node(bst_, root->right);
         } else {
             // Value already exists
             if (pthread_rwlock_unlock(&bst_->rwl)) {
@@ -209,14 +269,14 @@ BST_ERROR bst_mt_cgl_search(bst_mt_cgl_t **bst, const int64_t value) {
         return PT_RWLOCK_LOCK_FAILURE;
     }
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_MT_CGL_NIL) {
         if (pthread_rwlock_unlock(&bst_->rwl)) {
             return PT_RWLOCK_UNLOCK_FAILURE | BST_EMPTY;
         }
         return BST_EMPTY;
     }
 
-    const bst_mt_cgl_node_t *root = bst_->root;
+    const bst_mt_cgl_node_t *root = bst_mt_cgl_node(bst_, bst_->root);
 
     while (root != NULL) {
         if (root->value == value) {
@@ -226,9 +286,9 @@ BST_ERROR bst_mt_cgl_search(bst_mt_cgl_t **bst, const int64_t value) {
 
             return VALUE_EXISTS;
         } else if (compare(value, root->value) < 0) {
-            root = root->left;
+            root = bst_mt_cgl_node(bst_, root->left);
         } else if (compare(value, root->value) > 0) {
-            root = root->right;
+            root = bst_mt_cgl_node(bst_, root->right);
         }
     }
 
@@ -250,17 +310,17 @@ BST_ERROR bst_mt_cgl_min(bst_mt_cgl_t **bst, int64_t *value) {
         return PT_RWLOCK_LOCK_FAILURE;
     }
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_MT_CGL_NIL) {
         if (pthread_rwlock_unlock(&bst_->rwl)) {
             return PT_RWLOCK_UNLOCK_FAILURE | BST_EMPTY;
         }
         return BST_EMPTY;
     }
 
-    const bst_mt_cgl_node_t *root = bst_->root;
+    const bst_mt_cgl_node_t *root = bst_mt_cgl_node(bst_, bst_->root);
 
-    while (root->left != NULL) {
-        root = root->left;
+    while (root->left != BST_MT_CGL_NIL) {
+        root = bst_mt_cgl_node(bst_, root->left);
     }
 
     if (value != NULL) {
@@ -285,17 +345,17 @@ BST_ERROR bst_mt_cgl_max(bst_mt_cgl_t **bst, int64_t *value) {
         return PT_RWLOCK_LOCK_FAILURE;
     }
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_MT_CGL_NIL) {
         if (pthread_rwlock_unlock(&bst_->rwl)) {
             return PT_RWLOCK_UNLOCK_FAILURE | BST_EMPTY;
         }
         return BST_EMPTY;
     }
 
-    const bst_mt_cgl_node_t *root = bst_->root;
+    const bst_mt_cgl_node_t *root = bst_mt_cgl_node(bst_, bst_->root);
 
-    while (root->right != NULL) {
-        root = root->right;
+    while (root->right != BST_MT_CGL_NIL) {
+        root = bst_mt_cgl_node(bst_, root->right);
     }
 
     if (value != NULL) {
@@ -342,7 +402,7 @@ BST_ERROR bst_mt_cgl_delete(bst_mt_cgl_t **bst, const int64_t value) {
         return PT_RWLOCK_LOCK_FAILURE;
     }
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_MT_CGL_NIL) {
         if (pthread_rwlock_unlock(&bst_->rwl)) {
             return PT_RWLOCK_UNLOCK_FAILURE | BST_EMPTY;
         }
@@ -350,16 +410,17 @@ BST_ERROR bst_mt_cgl_delete(bst_mt_cgl_t **bst, const int64_t value) {
         return BST_EMPTY;
     }
 
-    bst_mt_cgl_node_t *current = bst_->root, *parent = NULL;
+    bst_mt_cgl_node_t *current = bst_mt_cgl_node(bst_, bst_->root);
+    bst_mt_cgl_node_t *parent = NULL;
 
     // Find the node
     while (current != NULL && current->value != value) {
         if (compare(value, current->value) < 0) {
             parent = current;
-            current = current->left;
+            current = bst_mt_cgl_node(bst_, current->left);
         } else {
             parent = current;
-            current = current->right;
+            current = bst_mt_cgl_node(bst_, current->right);
         }
     }
 
@@ -372,14 +433,14 @@ BST_ERROR bst_mt_cgl_delete(bst_mt_cgl_t **bst, const int64_t value) {
     }
 
     // Node with two children
-    if (current->left != NULL && current->right != NULL) {
-        bst_mt_cgl_node_t *successor = current->right;
+    if (current->left != BST_MT_CGL_NIL && current->right != BST_MT_CGL_NIL) {
+        bst_mt_cgl_node_t *successor = bst_mt_cgl_node(bst_, current->right);
         bst_mt_cgl_node_t *successor_parent = current;
 
         // Find in-order successor and its parent
-        while (successor->left != NULL) {
+        while (successor->left != BST_MT_CGL_NIL) {
             successor_parent = successor;
-            successor = successor->left;
+            successor = bst_mt_cgl_node(bst_, successor->left);
         }
 
         // Replace current node's data with successor's data
@@ -391,17 +452,18 @@ BST_ERROR bst_mt_cgl_delete(bst_mt_cgl_t **bst, const int64_t value) {
     }
 
     // Node with one or zero children
-    bst_mt_cgl_node_t *child =
-        current->left != NULL ? current->left : current->right;
+    const bst_mt_cgl_ref_t child =
+        current->left != BST_MT_CGL_NIL ? current->left : current->right;
+    const bst_mt_cgl_ref_t current_ref = bst_mt_cgl_ref(bst_, current);
     if (parent == NULL) {
         bst_->root = child; // Delete the root node
-    } else if (parent->left == current) {
+    } else if (parent->left == current_ref) {
         parent->left = child;
     } else {
         parent->right = child;
     }
 
-    free(current);
+    bst_mt_grwl_node_release(bst_, current);
 
     bst_->count--;
 
@@ -412,6 +474,7 @@ BST_ERROR bst_mt_cgl_delete(bst_mt_cgl_t **bst, const int64_t value) {
     return SUCCESS;
 }
 
+#ifndef BST_COMPACT_NODES
 void bst_mt_grwl_node_free(bst_mt_cgl_node_t *root) {
     if (root == NULL) {
         return;
@@ -425,9 +488,293 @@ void bst_mt_grwl_node_free(bst_mt_cgl_node_t *root) {
         bst_mt_grwl_node_free(root->right);
     }
 
-    free(root);
+    bst_arena_free(root, sizeof(bst_mt_cgl_node_t));
+}
+#endif
+
+BST_ERROR bst_mt_cgl_memory_stats(bst_mt_cgl_t **bst,
+                                   bst_memory_stats_t *stats) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_mt_cgl_t *bst_ = *bst;
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    if (stats != NULL) {
+        stats->live_nodes = bst_->allocs - bst_->frees;
+#ifdef BST_COMPACT_NODES
+        stats->node_bytes = bst_->pool.committed;
+#else
+        stats->node_bytes = stats->live_nodes * sizeof(bst_mt_cgl_node_t);
+#endif
+        stats->lock_bytes = sizeof(pthread_rwlock_t);
+        stats->meta_bytes = sizeof(bst_mt_cgl_t) - sizeof(pthread_rwlock_t);
+        stats->pending_nodes = 0;
+        stats->pending_bytes = 0;
+        stats->allocs = bst_->allocs;
+        stats->frees = bst_->frees;
+    }
+
+    if (pthread_rwlock_unlock(&bst_->rwl)) {
+        return PT_RWLOCK_UNLOCK_FAILURE | SUCCESS;
+    }
+
+    return SUCCESS;
+}
+
+// Appends every value in order, returns 0 if the traversal stack can't grow
+static int bst_mt_grwl_save_nodes(bst_mt_cgl_t *bst,
+                                  bst_snapshot_writer_t *writer) {
+    size_t capacity = 64, top = 0;
+    bst_mt_cgl_node_t **stack = malloc(capacity * sizeof(bst_mt_cgl_node_t *));
+
+    if (stack == NULL) {
+        return 0;
+    }
+
+    bst_mt_cgl_node_t *node = bst_mt_cgl_node(bst, bst->root);
+
+    while (node != NULL || top > 0) {
+        while (node != NULL) {
+            if (top == capacity) {
+                bst_mt_cgl_node_t **s =
+                    realloc(stack, 2 * capacity * sizeof(bst_mt_cgl_node_t *));
+
+                if (s == NULL) {
+                    free(stack);
+                    return 0;
+                }
+
+                stack = s;
+                capacity *= 2;
+            }
+
+            stack[top++] = node;
+            node = bst_mt_cgl_node(bst, node->left);
+        }
+
+        node = stack[--top];
+        bst_snapshot_writer_append(writer, node->value);
+        node = bst_mt_cgl_node(bst, node->right);
+    }
+
+    free(stack);
+
+    return 1;
+}
+
+BST_ERROR bst_mt_cgl_save(bst_mt_cgl_t **bst, const char *path) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_mt_cgl_t *bst_ = *bst;
+    bst_snapshot_writer_t writer;
+
+    BST_ERROR err = bst_snapshot_writer_open(&writer, path);
+
+    if (!IS_SUCCESS(err)) {
+        return err;
+    }
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        bst_snapshot_writer_close(&writer, 1);
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    const int saved = bst_mt_grwl_save_nodes(bst_, &writer);
+
+    const int unlocked = pthread_rwlock_unlock(&bst_->rwl) == 0;
+
+    err = bst_snapshot_writer_close(&writer, !saved);
+
+    if (!unlocked) {
+        err |= PT_RWLOCK_UNLOCK_FAILURE;
+    }
+
+    return saved ? err : MALLOC_FAILURE;
+}
+
+// Runs in the snapshot child on its copy of the tree
+static int bst_mt_grwl_save_child(void *bst, bst_snapshot_writer_t *writer) {
+    return bst_mt_grwl_save_nodes(bst, writer);
+}
+
+BST_ERROR bst_mt_cgl_save_background(bst_mt_cgl_t **bst, const char *path,
+                                     bst_snapshot_job_t *job) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_mt_cgl_t *bst_ = *bst;
+
+    // Readers may go on, the child only needs no writer mid-operation
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    const BST_ERROR err =
+        bst_snapshot_fork(job, path, bst_mt_grwl_save_child, bst_);
+
+    if (pthread_rwlock_unlock(&bst_->rwl)) {
+        return PT_RWLOCK_UNLOCK_FAILURE | err;
+    }
+
+    return err;
+}
+
+// Builds a balanced subtree from the sorted keys [lo, hi), the middle key is
+// the subtree root. Stops allocating after the first failure, err is set and
+// the partial tree stays linked so it can be freed.
+static bst_mt_cgl_node_t *bst_mt_grwl_build(bst_mt_cgl_t *bst,
+                                            const int64_t *keys,
+                                            const size_t lo, const size_t hi,
+                                            BST_ERROR *err) {
+    if (lo >= hi || !IS_SUCCESS(*err)) {
+        return NULL;
+    }
+
+    const size_t mid = lo + (hi - lo) / 2;
+    bst_mt_cgl_node_t *node = bst_mt_grwl_node_new(bst, keys[mid], err);
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    bst_mt_cgl_node_t *left = bst_mt_grwl_build(bst, keys, lo, mid, err);
+    bst_mt_cgl_node_t *right = bst_mt_grwl_build(bst, keys, mid + 1, hi, err);
+
+    node->left = bst_mt_cgl_ref(bst, left);
+    node->right = bst_mt_cgl_ref(bst, right);
+
+    return node;
+}
+
+bst_mt_cgl_t *bst_mt_cgl_load(const char *path, BST_ERROR *err) {
+    bst_snapshot_t snap;
+    BST_ERROR e = bst_snapshot_map(path, &snap);
+
+    if (!IS_SUCCESS(e)) {
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst_mt_cgl_t *bst = bst_mt_cgl_new(&e);
+
+    if (bst == NULL) {
+        bst_snapshot_unmap(&snap);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    const size_t count = snap.count;
+    bst_mt_cgl_node_t *root = bst_mt_grwl_build(bst, snap.keys, 0, count, &e);
+    bst_snapshot_unmap(&snap);
+
+    bst->root = bst_mt_cgl_ref(bst, root);
+
+    if (!IS_SUCCESS(e)) {
+        bst_mt_cgl_free(&bst);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst->count = count;
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return bst;
+}
+
+#ifdef BST_COMPACT_NODES
+bst_mt_cgl_t *bst_mt_cgl_open(const char *path, BST_ERROR *err) {
+    bst_mt_cgl_t *bst = malloc(sizeof(bst_mt_cgl_t));
+
+    if (bst == NULL) {
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+        return NULL;
+    }
+
+    if (pthread_rwlock_init(&bst->rwl, NULL)) {
+        free(bst);
+
+        if (err != NULL) {
+            *err = PT_RWLOCK_INIT_FAILURE;
+        }
+
+        return NULL;
+    }
+
+    uint32_t root = BST_MT_CGL_NIL;
+    uint64_t count = 0;
+
+    const BST_ERROR e = bst_pool_open(&bst->pool, sizeof(bst_mt_cgl_node_t),
+                                      path, &root, &count);
+
+    if (!IS_SUCCESS(e)) {
+        pthread_rwlock_destroy(&bst->rwl);
+        free(bst);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst->count = count;
+    bst->root = root;
+    bst->allocs = count; // Nodes allocated before the restart
+    bst->frees = 0;
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return bst;
 }
 
+BST_ERROR bst_mt_cgl_checkpoint(bst_mt_cgl_t **bst) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_mt_cgl_t *bst_ = *bst;
+
+    // Exclusive, the dirty pages are dropped after they are written back
+    if (pthread_rwlock_wrlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    BST_ERROR err = bst_pool_checkpoint(&bst_->pool, bst_->root, bst_->count);
+
+    if (pthread_rwlock_unlock(&bst_->rwl)) {
+        err |= PT_RWLOCK_UNLOCK_FAILURE;
+    }
+
+    return err;
+}
+#endif
+
 BST_ERROR bst_mt_cgl_free(bst_mt_cgl_t **bst) {
     if (bst == NULL || *bst == NULL) {
         return BST_NULL;
@@ -441,8 +788,12 @@ BST_ERROR bst_mt_cgl_free(bst_mt_cgl_t **bst) {
 
     *bst = NULL; // No other operations will start
 
+#ifdef BST_COMPACT_NODES
+    bst_pool_destroy(&bst_->pool); // Releases every node at once
+#else
     bst_mt_grwl_node_free(bst_->root);
-    bst_->root = NULL;
+#endif
+    bst_->root = BST_MT_CGL_NIL;
     bst_->count = 0;
 
     if (pthread_rwlock_unlock(&bst_->rwl)) {
@@ -456,4 +807,68 @@ BST_ERROR bst_mt_cgl_free(bst_mt_cgl_t **bst) {
     free(bst_);
 
     return SUCCESS;
-}
\ No newline at end of file
+}
+
+// The bst_mt_cgl_engine wrappers, see bst_engine.h
+static void *bst_mt_cgl_engine_new(const bst_engine_config_t *config,
+                                   BST_ERROR *err) {
+    (void)config;
+    return bst_mt_cgl_new(err);
+}
+
+static BST_ERROR bst_mt_cgl_engine_free(void **bst) {
+    return bst_mt_cgl_free((bst_mt_cgl_t **)bst);
+}
+
+static BST_ERROR bst_mt_cgl_engine_add(void **bst, const int64_t value) {
+    return bst_mt_cgl_add((bst_mt_cgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_cgl_engine_search(void **bst, const int64_t value) {
+    return bst_mt_cgl_search((bst_mt_cgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_cgl_engine_min(void **bst, int64_t *value) {
+    return bst_mt_cgl_min((bst_mt_cgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_cgl_engine_max(void **bst, int64_t *value) {
+    return bst_mt_cgl_max((bst_mt_cgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_cgl_engine_delete(void **bst, const int64_t value) {
+    return bst_mt_cgl_delete((bst_mt_cgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_cgl_engine_count(void **bst, size_t *value) {
+    return bst_mt_cgl_node_count((bst_mt_cgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_cgl_engine_stats(void **bst,
+                                         bst_engine_stats_t *stats) {
+    *stats = (bst_engine_stats_t){0};
+    return bst_mt_cgl_memory_stats((bst_mt_cgl_t **)bst, &stats->memory);
+}
+
+static BST_ERROR bst_mt_cgl_engine_save_background(void **bst, const char *path,
+                                                   bst_snapshot_job_t *job) {
+    return bst_mt_cgl_save_background((bst_mt_cgl_t **)bst, path, job);
+}
+
+const bst_engine_ops bst_mt_cgl_engine = {
+    .abi_version = BST_ENGINE_ABI_VERSION,
+    .name = "CGL",
+    .threaded = 1,
+    .node_size = sizeof(bst_mt_cgl_node_t),
+    .node_lock = "none",
+    .new = bst_mt_cgl_engine_new,
+    .free = bst_mt_cgl_engine_free,
+    .add = bst_mt_cgl_engine_add,
+    .search = bst_mt_cgl_engine_search,
+    .min = bst_mt_cgl_engine_min,
+    .max = bst_mt_cgl_engine_max,
+    .delete = bst_mt_cgl_engine_delete,
+    .count = bst_mt_cgl_engine_count,
+    .stats = bst_mt_cgl_engine_stats,
+    .save_background = bst_mt_cgl_engine_save_background,
+};
@@ -28,15 +28,539 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 IN THE SOFTWARE.
 */
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../include/bst_arena.h"
 #include "../include/bst_common.h"
+#include "../include/bst_snapshot.h"
 #include "include/bst_mt_fgl.h"
 
+#if defined(BST_FGL_LOCK_FUTEX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Spins before a waiting thread yields the CPU, a preempted lock holder
+// would otherwise burn the waiters whole time slices.
+#define LOCK_SPINS 128
+
+static inline void cpu_relax(unsigned *spins) {
+    if (++*spins % LOCK_SPINS == 0) {
+        sched_yield();
+        return;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Node lock backends, see bst_mt_fgl_lock.h
+#if defined(BST_FGL_LOCK_SPIN)
+static inline int bst_mt_fgl_lock_init(bst_mt_fgl_lock_t *lock) {
+    atomic_init(lock, 0);
+    return 0;
+}
+
+static inline int bst_mt_fgl_lock(bst_mt_fgl_lock_t *lock) {
+    unsigned spins = 0;
+
+    for (;;) {
+        if (!atomic_exchange_explicit(lock, 1, memory_order_acquire)) {
+            return 0;
+        }
+
+        // Spin on a plain load so waiters do not bounce the cache line
+        while (atomic_load_explicit(lock, memory_order_relaxed)) {
+            cpu_relax(&spins);
+        }
+    }
+}
+
+static inline int bst_mt_fgl_trylock(bst_mt_fgl_lock_t *lock) {
+    if (atomic_load_explicit(lock, memory_order_relaxed) ||
+        atomic_exchange_explicit(lock, 1, memory_order_acquire)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static inline int bst_mt_fgl_unlock(bst_mt_fgl_lock_t *lock) {
+    atomic_store_explicit(lock, 0, memory_order_release);
+    return 0;
+}
+
+static inline void bst_mt_fgl_lock_wait(bst_mt_fgl_lock_t *lock) {
+    unsigned spins = 0;
+
+    while (atomic_load_explicit(lock, memory_order_relaxed)) {
+        cpu_relax(&spins);
+    }
+}
+
+static inline int bst_mt_fgl_lock_destroy(bst_mt_fgl_lock_t *lock) {
+    (void)lock;
+    return 0;
+}
+#elif defined(BST_FGL_LOCK_TICKET)
+#define TICKET_NEXT (1u << 16)
+#define TICKET_OWNER_MASK 0xffffu
+
+static inline int bst_mt_fgl_lock_init(bst_mt_fgl_lock_t *lock) {
+    atomic_init(lock, 0);
+    return 0;
+}
+
+static inline int bst_mt_fgl_lock(bst_mt_fgl_lock_t *lock) {
+    const uint32_t ticket =
+        atomic_fetch_add_explicit(lock, TICKET_NEXT, memory_order_relaxed) >>
+        16;
+    unsigned spins = 0;
+
+    while ((atomic_load_explicit(lock, memory_order_acquire) &
+            TICKET_OWNER_MASK) != ticket) {
+        cpu_relax(&spins);
+    }
+
+    return 0;
+}
+
+static inline int bst_mt_fgl_trylock(bst_mt_fgl_lock_t *lock) {
+    uint32_t v = atomic_load_explicit(lock, memory_order_relaxed);
+
+    if ((v >> 16) != (v & TICKET_OWNER_MASK)) {
+        return 1;
+    }
+
+    return !atomic_compare_exchange_strong_explicit(
+        lock, &v, v + TICKET_NEXT, memory_order_acquire, memory_order_relaxed);
+}
+
+static inline int bst_mt_fgl_unlock(bst_mt_fgl_lock_t *lock) {
+    // Only the owner half changes, a carry must not reach the next ticket
+    uint32_t v = atomic_load_explicit(lock, memory_order_relaxed);
+    uint32_t n;
+
+    do {
+        n = (v & ~TICKET_OWNER_MASK) | ((v + 1) & TICKET_OWNER_MASK);
+    } while (!atomic_compare_exchange_weak_explicit(
+        lock, &v, n, memory_order_release, memory_order_relaxed));
+
+    return 0;
+}
+
+// Waits without taking a ticket, a queued restart would be handed the lock
+// and make the holder it waits for restart in turn, forever.
+static inline void bst_mt_fgl_lock_wait(bst_mt_fgl_lock_t *lock) {
+    unsigned spins = 0;
+    uint32_t v;
+
+    while (v = atomic_load_explicit(lock, memory_order_relaxed),
+           (v >> 16) != (v & TICKET_OWNER_MASK)) {
+        cpu_relax(&spins);
+    }
+}
+
+static inline int bst_mt_fgl_lock_destroy(bst_mt_fgl_lock_t *lock) {
+    (void)lock;
+    return 0;
+}
+#elif defined(BST_FGL_LOCK_FUTEX)
+// Spins before sleeping on the futex
+#define FUTEX_SPINS 100
+
+static inline void futex_wait(bst_mt_fgl_lock_t *lock, const uint32_t val) {
+    syscall(SYS_futex, lock, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void futex_wake(bst_mt_fgl_lock_t *lock) {
+    syscall(SYS_futex, lock, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static inline int bst_mt_fgl_lock_init(bst_mt_fgl_lock_t *lock) {
+    atomic_init(lock, 0);
+    return 0;
+}
+
+static inline int bst_mt_fgl_lock(bst_mt_fgl_lock_t *lock) {
+    uint32_t c = 0;
+    unsigned spins = 0;
+
+    for (int i = 0; i < FUTEX_SPINS; i++) {
+        c = 0;
+        if (atomic_compare_exchange_weak_explicit(lock, &c, 1,
+                                                  memory_order_acquire,
+                                                  memory_order_relaxed)) {
+            return 0;
+        }
+        cpu_relax(&spins);
+    }
+
+    // Mark the lock as contended and sleep until it is released
+    if (c != 2) {
+        c = atomic_exchange_explicit(lock, 2, memory_order_acquire);
+    }
+
+    while (c != 0) {
+        futex_wait(lock, 2);
+        c = atomic_exchange_explicit(lock, 2, memory_order_acquire);
+    }
+
+    return 0;
+}
+
+static inline int bst_mt_fgl_trylock(bst_mt_fgl_lock_t *lock) {
+    uint32_t c = 0;
+
+    return !atomic_compare_exchange_strong_explicit(
+        lock, &c, 1, memory_order_acquire, memory_order_relaxed);
+}
+
+static inline int bst_mt_fgl_unlock(bst_mt_fgl_lock_t *lock) {
+    if (atomic_fetch_sub_explicit(lock, 1, memory_order_release) != 1) {
+        atomic_store_explicit(lock, 0, memory_order_release);
+        futex_wake(lock);
+    }
+
+    return 0;
+}
+
+static inline void bst_mt_fgl_lock_wait(bst_mt_fgl_lock_t *lock) {
+    bst_mt_fgl_lock(lock);
+    bst_mt_fgl_unlock(lock);
+}
+
+static inline int bst_mt_fgl_lock_destroy(bst_mt_fgl_lock_t *lock) {
+    (void)lock;
+    return 0;
+}
+#else
+static inline int bst_mt_fgl_lock_init(bst_mt_fgl_lock_t *lock) {
+    return pthread_mutex_init(lock, NULL);
+}
+
+static inline int bst_mt_fgl_lock(bst_mt_fgl_lock_t *lock) {
+    return pthread_mutex_lock(lock);
+}
+
+static inline int bst_mt_fgl_trylock(bst_mt_fgl_lock_t *lock) {
+    return pthread_mutex_trylock(lock);
+}
+
+static inline int bst_mt_fgl_unlock(bst_mt_fgl_lock_t *lock) {
+    return pthread_mutex_unlock(lock);
+}
+
+static inline void bst_mt_fgl_lock_wait(bst_mt_fgl_lock_t *lock) {
+    pthread_mutex_lock(lock);
+    pthread_mutex_unlock(lock);
+}
+
+static inline int bst_mt_fgl_lock_destroy(bst_mt_fgl_lock_t *lock) {
+    return pthread_mutex_destroy(lock);
+}
+#endif
+
+// Most node locks held at once, by delete while unlinking a successor
+#define FGL_MAX_HELD 4
+
+/**
+ * Node locks held by an operation. Nodes sharing a stripe share one entry
+ * with a reference count, so the stripe is only taken and released once.
+ */
+typedef struct fgl_held {
+    bst_mt_fgl_lock_t *locks[FGL_MAX_HELD];
+    unsigned counts[FGL_MAX_HELD];
+    int n;
+    bst_mt_fgl_lock_t *busy;
+} fgl_held_t;
+
+static inline bst_mt_fgl_lock_t *fgl_node_lock(const bst_mt_fgl_t *bst,
+                                               bst_mt_fgl_node_t *node) {
+#ifdef BST_FGL_STRIPED
+    const uint64_t h = (uint64_t)(uintptr_t)node * 0x9E3779B97F4A7C15ull;
+    return &bst->stripes[(h >> 32) & bst->stripe_mask].lock;
+#else
+    (void)bst;
+    return &node->lock;
+#endif
+}
+
+// Locks node for the operation. Tree order keeps node locks deadlock free,
+// stripes are only waited on in ascending table order and any other stripe
+// is tried once. Returns 1 when the stripe is busy, the caller then calls
+// fgl_restart() and starts over from the root.
+static int fgl_acquire(const bst_mt_fgl_t *bst, fgl_held_t *held,
+                       bst_mt_fgl_node_t *node) {
+    bst_mt_fgl_lock_t *lock = fgl_node_lock(bst, node);
+    int blocking = 1;
+
+    for (int i = 0; i < held->n; i++) {
+        if (held->locks[i] == lock) {
+            held->counts[i]++;
+            return 0;
+        }
+#ifdef BST_FGL_STRIPED
+        if (held->locks[i] > lock) {
+            blocking = 0;
+        }
+#endif
+    }
+
+    if (blocking) {
+        bst_mt_fgl_lock(lock);
+    } else if (bst_mt_fgl_trylock(lock)) {
+        held->busy = lock;
+        return 1;
+    }
+
+    held->locks[held->n] = lock;
+    held->counts[held->n] = 1;
+    held->n++;
+
+    return 0;
+}
+
+static void fgl_release(const bst_mt_fgl_t *bst, fgl_held_t *held,
+                        bst_mt_fgl_node_t *node) {
+    bst_mt_fgl_lock_t *lock = fgl_node_lock(bst, node);
+
+    for (int i = 0; i < held->n; i++) {
+        if (held->locks[i] == lock) {
+            if (--held->counts[i] == 0) {
+                bst_mt_fgl_unlock(lock);
+                held->n--;
+                held->locks[i] = held->locks[held->n];
+                held->counts[i] = held->counts[held->n];
+            }
+            return;
+        }
+    }
+}
+
+static void fgl_release_all(fgl_held_t *held) {
+    for (int i = 0; i < held->n; i++) {
+        bst_mt_fgl_unlock(held->locks[i]);
+    }
+
+    held->n = 0;
+}
+
+// Releases everything after a failed fgl_acquire() and waits for the busy
+// stripe to be released, so a restart does not spin against a preempted
+// holder.
+static void fgl_restart(fgl_held_t *held) {
+    fgl_release_all(held);
+
+    bst_mt_fgl_lock_wait(held->busy);
+    held->busy = NULL;
+}
+
+// Epoch record states. A record is ACTIVE while owned by a thread, FREE when
+// it can be adopted by another thread and ORPHANED when the BST was freed
+// while a thread still owned it, the owner frees it on release.
+enum { EBR_FREE = 0, EBR_ACTIVE = 1, EBR_ORPHANED = 2 };
+
+// Record owned by the calling thread, cached across operations
+static _Thread_local bst_mt_fgl_ebr_record_t *ebr_local = NULL;
+
+static pthread_key_t ebr_key;
+static pthread_once_t ebr_key_once = PTHREAD_ONCE_INIT;
+
+static void bst_mt_lrwl_node_destroy(bst_mt_fgl_node_t *node) {
+#ifndef BST_FGL_STRIPED
+    bst_mt_fgl_lock_destroy(&node->lock);
+#endif
+    bst_arena_free(node, sizeof(bst_mt_fgl_node_t));
+}
+
+static void ebr_limbo_free(bst_mt_fgl_t *bst, bst_mt_fgl_limbo_t *limbo) {
+    if (limbo->count == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < limbo->count; i++) {
+        bst_mt_lrwl_node_destroy(limbo->nodes[i]);
+    }
+
+    atomic_fetch_add(&bst->frees, limbo->count);
+    limbo->count = 0;
+}
+
+static void ebr_record_destroy(bst_mt_fgl_ebr_record_t *rec) {
+    for (int i = 0; i < BST_MT_FGL_EBR_LISTS; i++) {
+        ebr_limbo_free(rec->bst, &rec->limbo[i]);
+        free(rec->limbo[i].nodes);
+    }
+
+    free(rec);
+}
+
+static void ebr_record_release(bst_mt_fgl_ebr_record_t *rec) {
+    atomic_store(&rec->epoch, 0);
+
+    // Limbo lists stay in the record, the next owner or bst_mt_fgl_free will
+    // reclaim them.
+    if (atomic_exchange(&rec->state, EBR_FREE) == EBR_ORPHANED) {
+        ebr_record_destroy(rec);
+    }
+}
+
+static void ebr_thread_exit(void *rec) { ebr_record_release(rec); }
+
+static void ebr_key_create(void) {
+    pthread_key_create(&ebr_key, ebr_thread_exit);
+}
+
+static bst_mt_fgl_ebr_record_t *ebr_record_acquire(bst_mt_fgl_t *bst) {
+    pthread_once(&ebr_key_once, ebr_key_create);
+
+    // Adopt a record released by a thread that is gone
+    bst_mt_fgl_ebr_record_t *rec = atomic_load(&bst->ebr_records);
+    while (rec != NULL) {
+        int expected = EBR_FREE;
+        if (atomic_load(&rec->state) == EBR_FREE &&
+            atomic_compare_exchange_strong(&rec->state, &expected,
+                                           EBR_ACTIVE)) {
+            return rec;
+        }
+        rec = rec->next;
+    }
+
+    rec = calloc(1, sizeof(bst_mt_fgl_ebr_record_t));
+    if (rec == NULL) {
+        return NULL;
+    }
+
+    atomic_store(&rec->epoch, 0);
+    atomic_store(&rec->state, EBR_ACTIVE);
+    rec->bst = bst;
+
+    // Insert into the BST epoch record list
+    bst_mt_fgl_ebr_record_t *old_head = NULL;
+    do {
+        old_head = atomic_load(&bst->ebr_records);
+        rec->next = old_head;
+    } while (!atomic_compare_exchange_weak(&bst->ebr_records, &old_head, rec));
+
+    return rec;
+}
+
+// Returns the calling thread record for bst, registering one on first use.
+static bst_mt_fgl_ebr_record_t *ebr_record(bst_mt_fgl_t *bst) {
+    bst_mt_fgl_ebr_record_t *rec = ebr_local;
+
+    if (rec != NULL && rec->bst == bst &&
+        atomic_load(&rec->state) == EBR_ACTIVE) {
+        return rec;
+    }
+
+    if (rec != NULL) {
+        ebr_record_release(rec);
+    }
+
+    rec = ebr_record_acquire(bst);
+    ebr_local = rec;
+    pthread_setspecific(ebr_key, rec);
+
+    return rec;
+}
+
+// Frees the limbo lists retired at least two epochs before epoch. No
+// operation that could still see those nodes is running anymore.
+static void ebr_reclaim(bst_mt_fgl_ebr_record_t *rec, const uint64_t epoch) {
+    for (int i = 0; i < BST_MT_FGL_EBR_LISTS; i++) {
+        if (rec->limbo[i].count > 0 && rec->limbo[i].epoch + 2 <= epoch) {
+            ebr_limbo_free(rec->bst, &rec->limbo[i]);
+        }
+    }
+}
+
+// Advances the global epoch if every thread inside an operation has already
+// observed the current one.
+static uint64_t ebr_try_advance(bst_mt_fgl_t *bst) {
+    uint64_t epoch = atomic_load(&bst->epoch);
+
+    for (bst_mt_fgl_ebr_record_t *r = atomic_load(&bst->ebr_records);
+         r != NULL; r = r->next) {
+        const uint64_t e = atomic_load(&r->epoch);
+
+        if ((e & 1) && (e >> 1) != epoch) {
+            return epoch;
+        }
+    }
+
+    if (atomic_compare_exchange_strong(&bst->epoch, &epoch, epoch + 1)) {
+        return epoch + 1;
+    }
+
+    return epoch; // Advanced by another thread
+}
+
+// Marks the calling thread as inside an operation on bst. Nodes reachable
+// from the tree stay allocated until the matching ebr_exit.
+static bst_mt_fgl_ebr_record_t *ebr_enter(bst_mt_fgl_t *bst) {
+    bst_mt_fgl_ebr_record_t *rec = ebr_record(bst);
+
+    if (rec == NULL) {
+        return NULL;
+    }
+
+    const uint64_t epoch = atomic_load(&bst->epoch);
+    atomic_store(&rec->epoch, epoch << 1 | 1);
+
+    ebr_reclaim(rec, epoch);
+
+    return rec;
+}
+
+static void ebr_exit(bst_mt_fgl_ebr_record_t *rec) {
+    atomic_store(&rec->epoch, 0);
+}
+
+// Defers freeing an unlinked node until no operation can still reach it. The
+// limbo list of the current epoch reuses the slot of epoch - 3, which is
+// always safe to free first.
+static void ebr_retire(bst_mt_fgl_t *bst, bst_mt_fgl_ebr_record_t *rec,
+                       bst_mt_fgl_node_t *node) {
+    const uint64_t epoch = atomic_load(&bst->epoch);
+    bst_mt_fgl_limbo_t *limbo = &rec->limbo[epoch % BST_MT_FGL_EBR_LISTS];
+
+    if (limbo->epoch != epoch) {
+        ebr_limbo_free(bst, limbo);
+        limbo->epoch = epoch;
+    }
+
+    if (limbo->count == limbo->capacity) {
+        const size_t capacity = limbo->capacity == 0 ? 16 : limbo->capacity * 2;
+        bst_mt_fgl_node_t **nodes =
+            realloc(limbo->nodes, capacity * sizeof(bst_mt_fgl_node_t *));
+
+        if (nodes == NULL) {
+            return; // Out of memory, the node is leaked
+        }
+
+        limbo->nodes = nodes;
+        limbo->capacity = capacity;
+    }
+
+    limbo->nodes[limbo->count++] = node;
+
+    if (limbo->count % BST_MT_FGL_EBR_THRESHOLD == 0) {
+        ebr_reclaim(rec, ebr_try_advance(bst));
+    }
+}
+
 bst_mt_fgl_node_t *bst_mt_lrwl_node_new(const int64_t value, BST_ERROR *err) {
-    bst_mt_fgl_node_t *node = malloc(sizeof(bst_mt_fgl_node_t));
+    bst_mt_fgl_node_t *node = bst_arena_alloc(sizeof(bst_mt_fgl_node_t));
 
     if (node == NULL) {
         if (err != NULL) {
@@ -46,7 +570,9 @@ bst_mt_fgl_node_t *bst_mt_lrwl_node_new(const int64_t value, BST_ERROR *err) {
         return NULL;
     }
 
-    pthread_mutex_init(&node->mtx, NULL);
+#ifndef BST_FGL_STRIPED
+    bst_mt_fgl_lock_init(&node->lock);
+#endif
 
     node->value = value;
     node->left = NULL;
@@ -59,7 +585,15 @@ bst_mt_fgl_node_t *bst_mt_lrwl_node_new(const int64_t value, BST_ERROR *err) {
     return node;
 }
 
+#ifdef BST_FGL_STRIPED
+bst_mt_fgl_t *bst_mt_fgl_new(BST_ERROR *err) {
+    return bst_mt_fgl_new_striped(BST_FGL_STRIPES, err);
+}
+
+bst_mt_fgl_t *bst_mt_fgl_new_striped(size_t stripes, BST_ERROR *err) {
+#else
 bst_mt_fgl_t *bst_mt_fgl_new(BST_ERROR *err) {
+#endif
     bst_mt_fgl_t *bst = malloc(sizeof(bst_mt_fgl_t));
 
     if (bst == NULL) {
@@ -70,120 +604,137 @@ bst_mt_fgl_t *bst_mt_fgl_new(BST_ERROR *err) {
         return NULL;
     }
 
+#ifdef BST_FGL_STRIPED
+    size_t size = 1;
+    while (size < stripes) {
+        size <<= 1;
+    }
+
+    bst->stripes = aligned_alloc(alignof(bst_mt_fgl_stripe_t),
+                                 size * sizeof(bst_mt_fgl_stripe_t));
+
+    if (bst->stripes == NULL) {
+        free(bst);
+
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        bst_mt_fgl_lock_init(&bst->stripes[i].lock);
+    }
+
+    bst->stripe_mask = size - 1;
+#endif
+
     pthread_mutex_init(&bst->mtx, NULL);
     pthread_mutex_init(&bst->cmtx, NULL);
 
     bst->count = 0;
     bst->root = NULL;
+    atomic_store(&bst->epoch, 0);
+    atomic_store(&bst->ebr_records, NULL);
+    atomic_store(&bst->allocs, 0);
+    atomic_store(&bst->frees, 0);
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
 
     return bst;
 }
 
-BST_ERROR bst_mt_fgl_add(bst_mt_fgl_t **bst, const int64_t value) {
-    if (bst == NULL || *bst == NULL) {
-        return BST_NULL;
-    }
+static void bst_mt_lrwl_count_add(bst_mt_fgl_t *bst, const int delta) {
+    pthread_mutex_lock(&bst->cmtx);
+    bst->count += delta;
+    pthread_mutex_unlock(&bst->cmtx);
+}
 
-    bst_mt_fgl_t *bst_ = *bst;
+static BST_ERROR bst_mt_lrwl_add(bst_mt_fgl_t *bst_, const int64_t value) {
+    fgl_held_t held = {.n = 0, .busy = NULL};
+
+retry:
     pthread_mutex_lock(&bst_->mtx);
     if (bst_->root == NULL) {
-        bst_->root = malloc(sizeof(bst_mt_fgl_node_t));
-        bst_->root->value = value;
-        bst_->root->left = bst_->root->right = NULL;
-        pthread_mutex_init(&bst_->root->mtx, NULL);
-        pthread_mutex_lock(&bst_->cmtx);
-        bst_->count++;
-        pthread_mutex_unlock(&bst_->cmtx);
+        BST_ERROR err;
+        bst_->root = bst_mt_lrwl_node_new(value, &err);
         pthread_mutex_unlock(&bst_->mtx);
+
+        if (!IS_SUCCESS(err)) {
+            return err;
+        }
+
+        atomic_fetch_add(&bst_->allocs, 1);
+        bst_mt_lrwl_count_add(bst_, 1);
         return SUCCESS;
     }
 
     bst_mt_fgl_node_t *current = bst_->root;
 
-    pthread_mutex_lock(&current->mtx);
+    fgl_acquire(bst_, &held, current);
     pthread_mutex_unlock(&bst_->mtx);
 
-    while (current != NULL) {
-        if (compare(value, current->value) < 0) {
-            if (current->left == NULL) {
-                current->left = malloc(sizeof(bst_mt_fgl_node_t));
-                current->left->value = value;
-                current->left->left = NULL;
-                current->left->right = NULL;
-                pthread_mutex_init(&current->left->mtx, NULL);
-                pthread_mutex_lock(&bst_->cmtx);
-                bst_->count++;
-                pthread_mutex_unlock(&bst_->cmtx);
-                pthread_mutex_unlock(&current->mtx);
-                return SUCCESS;
-            }
+    for (;;) {
+        bst_mt_fgl_node_t **next;
 
-            if (current->left) {
-                pthread_mutex_lock(&current->left->mtx);
-            }
-            bst_mt_fgl_node_t *t = current;
-            current = current->left;
-            pthread_mutex_unlock(&t->mtx);
+        if (compare(value, current->value) < 0) {
+            next = &current->left;
         } else if (compare(value, current->value) > 0) {
-            if (current->right == NULL) {
-                current->right = malloc(sizeof(bst_mt_fgl_node_t));
-                current->right->value = value;
-                current->right->left = NULL;
-                current->right->right = NULL;
-                pthread_mutex_init(&current->right->mtx, NULL);
-                pthread_mutex_lock(&bst_->cmtx);
-                bst_->count++;
-                pthread_mutex_unlock(&bst_->cmtx);
-                pthread_mutex_unlock(&current->mtx);
-                return SUCCESS;
-            }
-
-            if (current->right) {
-                pthread_mutex_lock(&current->right->mtx);
-            }
-
-            bst_mt_fgl_node_t *t = current;
-            current = current->right;
-            pthread_mutex_unlock(&t->mtx);
+            next = &current->right;
         } else {
-            pthread_mutex_unlock(&current->mtx);
+            fgl_release(bst_, &held, current);
             return VALUE_EXISTS; // Value already exists in the tree
         }
-    }
 
-    return SUCCESS;
-}
+        if (*next == NULL) {
+            BST_ERROR err;
+            *next = bst_mt_lrwl_node_new(value, &err);
+            fgl_release(bst_, &held, current);
 
-static int bst_mt_lrwl_find(bst_mt_fgl_node_t *root, const int64_t value) {
-    if (compare(value, root->value) < 0) {
-        if (root->left == NULL) {
-            pthread_mutex_unlock(&root->mtx);
-            return 1;
+            if (!IS_SUCCESS(err)) {
+                return err;
+            }
+
+            atomic_fetch_add(&bst_->allocs, 1);
+            bst_mt_lrwl_count_add(bst_, 1);
+            return SUCCESS;
         }
-        pthread_mutex_lock(&root->left->mtx);
-        pthread_mutex_unlock(&root->mtx);
-        return bst_mt_lrwl_find(root->left, value);
-    } else if (compare(value, root->value) > 0) {
-        if (root->right == NULL) {
-            pthread_mutex_unlock(&root->mtx);
-            return 1;
+
+        if (fgl_acquire(bst_, &held, *next)) {
+            fgl_restart(&held);
+            goto retry;
         }
-        pthread_mutex_lock(&root->right->mtx);
-        pthread_mutex_unlock(&root->mtx);
-        return bst_mt_lrwl_find(root->right, value);
-    }
 
-    pthread_mutex_unlock(&root->mtx);
-    return 0;
+        bst_mt_fgl_node_t *t = current;
+        current = *next;
+        fgl_release(bst_, &held, t);
+    }
 }
 
-BST_ERROR bst_mt_fgl_search(bst_mt_fgl_t **bst, const int64_t value) {
+BST_ERROR bst_mt_fgl_add(bst_mt_fgl_t **bst, const int64_t value) {
     if (bst == NULL || *bst == NULL) {
         return BST_NULL;
     }
 
-    bst_mt_fgl_t *bst_ = *bst;
+    bst_mt_fgl_ebr_record_t *rec = ebr_enter(*bst);
 
+    if (rec == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    const BST_ERROR err = bst_mt_lrwl_add(*bst, value);
+    ebr_exit(rec);
+
+    return err;
+}
+
+static BST_ERROR bst_mt_lrwl_search(bst_mt_fgl_t *bst_, const int64_t value) {
+    fgl_held_t held = {.n = 0, .busy = NULL};
+
+retry:
     pthread_mutex_lock(&bst_->mtx);
 
     if (bst_->root == NULL) {
@@ -191,84 +742,127 @@ BST_ERROR bst_mt_fgl_search(bst_mt_fgl_t **bst, const int64_t value) {
         return BST_EMPTY;
     }
 
-    pthread_mutex_lock(&bst_->root->mtx);
+    bst_mt_fgl_node_t *current = bst_->root;
+
+    fgl_acquire(bst_, &held, current);
     pthread_mutex_unlock(&bst_->mtx);
 
-    if (bst_mt_lrwl_find(bst_->root, value)) {
-        return VALUE_NONEXISTENT;
-    }
+    for (;;) {
+        bst_mt_fgl_node_t *next;
 
-    return SUCCESS;
+        if (compare(value, current->value) < 0) {
+            next = current->left;
+        } else if (compare(value, current->value) > 0) {
+            next = current->right;
+        } else {
+            fgl_release(bst_, &held, current);
+            return SUCCESS;
+        }
+
+        if (next == NULL) {
+            fgl_release(bst_, &held, current);
+            return VALUE_NONEXISTENT;
+        }
+
+        if (fgl_acquire(bst_, &held, next)) {
+            fgl_restart(&held);
+            goto retry;
+        }
+
+        bst_mt_fgl_node_t *t = current;
+        current = next;
+        fgl_release(bst_, &held, t);
+    }
 }
 
-BST_ERROR bst_mt_fgl_min(bst_mt_fgl_t **bst, int64_t *value) {
+BST_ERROR bst_mt_fgl_search(bst_mt_fgl_t **bst, const int64_t value) {
     if (bst == NULL || *bst == NULL) {
         return BST_NULL;
     }
 
-    bst_mt_fgl_t *bst_ = *bst;
+    bst_mt_fgl_ebr_record_t *rec = ebr_enter(*bst);
 
-    pthread_mutex_lock(&bst_->mtx);
+    if (rec == NULL) {
+        return MALLOC_FAILURE;
+    }
 
-    if (bst_->root == NULL) {
-        pthread_mutex_unlock(&bst_->mtx);
+    const BST_ERROR err = bst_mt_lrwl_search(*bst, value);
+    ebr_exit(rec);
+
+    return err;
+}
+
+// Walks to the leftmost (right == 0) or rightmost (right == 1) node
+static BST_ERROR bst_mt_lrwl_edge(bst_mt_fgl_t *bst, const int right,
+                                  int64_t *value) {
+    fgl_held_t held = {.n = 0, .busy = NULL};
+
+retry:
+    pthread_mutex_lock(&bst->mtx);
+
+    if (bst->root == NULL) {
+        pthread_mutex_unlock(&bst->mtx);
         return BST_EMPTY;
     }
 
-    bst_mt_fgl_node_t *root = bst_->root;
+    bst_mt_fgl_node_t *root = bst->root;
 
-    pthread_mutex_lock(&root->mtx);
-    pthread_mutex_unlock(&bst_->mtx);
+    fgl_acquire(bst, &held, root);
+    pthread_mutex_unlock(&bst->mtx);
+
+    bst_mt_fgl_node_t *next;
+    while ((next = right ? root->right : root->left) != NULL) {
+        if (fgl_acquire(bst, &held, next)) {
+            fgl_restart(&held);
+            goto retry;
+        }
 
-    while (root->left != NULL) {
-        pthread_mutex_lock(&root->left->mtx);
         bst_mt_fgl_node_t *t = root;
-        root = root->left;
-        pthread_mutex_unlock(&t->mtx);
+        root = next;
+        fgl_release(bst, &held, t);
     }
 
     if (value != NULL) {
         *value = root->value;
     }
 
-    pthread_mutex_unlock(&root->mtx);
+    fgl_release(bst, &held, root);
 
     return SUCCESS;
 }
 
-BST_ERROR bst_mt_fgl_max(bst_mt_fgl_t **bst, int64_t *value) {
+BST_ERROR bst_mt_fgl_min(bst_mt_fgl_t **bst, int64_t *value) {
     if (bst == NULL || *bst == NULL) {
         return BST_NULL;
     }
 
-    bst_mt_fgl_t *bst_ = *bst;
-
-    pthread_mutex_lock(&bst_->mtx);
+    bst_mt_fgl_ebr_record_t *rec = ebr_enter(*bst);
 
-    if (bst_->root == NULL) {
-        pthread_mutex_unlock(&bst_->mtx);
-        return BST_EMPTY;
+    if (rec == NULL) {
+        return MALLOC_FAILURE;
     }
 
-    bst_mt_fgl_node_t *root = bst_->root;
+    const BST_ERROR err = bst_mt_lrwl_edge(*bst, 0, value);
+    ebr_exit(rec);
 
-    pthread_mutex_lock(&root->mtx);
-    pthread_mutex_unlock(&bst_->mtx);
+    return err;
+}
 
-    while (root->right != NULL) {
-        pthread_mutex_lock(&root->right->mtx);
-        bst_mt_fgl_node_t *t = root;
-        root = root->right;
-        pthread_mutex_unlock(&t->mtx);
+BST_ERROR bst_mt_fgl_max(bst_mt_fgl_t **bst, int64_t *value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
     }
 
-    if (value != NULL) {
-        *value = root->value;
+    bst_mt_fgl_ebr_record_t *rec = ebr_enter(*bst);
+
+    if (rec == NULL) {
+        return MALLOC_FAILURE;
     }
 
-    pthread_mutex_unlock(&root->mtx);
+    const BST_ERROR err = bst_mt_lrwl_edge(*bst, 1, value);
+    ebr_exit(rec);
 
-    return SUCCESS;
+    return err;
 }
 
 BST_ERROR bst_mt_fgl_node_count(bst_mt_fgl_t **bst, size_t *value) {
@@ -289,65 +883,86 @@ BST_ERROR bst_mt_fgl_node_count(bst_mt_fgl_t **bst, size_t *value) {
     return SUCCESS;
 }
 
-static void bst_mt_lrwl_delete_root(bst_mt_fgl_t *bst) {
-    bst_mt_fgl_node_t *root = bst->root;
+// Retires an unlinked node, it is freed once no operation can reach it
+static void bst_mt_lrwl_node_delete(bst_mt_fgl_t *bst,
+                                    bst_mt_fgl_ebr_record_t *rec,
+                                    bst_mt_fgl_node_t *node) {
+    ebr_retire(bst, rec, node);
 
-    // No children
-    if (root->left == NULL && root->right == NULL) {
-        bst->root = NULL;
-        pthread_mutex_unlock(&root->mtx);
-        //pthread_mutex_destroy(&root->mtx);
-        //free(root);
-        pthread_mutex_unlock(&bst->mtx);
-        return;
-    }
+    bst_mt_lrwl_count_add(bst, -1);
+}
 
-    // Single child
-    if (root->left == NULL || root->right == NULL) {
-        bst->root = root->left ? root->left : root->right;
-        pthread_mutex_unlock(&root->mtx);
-        //pthread_mutex_destroy(&root->mtx);
-        //free(root);
-        pthread_mutex_unlock(&bst->mtx);
-        return;
+// Replaces the value of node, which has both children, with its in-order
+// successor and unlinks the successor. node is held on entry and released on
+// return, its parent does not need to be held since node stays in place.
+// Returns 1 without changes when a stripe is busy, everything is released and
+// the caller starts over.
+static int bst_mt_lrwl_delete_successor(bst_mt_fgl_t *bst,
+                                        bst_mt_fgl_ebr_record_t *rec,
+                                        fgl_held_t *held,
+                                        bst_mt_fgl_node_t *node) {
+    bst_mt_fgl_node_t *parent = node;
+    bst_mt_fgl_node_t *curr = node->right;
+
+    if (fgl_acquire(bst, held, curr)) {
+        fgl_restart(held);
+        return 1;
     }
 
-    // Both children
-    bst_mt_fgl_node_t *parent = root;
-    bst_mt_fgl_node_t *curr = root->right;
-    pthread_mutex_lock(&curr->mtx);
-    pthread_mutex_unlock(&bst->mtx);
-
-    for (;;) {
-        if (curr->left == NULL) {
-            root->value = curr->value;
-            if (parent == root) {
-                parent->right = curr->right == NULL ? NULL : curr->right;
-            } else {
-                parent->left = curr->right == NULL ? NULL : curr->right;
-                pthread_mutex_unlock(&parent->mtx);
-            }
-            //free(curr);
-            pthread_mutex_unlock(&root->mtx);
-            return;
+    while (curr->left != NULL) {
+        if (fgl_acquire(bst, held, curr->left)) {
+            fgl_restart(held);
+            return 1;
         }
-
-        pthread_mutex_lock(&curr->left->mtx);
-        if (parent != root) {
-            pthread_mutex_unlock(&parent->mtx);
+        if (parent != node) {
+            fgl_release(bst, held, parent);
         }
         parent = curr;
         curr = curr->left;
     }
+
+    node->value = curr->value;
+    if (parent == node) {
+        parent->right = curr->right;
+    } else {
+        parent->left = curr->right;
+        fgl_release(bst, held, parent);
+    }
+
+    fgl_release(bst, held, curr);
+    fgl_release(bst, held, node);
+    bst_mt_lrwl_node_delete(bst, rec, curr);
+
+    return 0;
 }
 
-BST_ERROR bst_mt_fgl_delete(bst_mt_fgl_t **bst, const int64_t value) {
-    if (bst == NULL || *bst == NULL) {
-        return BST_NULL;
+// Deletes the root, bst->mtx and the root are held on entry and released on
+// return. Returns 1 when the caller must restart.
+static int bst_mt_lrwl_delete_root(bst_mt_fgl_t *bst,
+                                   bst_mt_fgl_ebr_record_t *rec,
+                                   fgl_held_t *held) {
+    bst_mt_fgl_node_t *root = bst->root;
+
+    // No children or single child
+    if (root->left == NULL || root->right == NULL) {
+        bst->root = root->left ? root->left : root->right;
+        fgl_release(bst, held, root);
+        pthread_mutex_unlock(&bst->mtx);
+        bst_mt_lrwl_node_delete(bst, rec, root);
+        return 0;
     }
 
-    bst_mt_fgl_t *bst_ = *bst;
+    // Both children, the root node stays in place
+    pthread_mutex_unlock(&bst->mtx);
+    return bst_mt_lrwl_delete_successor(bst, rec, held, root);
+}
+
+static BST_ERROR bst_mt_lrwl_delete(bst_mt_fgl_t *bst_,
+                                    bst_mt_fgl_ebr_record_t *rec,
+                                    const int64_t value) {
+    fgl_held_t held = {.n = 0, .busy = NULL};
 
+retry:
     pthread_mutex_lock(&bst_->mtx);
 
     bst_mt_fgl_node_t *root = bst_->root;
@@ -357,9 +972,11 @@ BST_ERROR bst_mt_fgl_delete(bst_mt_fgl_t **bst, const int64_t value) {
         return BST_EMPTY;
     }
 
-    pthread_mutex_lock(&root->mtx);
+    fgl_acquire(bst_, &held, root);
     if (root->value == value) {
-        bst_mt_lrwl_delete_root(bst_);
+        if (bst_mt_lrwl_delete_root(bst_, rec, &held)) {
+            goto retry;
+        }
         return SUCCESS;
     }
 
@@ -367,111 +984,70 @@ BST_ERROR bst_mt_fgl_delete(bst_mt_fgl_t **bst, const int64_t value) {
 
     bst_mt_fgl_node_t *curr = root;
     bst_mt_fgl_node_t *parent = NULL;
-    bst_mt_fgl_node_t *next = NULL;
 
+    // Hand-over-hand until curr holds the value, parent and curr held
     for (;;) {
-        if (value < curr->value) {
-            if (curr->left == NULL) {
-                pthread_mutex_unlock(&curr->mtx);
-                if (parent) {
-                    pthread_mutex_unlock(&parent->mtx);
-                }
-                return VALUE_NONEXISTENT;
-            }
-            next = curr->left;
-        } else if (value > curr->value) {
-            if (curr->right == NULL) { // The value doesn't exist
-                pthread_mutex_unlock(&curr->mtx);
-                if (parent) {
-                    pthread_mutex_unlock(&parent->mtx);
-                }
-                return VALUE_NONEXISTENT;
-            }
-            next = curr->right;
-        } else {
-            if (curr->left == NULL && curr->right == NULL) {
-                if (curr == parent->left) {
-                    parent->left = NULL;
-                } else {
-                    parent->right = NULL;
-                }
+        const int64_t cmp = compare(value, curr->value);
 
-                pthread_mutex_unlock(&curr->mtx);
-                pthread_mutex_unlock(&parent->mtx);
-                free(curr);
-                pthread_mutex_lock(&bst_->cmtx);
-                bst_->count--;
-                pthread_mutex_unlock(&bst_->cmtx);
-                return SUCCESS;
-
-            } else if (curr->left == NULL || curr->right == NULL) {
-                // One child
-                if (curr == parent->left) {
-                    parent->left =
-                        curr->left == NULL ? curr->right : curr->left;
-                } else {
-                    parent->right =
-                        curr->left == NULL ? curr->right : curr->left;
-                }
+        if (cmp == 0) {
+            break;
+        }
 
-                free(curr);
-                if (parent) {
-                    pthread_mutex_unlock(&parent->mtx);
-                }
-                pthread_mutex_lock(&bst_->cmtx);
-                bst_->count--;
-                pthread_mutex_unlock(&bst_->cmtx);
-                return SUCCESS;
-
-            } else {
-                bst_mt_fgl_node_t *curr_parent = curr;
-                bst_mt_fgl_node_t *curr_min = curr->right;
-                pthread_mutex_lock(&curr_min->mtx);
-
-                for (;;) {
-                    if (curr_min->left == NULL) {
-                        curr->value = curr_min->value;
-                        if (curr_parent == curr) {
-                            curr_parent->right = curr_min->right == NULL
-                                                     ? NULL
-                                                     : curr_min->right;
-                        } else {
-                            curr_parent->left = curr_min->right == NULL
-                                                    ? NULL
-                                                    : curr_min->right;
-                            pthread_mutex_unlock(&curr_parent->mtx);
-                        }
-
-                        free(curr_min);
-                        pthread_mutex_unlock(&curr->mtx);
-                        pthread_mutex_unlock(&parent->mtx);
-                        pthread_mutex_lock(&bst_->cmtx);
-                        bst_->count--;
-                        pthread_mutex_unlock(&bst_->cmtx);
-
-                        return SUCCESS;
-                    }
-
-                    // If we haven't found the minimum element, continue
-                    // traversing.
-                    pthread_mutex_unlock(&parent->mtx);
-                    pthread_mutex_unlock(&curr_min->left->mtx);
-                    if (curr_parent != curr) {
-                        pthread_mutex_unlock(&curr_parent->mtx);
-                    }
-                    curr_parent = curr_min;
-                    curr_min = curr_min->left;
-                }
-            }
+        bst_mt_fgl_node_t *next = cmp < 0 ? curr->left : curr->right;
+
+        if (next == NULL) { // The value doesn't exist
+            fgl_release_all(&held);
+            return VALUE_NONEXISTENT;
         }
 
-        pthread_mutex_lock(&next->mtx);
+        if (fgl_acquire(bst_, &held, next)) {
+            fgl_restart(&held);
+            goto retry;
+        }
         if (parent) {
-            pthread_mutex_unlock(&parent->mtx);
+            fgl_release(bst_, &held, parent);
         }
         parent = curr;
         curr = next;
     }
+
+    if (curr->left != NULL && curr->right != NULL) {
+        fgl_release(bst_, &held, parent);
+        if (bst_mt_lrwl_delete_successor(bst_, rec, &held, curr)) {
+            goto retry;
+        }
+        return SUCCESS;
+    }
+
+    // No children or one child
+    bst_mt_fgl_node_t *child = curr->left == NULL ? curr->right : curr->left;
+    if (curr == parent->left) {
+        parent->left = child;
+    } else {
+        parent->right = child;
+    }
+
+    fgl_release_all(&held);
+    bst_mt_lrwl_node_delete(bst_, rec, curr);
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_mt_fgl_delete(bst_mt_fgl_t **bst, const int64_t value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_mt_fgl_ebr_record_t *rec = ebr_enter(*bst);
+
+    if (rec == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    const BST_ERROR err = bst_mt_lrwl_delete(*bst, rec, value);
+    ebr_exit(rec);
+
+    return err;
 }
 
 void bst_mt_lrwl_node_free(bst_mt_fgl_node_t *root) {
@@ -487,8 +1063,224 @@ void bst_mt_lrwl_node_free(bst_mt_fgl_node_t *root) {
         bst_mt_lrwl_node_free(root->right);
     }
 
-    pthread_mutex_destroy(&root->mtx);
-    free(root);
+    bst_mt_lrwl_node_destroy(root);
+}
+
+// Frees every retired node and releases the epoch records. Records still owned
+// by a live thread are orphaned and freed by their owner.
+static void bst_mt_lrwl_free_ebr(bst_mt_fgl_t *bst) {
+    bst_mt_fgl_ebr_record_t *rec = atomic_load(&bst->ebr_records);
+
+    while (rec != NULL) {
+        bst_mt_fgl_ebr_record_t *next = rec->next;
+
+        for (int i = 0; i < BST_MT_FGL_EBR_LISTS; i++) {
+            ebr_limbo_free(rec->bst, &rec->limbo[i]);
+        }
+
+        if (rec == ebr_local) {
+            ebr_local = NULL;
+            pthread_setspecific(ebr_key, NULL);
+            ebr_record_destroy(rec);
+        } else if (atomic_exchange(&rec->state, EBR_ORPHANED) == EBR_FREE) {
+            ebr_record_destroy(rec);
+        }
+
+        rec = next;
+    }
+
+    atomic_store(&bst->ebr_records, NULL);
+}
+
+BST_ERROR bst_mt_fgl_memory_stats(bst_mt_fgl_t **bst,
+                                   bst_memory_stats_t *stats) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_mt_fgl_t *bst_ = *bst;
+
+    if (stats == NULL) {
+        return SUCCESS;
+    }
+
+    const size_t allocs = atomic_load(&bst_->allocs);
+    const size_t frees = atomic_load(&bst_->frees);
+    const size_t tree_locks = 2 * sizeof(pthread_mutex_t);
+
+    stats->live_nodes = allocs - frees;
+#ifdef BST_FGL_STRIPED
+    stats->node_bytes = stats->live_nodes * sizeof(bst_mt_fgl_node_t);
+    stats->lock_bytes =
+        (bst_->stripe_mask + 1) * sizeof(bst_mt_fgl_stripe_t) + tree_locks;
+#else
+    stats->node_bytes = stats->live_nodes *
+                        (sizeof(bst_mt_fgl_node_t) - sizeof(bst_mt_fgl_lock_t));
+    stats->lock_bytes =
+        stats->live_nodes * sizeof(bst_mt_fgl_lock_t) + tree_locks;
+#endif
+    stats->meta_bytes = sizeof(bst_mt_fgl_t) - tree_locks;
+    stats->pending_nodes = 0;
+
+    for (const bst_mt_fgl_ebr_record_t *rec = atomic_load(&bst_->ebr_records);
+         rec != NULL; rec = rec->next) {
+        stats->meta_bytes += sizeof(bst_mt_fgl_ebr_record_t);
+
+        for (int i = 0; i < BST_MT_FGL_EBR_LISTS; i++) {
+            stats->meta_bytes +=
+                rec->limbo[i].capacity * sizeof(bst_mt_fgl_node_t *);
+            stats->pending_nodes += rec->limbo[i].count;
+        }
+    }
+
+    stats->pending_bytes = stats->pending_nodes * sizeof(bst_mt_fgl_node_t);
+    stats->allocs = allocs;
+    stats->frees = frees;
+
+    return SUCCESS;
+}
+
+// Appends every value in order, returns 0 if the traversal stack can't grow
+static int bst_mt_lrwl_save_nodes(bst_mt_fgl_t *bst,
+                                  bst_snapshot_writer_t *writer) {
+    size_t capacity = 64, top = 0;
+    bst_mt_fgl_node_t **stack = malloc(capacity * sizeof(bst_mt_fgl_node_t *));
+
+    if (stack == NULL) {
+        return 0;
+    }
+
+    bst_mt_fgl_node_t *node = bst->root;
+
+    while (node != NULL || top > 0) {
+        while (node != NULL) {
+            if (top == capacity) {
+                bst_mt_fgl_node_t **s =
+                    realloc(stack, 2 * capacity * sizeof(bst_mt_fgl_node_t *));
+
+                if (s == NULL) {
+                    free(stack);
+                    return 0;
+                }
+
+                stack = s;
+                capacity *= 2;
+            }
+
+            stack[top++] = node;
+            node = node->left;
+        }
+
+        node = stack[--top];
+        bst_snapshot_writer_append(writer, node->value);
+        node = node->right;
+    }
+
+    free(stack);
+
+    return 1;
+}
+
+BST_ERROR bst_mt_fgl_save(bst_mt_fgl_t **bst, const char *path) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_mt_fgl_t *bst_ = *bst;
+    bst_snapshot_writer_t writer;
+
+    BST_ERROR err = bst_snapshot_writer_open(&writer, path);
+
+    if (!IS_SUCCESS(err)) {
+        return err;
+    }
+
+    pthread_mutex_lock(&bst_->mtx);
+
+    const int saved = bst_mt_lrwl_save_nodes(bst_, &writer);
+
+    pthread_mutex_unlock(&bst_->mtx);
+
+    err = bst_snapshot_writer_close(&writer, !saved);
+
+    return saved ? err : MALLOC_FAILURE;
+}
+
+// Builds a balanced subtree from the sorted keys [lo, hi), the middle key is
+// the subtree root. Stops allocating after the first failure, err is set and
+// the partial tree stays linked so it can be freed.
+static bst_mt_fgl_node_t *bst_mt_lrwl_build(bst_mt_fgl_t *bst,
+                                            const int64_t *keys,
+                                            const size_t lo, const size_t hi,
+                                            BST_ERROR *err) {
+    if (lo >= hi || !IS_SUCCESS(*err)) {
+        return NULL;
+    }
+
+    const size_t mid = lo + (hi - lo) / 2;
+    bst_mt_fgl_node_t *node = bst_mt_lrwl_node_new(keys[mid], err);
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    bst_mt_fgl_node_t *left = bst_mt_lrwl_build(bst, keys, lo, mid, err);
+    bst_mt_fgl_node_t *right = bst_mt_lrwl_build(bst, keys, mid + 1, hi, err);
+
+    node->left = left;
+    node->right = right;
+    atomic_fetch_add(&bst->allocs, 1);
+
+    return node;
+}
+
+bst_mt_fgl_t *bst_mt_fgl_load(const char *path, BST_ERROR *err) {
+    bst_snapshot_t snap;
+    BST_ERROR e = bst_snapshot_map(path, &snap);
+
+    if (!IS_SUCCESS(e)) {
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst_mt_fgl_t *bst = bst_mt_fgl_new(&e);
+
+    if (bst == NULL) {
+        bst_snapshot_unmap(&snap);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    const size_t count = snap.count;
+    bst_mt_fgl_node_t *root = bst_mt_lrwl_build(bst, snap.keys, 0, count, &e);
+    bst_snapshot_unmap(&snap);
+
+    bst->root = root;
+
+    if (!IS_SUCCESS(e)) {
+        bst_mt_fgl_free(&bst);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst->count = count;
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return bst;
 }
 
 BST_ERROR bst_mt_fgl_free(bst_mt_fgl_t **bst) {
@@ -504,13 +1296,81 @@ BST_ERROR bst_mt_fgl_free(bst_mt_fgl_t **bst) {
 
     bst_mt_lrwl_node_free(bst_->root);
     bst_->root = NULL;
+    bst_mt_lrwl_free_ebr(bst_);
 
     pthread_mutex_unlock(&bst_->mtx);
     pthread_mutex_destroy(&bst_->mtx);
     pthread_mutex_destroy(&bst_->cmtx);
+
+#ifdef BST_FGL_STRIPED
+    for (size_t i = 0; i <= bst_->stripe_mask; i++) {
+        bst_mt_fgl_lock_destroy(&bst_->stripes[i].lock);
+    }
+    free(bst_->stripes);
+#endif
+
     free(bst_);
 
     bst = NULL;
 
     return SUCCESS;
-}
\ No newline at end of file
+}
+
+// The bst_mt_fgl_engine wrappers, see bst_engine.h
+static void *bst_mt_fgl_engine_new(const bst_engine_config_t *config,
+                                   BST_ERROR *err) {
+    (void)config;
+    return bst_mt_fgl_new(err);
+}
+
+static BST_ERROR bst_mt_fgl_engine_free(void **bst) {
+    return bst_mt_fgl_free((bst_mt_fgl_t **)bst);
+}
+
+static BST_ERROR bst_mt_fgl_engine_add(void **bst, const int64_t value) {
+    return bst_mt_fgl_add((bst_mt_fgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_fgl_engine_search(void **bst, const int64_t value) {
+    return bst_mt_fgl_search((bst_mt_fgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_fgl_engine_min(void **bst, int64_t *value) {
+    return bst_mt_fgl_min((bst_mt_fgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_fgl_engine_max(void **bst, int64_t *value) {
+    return bst_mt_fgl_max((bst_mt_fgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_fgl_engine_delete(void **bst, const int64_t value) {
+    return bst_mt_fgl_delete((bst_mt_fgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_fgl_engine_count(void **bst, size_t *value) {
+    return bst_mt_fgl_node_count((bst_mt_fgl_t **)bst, value);
+}
+
+static BST_ERROR bst_mt_fgl_engine_stats(void **bst,
+                                         bst_engine_stats_t *stats) {
+    *stats = (bst_engine_stats_t){0};
+    return bst_mt_fgl_memory_stats((bst_mt_fgl_t **)bst, &stats->memory);
+}
+
+const bst_engine_ops bst_mt_fgl_engine = {
+    .abi_version = BST_ENGINE_ABI_VERSION,
+    .name = "FGL",
+    .threaded = 1,
+    .node_size = sizeof(bst_mt_fgl_node_t),
+    .node_lock = BST_MT_FGL_LOCK_PLACEMENT BST_MT_FGL_LOCK_NAME,
+    .new = bst_mt_fgl_engine_new,
+    .free = bst_mt_fgl_engine_free,
+    .add = bst_mt_fgl_engine_add,
+    .search = bst_mt_fgl_engine_search,
+    .min = bst_mt_fgl_engine_min,
+    .max = bst_mt_fgl_engine_max,
+    .delete = bst_mt_fgl_engine_delete,
+    .count = bst_mt_fgl_engine_count,
+    .stats = bst_mt_fgl_engine_stats,
+    .save_background = NULL,
+};
@@ -30,9 +30,14 @@ IN THE SOFTWARE.
 #ifndef BST_MT_LRWL_H_
 #define BST_MT_LRWL_H_
 #include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "../../include/bst_common.h"
+#include "../../include/bst_engine.h"
+#include "bst_mt_fgl_lock.h"
 
 /**
  * Holds a tree node with pointer to both children nodes
@@ -41,9 +46,57 @@ typedef struct bst_mt_fgl_node {
     int64_t value;
     struct bst_mt_fgl_node *left;
     struct bst_mt_fgl_node *right;
-    pthread_mutex_t mtx;
+#ifndef BST_FGL_STRIPED
+    bst_mt_fgl_lock_t lock;
+#endif
 } bst_mt_fgl_node_t;
 
+#ifdef BST_FGL_STRIPED
+/**
+ * One entry of the lock striping table, padded to its own cache line so
+ * neighbouring stripes do not false share.
+ */
+typedef struct bst_mt_fgl_stripe {
+    alignas(64) bst_mt_fgl_lock_t lock;
+} bst_mt_fgl_stripe_t;
+#endif
+
+/**
+ * Number of limbo lists per thread, nodes retired in epoch e are freed once
+ * the global epoch reaches e + 2.
+ */
+#define BST_MT_FGL_EBR_LISTS 3
+
+/**
+ * A thread tries to advance the global epoch every BST_MT_FGL_EBR_THRESHOLD
+ * nodes it retires.
+ */
+#define BST_MT_FGL_EBR_THRESHOLD 64
+
+/**
+ * Nodes unlinked during one epoch, waiting to be freed.
+ */
+typedef struct bst_mt_fgl_limbo {
+    bst_mt_fgl_node_t **nodes;
+    size_t count;
+    size_t capacity;
+    uint64_t epoch;
+} bst_mt_fgl_limbo_t;
+
+/**
+ * Per thread epoch record. epoch is 0 while the owner is outside any
+ * operation, otherwise the global epoch it observed shifted left by one with
+ * the low bit set. Registered once per thread and BST and reused by every
+ * operation, released to other threads when the owner exits.
+ */
+typedef struct bst_mt_fgl_ebr_record {
+    _Atomic uint64_t epoch;
+    atomic_int state;
+    struct bst_mt_fgl *bst;
+    struct bst_mt_fgl_ebr_record *next;
+    bst_mt_fgl_limbo_t limbo[BST_MT_FGL_EBR_LISTS];
+} bst_mt_fgl_ebr_record_t;
+
 /**
  * The BST
  */
@@ -52,6 +105,14 @@ typedef struct bst_mt_fgl {
     pthread_mutex_t mtx;
     size_t count;
     pthread_mutex_t cmtx;
+    _Atomic uint64_t epoch;
+    _Atomic(bst_mt_fgl_ebr_record_t *) ebr_records;
+    atomic_size_t allocs;
+    atomic_size_t frees;
+#ifdef BST_FGL_STRIPED
+    bst_mt_fgl_stripe_t *stripes;
+    size_t stripe_mask;
+#endif
 } bst_mt_fgl_t;
 
 // Prototypes
@@ -71,6 +132,20 @@ typedef struct bst_mt_fgl {
  */
 bst_mt_fgl_t *bst_mt_fgl_new(BST_ERROR *err);
 
+#ifdef BST_FGL_STRIPED
+/**
+ * Same as bst_mt_fgl_new() with a lock striping table of the given number of
+ * stripes, rounded up to a power of two. Node locks are taken from the stripe
+ * selected by a hash of the node address, bst_mt_fgl_new() uses
+ * BST_FGL_STRIPES stripes.
+ *
+ * @param stripes number of stripes in the lock table
+ * @param err NULL (no effect) or allocated pointer to store any errors
+ * @return NULL or BST
+ */
+bst_mt_fgl_t *bst_mt_fgl_new_striped(size_t stripes, BST_ERROR *err);
+#endif
+
 /**
  * Adds a new value to the BST - Thread safe.
  *
@@ -174,6 +249,61 @@ BST_ERROR bst_mt_fgl_node_count(bst_mt_fgl_t **bst, size_t *value);
  */
 BST_ERROR bst_mt_fgl_delete(bst_mt_fgl_t **bst, int64_t value);
 
+/**
+ * Finds and places in stats the memory held by the BST - Thread safe,
+ * exact when no operation runs concurrently.
+ *
+ * @param bst   the BST to measure.
+ * @param stats pointer to store the memory stats, memory must be
+ * pre-allocated.
+ * @return
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * SUCCESS                  - stats are stored in stats, if stats is not NULL.
+ */
+BST_ERROR bst_mt_fgl_memory_stats(bst_mt_fgl_t **bst,
+                                   bst_memory_stats_t *stats);
+
+/**
+ * Writes a snapshot of the BST to path, see bst_snapshot.h for the format. The
+ * snapshot is written to a temporary file and renamed over path once synced.
+ * Holds the root lock so no operation can start, callers make sure no write
+ * operation is running.
+ *
+ * @param bst  the BST to save.
+ * @param path the snapshot file path.
+ * @return
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * MALLOC_FAILURE           - failed to allocate the traversal stack, path is
+ *  untouched.
+ *
+ * IO_FAILURE               - failed to write the snapshot, path is untouched.
+ *
+ * SUCCESS                  - snapshot written.
+ */
+BST_ERROR bst_mt_fgl_save(bst_mt_fgl_t **bst, const char *path);
+
+/**
+ * Creates a BST from a snapshot written by any bst_*_save(). The file is
+ * mapped and the tree is built balanced straight from the sorted keys, no
+ * comparisons are made.
+ *
+ * Check the bitmask of err for possible error combinations:
+ * SUCCESS          - pointer to BST is returned.
+ *
+ * MALLOC_FAILURE   - failed to allocate the BST or its nodes.
+ *
+ * IO_FAILURE       - failed to open or map path.
+ *
+ * INVALID_SNAPSHOT - path is not a valid snapshot.
+ *
+ * @param path the snapshot file path.
+ * @param err NULL (no effect) or allocated pointer to store any errors
+ * @return NULL or BST
+ */
+bst_mt_fgl_t *bst_mt_fgl_load(const char *path, BST_ERROR *err);
+
 /**
  * Frees a BST.
  *
@@ -184,4 +314,9 @@ BST_ERROR bst_mt_fgl_delete(bst_mt_fgl_t **bst, int64_t value);
  * SUCCESS                   - bst and all nodes freed.
  */
 BST_ERROR bst_mt_fgl_free(bst_mt_fgl_t **bst);
+
+/**
+ * The FGL BST as a bst_engine_ops, see bst_engine.h.
+ */
+extern const bst_engine_ops bst_mt_fgl_engine;
 #endif // BST_MT_LRWL_H_
@@ -0,0 +1,72 @@
+/*
+Universidade Aberta
+File: bst_mt_fgl_lock.h
+Author: Hugo Gonçalves, 2100562
+
+Node lock backends for the MT Fine-Grained Lock BST
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#ifndef BST_MT_FGL_LOCK_H_
+#define BST_MT_FGL_LOCK_H_
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * Lock embedded in every FGL node, selected at build time with
+ * -DBST_FGL_LOCK=mutex|spin|ticket|futex:
+ *
+ * mutex  - pthread_mutex_t, 40 bytes on x86_64 glibc.
+ *
+ * spin   - 1 byte test-and-test-and-set spinlock.
+ *
+ * ticket - 4 byte ticket lock, next ticket in the high half and the ticket
+ *  being served in the low half. FIFO fair.
+ *
+ * futex  - 4 byte word lock, spins on the fast path and sleeps on a futex
+ *  when contended. 0 unlocked, 1 locked, 2 locked with waiters.
+ *
+ * With -DBST_FGL_STRIPED=ON the nodes carry no lock, the same lock type is
+ * used for the entries of a per tree lock striping table instead.
+ */
+#if defined(BST_FGL_LOCK_SPIN)
+typedef atomic_uchar bst_mt_fgl_lock_t;
+#define BST_MT_FGL_LOCK_NAME "spin"
+#elif defined(BST_FGL_LOCK_TICKET)
+typedef _Atomic uint32_t bst_mt_fgl_lock_t;
+#define BST_MT_FGL_LOCK_NAME "ticket"
+#elif defined(BST_FGL_LOCK_FUTEX)
+typedef _Atomic uint32_t bst_mt_fgl_lock_t;
+#define BST_MT_FGL_LOCK_NAME "futex"
+#else
+typedef pthread_mutex_t bst_mt_fgl_lock_t;
+#define BST_MT_FGL_LOCK_NAME "mutex"
+#endif
+
+#ifdef BST_FGL_STRIPED
+#define BST_MT_FGL_LOCK_PLACEMENT "striped-"
+#else
+#define BST_MT_FGL_LOCK_PLACEMENT ""
+#endif
+#endif // BST_MT_FGL_LOCK_H_
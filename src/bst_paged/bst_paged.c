@@ -0,0 +1,1195 @@
+/*
+Universidade Aberta
+File: bst_paged.c
+Author: Hugo Gonçalves, 2100562
+
+Disk resident B+tree with a CLOCK buffer pool
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/bst_common.h"
+#include "../include/bst_snapshot.h"
+#include "include/bst_paged.h"
+
+// Deepest tree handled, far beyond what 64-bit keys can fill
+#define BST_PAGED_MAX_HEIGHT 16
+
+#define BST_PAGED_FRAME(pool, f)                                               \
+    ((pool)->memory + (size_t)(f) * BST_PAGED_PAGE_SIZE)
+
+static size_t bst_paged_bucket(const bst_paged_pool_t *pool,
+                               const uint64_t page) {
+    return ((page * 0x9E3779B97F4A7C15ull) >> 32) & pool->bucket_mask;
+}
+
+// Reads or writes a whole page, retrying short transfers
+static int bst_paged_io(const int fd, char *buf, const uint64_t page,
+                        const int write) {
+    size_t len = BST_PAGED_PAGE_SIZE;
+    off_t offset = (off_t)page * BST_PAGED_PAGE_SIZE;
+
+    while (len > 0) {
+        const ssize_t n =
+            write ? pwrite(fd, buf, len, offset) : pread(fd, buf, len, offset);
+
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+
+    return 1;
+}
+
+static int bst_paged_pool_init(bst_paged_pool_t *pool, const int fd,
+                               const size_t capacity) {
+    size_t buckets = 1;
+    while (buckets < 2 * capacity) {
+        buckets <<= 1;
+    }
+
+    pool->memory = aligned_alloc(BST_PAGED_PAGE_SIZE,
+                                 capacity * BST_PAGED_PAGE_SIZE);
+    pool->frames = calloc(capacity, sizeof(bst_paged_frame_t));
+    pool->buckets = malloc(buckets * sizeof(int32_t));
+
+    if (pool->memory == NULL || pool->frames == NULL ||
+        pool->buckets == NULL) {
+        free(pool->memory);
+        free(pool->frames);
+        free(pool->buckets);
+        return 0;
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+        pool->frames[i].page = BST_PAGED_NO_PAGE;
+        pool->frames[i].next = -1;
+    }
+
+    for (size_t i = 0; i < buckets; i++) {
+        pool->buckets[i] = -1;
+    }
+
+    pool->fd = fd;
+    pool->capacity = capacity;
+    pool->bucket_mask = buckets - 1;
+    pool->hand = 0;
+    pool->hits = 0;
+    pool->misses = 0;
+    pool->writebacks = 0;
+    pthread_mutex_init(&pool->mtx, NULL);
+
+    return 1;
+}
+
+static void bst_paged_pool_destroy(bst_paged_pool_t *pool) {
+    pthread_mutex_destroy(&pool->mtx);
+    close(pool->fd);
+    free(pool->memory);
+    free(pool->frames);
+    free(pool->buckets);
+}
+
+static void bst_paged_pool_unlink(bst_paged_pool_t *pool, const int32_t f) {
+    const size_t bucket = bst_paged_bucket(pool, pool->frames[f].page);
+    int32_t *link = &pool->buckets[bucket];
+
+    while (*link != f) {
+        link = &pool->frames[*link].next;
+    }
+
+    *link = pool->frames[f].next;
+}
+
+// Returns the frame holding page pinned, reading it on a miss. fresh pages
+// were never written and start zeroed instead. The victim is picked by CLOCK:
+// unpinned frames get a second chance while their reference bit is set.
+static void *bst_paged_pin(bst_paged_pool_t *pool, const uint64_t page,
+                           const int fresh, BST_ERROR *err) {
+    pthread_mutex_lock(&pool->mtx);
+
+    const size_t bucket = bst_paged_bucket(pool, page);
+
+    for (int32_t f = pool->buckets[bucket]; f >= 0; f = pool->frames[f].next) {
+        if (pool->frames[f].page == page) {
+            pool->frames[f].pins++;
+            pool->frames[f].referenced = 1;
+            pool->hits++;
+
+            pthread_mutex_unlock(&pool->mtx);
+            return BST_PAGED_FRAME(pool, f);
+        }
+    }
+
+    // Two sweeps clear every reference bit, a victim is only missing when
+    // every frame is pinned
+    int32_t victim = -1;
+
+    for (size_t i = 0; i < 2 * pool->capacity + 1 && victim < 0; i++) {
+        const size_t f = pool->hand;
+        bst_paged_frame_t *frame = &pool->frames[f];
+
+        pool->hand = (pool->hand + 1) % pool->capacity;
+
+        if (frame->pins > 0) {
+            continue;
+        }
+
+        if (frame->referenced) {
+            frame->referenced = 0;
+            continue;
+        }
+
+        victim = f;
+    }
+
+    if (victim < 0) {
+        pthread_mutex_unlock(&pool->mtx);
+        *err = MALLOC_FAILURE;
+        return NULL;
+    }
+
+    bst_paged_frame_t *frame = &pool->frames[victim];
+    char *data = BST_PAGED_FRAME(pool, victim);
+
+    if (frame->page != BST_PAGED_NO_PAGE) {
+        if (frame->dirty) {
+            if (!bst_paged_io(pool->fd, data, frame->page, 1)) {
+                pthread_mutex_unlock(&pool->mtx);
+                *err = IO_FAILURE;
+                return NULL;
+            }
+
+            frame->dirty = 0;
+            pool->writebacks++;
+        }
+
+        bst_paged_pool_unlink(pool, victim);
+        frame->page = BST_PAGED_NO_PAGE;
+    }
+
+    if (fresh) {
+        memset(data, 0, BST_PAGED_PAGE_SIZE);
+    } else if (!bst_paged_io(pool->fd, data, page, 0)) {
+        pthread_mutex_unlock(&pool->mtx);
+        *err = IO_FAILURE;
+        return NULL;
+    } else {
+        pool->misses++;
+    }
+
+    frame->page = page;
+    frame->pins = 1;
+    frame->referenced = 1;
+    frame->dirty = fresh != 0; // Not on disk yet
+    frame->next = pool->buckets[bucket];
+    pool->buckets[bucket] = victim;
+
+    pthread_mutex_unlock(&pool->mtx);
+
+    return data;
+}
+
+static void bst_paged_unpin(bst_paged_pool_t *pool, const void *data,
+                            const int dirty) {
+    const size_t f = ((const char *)data - pool->memory) / BST_PAGED_PAGE_SIZE;
+
+    pthread_mutex_lock(&pool->mtx);
+
+    pool->frames[f].pins--;
+    if (dirty) {
+        pool->frames[f].dirty = 1;
+    }
+
+    pthread_mutex_unlock(&pool->mtx);
+}
+
+static BST_ERROR bst_paged_unlock(bst_paged_t *bst, const BST_ERROR result) {
+    if (pthread_rwlock_unlock(&bst->rwl)) {
+        return PT_RWLOCK_UNLOCK_FAILURE | result;
+    }
+
+    return result;
+}
+
+// First position whose key is not below value
+static size_t bst_paged_lower_bound(const int64_t *keys, const size_t count,
+                                    const int64_t value) {
+    size_t lo = 0, hi = count;
+
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (compare(keys[mid], value) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+// Slot of the child covering value, the number of keys not above it
+static size_t bst_paged_child(const bst_paged_inner_t *inner,
+                              const int64_t value) {
+    size_t lo = 0, hi = inner->header.count;
+
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (compare(inner->keys[mid], value) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+// Descends to the leaf covering value and returns it pinned. With path set
+// the inner pages and child slots taken are recorded for splits.
+static bst_paged_leaf_t *bst_paged_find_leaf(bst_paged_t *bst,
+                                             const int64_t value,
+                                             uint64_t *path, size_t *slots,
+                                             uint64_t *leaf_page,
+                                             BST_ERROR *err) {
+    uint64_t page = bst->root;
+
+    for (uint32_t level = 0; level + 1 < bst->height; level++) {
+        const bst_paged_inner_t *inner =
+            bst_paged_pin(&bst->pool, page, 0, err);
+
+        if (inner == NULL) {
+            return NULL;
+        }
+
+        const size_t slot = bst_paged_child(inner, value);
+
+        if (path != NULL) {
+            path[level] = page;
+            slots[level] = slot;
+        }
+
+        const uint64_t child = inner->children[slot];
+        bst_paged_unpin(&bst->pool, inner, 0);
+        page = child;
+    }
+
+    if (leaf_page != NULL) {
+        *leaf_page = page;
+    }
+
+    return bst_paged_pin(&bst->pool, page, 0, err);
+}
+
+/**
+ * Pages a leaf split changes, the new pages numbered from bst->pages on.
+ * Every one is pinned before any of them is changed, so a failed pin leaves
+ * the tree as it was.
+ */
+typedef struct bst_paged_split {
+    bst_paged_leaf_t *right; // new right sibling of the leaf
+    bst_paged_leaf_t *next;  // old next sibling, NULL for the last leaf
+    // Parents from the bottom up to the first one with room, and the new
+    // right sibling of each full one
+    bst_paged_inner_t *parents[BST_PAGED_MAX_HEIGHT];
+    bst_paged_inner_t *siblings[BST_PAGED_MAX_HEIGHT];
+    size_t levels;
+    bst_paged_inner_t *root; // new root when every parent is full
+    uint64_t pages;          // new pages taken
+} bst_paged_split_t;
+
+static void bst_paged_split_unpin(bst_paged_t *bst, bst_paged_split_t *split,
+                                  const int dirty) {
+    if (split->right != NULL) {
+        bst_paged_unpin(&bst->pool, split->right, dirty);
+    }
+
+    if (split->next != NULL) {
+        bst_paged_unpin(&bst->pool, split->next, dirty);
+    }
+
+    for (size_t i = 0; i < split->levels; i++) {
+        bst_paged_unpin(&bst->pool, split->parents[i], dirty);
+
+        if (split->siblings[i] != NULL) {
+            bst_paged_unpin(&bst->pool, split->siblings[i], dirty);
+        }
+    }
+
+    if (split->root != NULL) {
+        bst_paged_unpin(&bst->pool, split->root, dirty);
+    }
+}
+
+// Pins every page splitting leaf changes, see bst_paged_split_t. On failure
+// nothing stays pinned and no page is taken.
+static BST_ERROR bst_paged_split_pin(bst_paged_t *bst,
+                                     const bst_paged_leaf_t *leaf,
+                                     const uint64_t *path,
+                                     bst_paged_split_t *split) {
+    BST_ERROR err = SUCCESS;
+
+    memset(split, 0, sizeof(bst_paged_split_t));
+
+    split->right =
+        bst_paged_pin(&bst->pool, bst->pages + split->pages++, 1, &err);
+
+    if (split->right == NULL) {
+        return err;
+    }
+
+    if (leaf->header.next != BST_PAGED_NO_PAGE) {
+        split->next = bst_paged_pin(&bst->pool, leaf->header.next, 0, &err);
+
+        if (split->next == NULL) {
+            bst_paged_split_unpin(bst, split, 0);
+            return err;
+        }
+    }
+
+    for (int level = (int)bst->height - 2; level >= 0; level--) {
+        const size_t i = split->levels;
+
+        split->parents[i] = bst_paged_pin(&bst->pool, path[level], 0, &err);
+
+        if (split->parents[i] == NULL) {
+            bst_paged_split_unpin(bst, split, 0);
+            return err;
+        }
+
+        split->levels++;
+
+        if (split->parents[i]->header.count < BST_PAGED_INNER_KEYS) {
+            return SUCCESS;
+        }
+
+        split->siblings[i] =
+            bst_paged_pin(&bst->pool, bst->pages + split->pages++, 1, &err);
+
+        if (split->siblings[i] == NULL) {
+            bst_paged_split_unpin(bst, split, 0);
+            return err;
+        }
+    }
+
+    // Every parent is full, the root splits too
+    split->root =
+        bst_paged_pin(&bst->pool, bst->pages + split->pages++, 1, &err);
+
+    if (split->root == NULL) {
+        bst_paged_split_unpin(bst, split, 0);
+        return err;
+    }
+
+    return SUCCESS;
+}
+
+// Inserts sep and the page right of it into the parents pinned by split,
+// splitting full inner pages and finally the root.
+static void bst_paged_insert_parent(bst_paged_t *bst, bst_paged_split_t *split,
+                                    int64_t sep, uint64_t right_page,
+                                    uint64_t new_page, const size_t *slots) {
+    for (size_t i = 0; i < split->levels; i++) {
+        bst_paged_inner_t *inner = split->parents[i];
+        const size_t slot = slots[bst->height - 2 - i];
+        const size_t count = inner->header.count;
+
+        if (count < BST_PAGED_INNER_KEYS) {
+            memmove(&inner->keys[slot + 1], &inner->keys[slot],
+                    (count - slot) * sizeof(int64_t));
+            memmove(&inner->children[slot + 2], &inner->children[slot + 1],
+                    (count - slot) * sizeof(uint64_t));
+            inner->keys[slot] = sep;
+            inner->children[slot + 1] = right_page;
+            inner->header.count++;
+            return;
+        }
+
+        bst_paged_inner_t *right = split->siblings[i];
+
+        // Merge the new separator, then move the upper half right and push
+        // the middle key up
+        int64_t keys[BST_PAGED_INNER_KEYS + 1];
+        uint64_t children[BST_PAGED_INNER_KEYS + 2];
+
+        memcpy(keys, inner->keys, slot * sizeof(int64_t));
+        keys[slot] = sep;
+        memcpy(&keys[slot + 1], &inner->keys[slot],
+               (count - slot) * sizeof(int64_t));
+
+        memcpy(children, inner->children, (slot + 1) * sizeof(uint64_t));
+        children[slot + 1] = right_page;
+        memcpy(&children[slot + 2], &inner->children[slot + 1],
+               (count - slot) * sizeof(uint64_t));
+
+        const size_t total = count + 1;
+        const size_t mid = total / 2;
+
+        memcpy(inner->keys, keys, mid * sizeof(int64_t));
+        memcpy(inner->children, children, (mid + 1) * sizeof(uint64_t));
+        inner->header.count = mid;
+
+        memcpy(right->keys, &keys[mid + 1],
+               (total - mid - 1) * sizeof(int64_t));
+        memcpy(right->children, &children[mid + 1],
+               (total - mid) * sizeof(uint64_t));
+        right->header.count = total - mid - 1;
+
+        sep = keys[mid];
+        right_page = new_page++;
+    }
+
+    // The root split, grow a level
+    bst_paged_inner_t *root = split->root;
+
+    root->header.count = 1;
+    root->keys[0] = sep;
+    root->children[0] = bst->root;
+    root->children[1] = right_page;
+
+    bst->root = new_page;
+    bst->height++;
+}
+
+// Splits a full leaf while inserting value at pos, the upper half moves to a
+// new right sibling. The leaf is unpinned either way.
+static BST_ERROR bst_paged_split_leaf(bst_paged_t *bst, bst_paged_leaf_t *leaf,
+                                      const uint64_t leaf_page,
+                                      const size_t pos, const int64_t value,
+                                      const uint64_t *path,
+                                      const size_t *slots) {
+    bst_paged_split_t split;
+    const BST_ERROR err = bst_paged_split_pin(bst, leaf, path, &split);
+
+    if (!IS_SUCCESS(err)) {
+        bst_paged_unpin(&bst->pool, leaf, 0);
+        return err;
+    }
+
+    const uint64_t right_page = bst->pages;
+    bst_paged_leaf_t *right = split.right;
+
+    bst->pages += split.pages;
+
+    int64_t keys[BST_PAGED_LEAF_KEYS + 1];
+    const size_t count = leaf->header.count;
+
+    memcpy(keys, leaf->keys, pos * sizeof(int64_t));
+    keys[pos] = value;
+    memcpy(&keys[pos + 1], &leaf->keys[pos], (count - pos) * sizeof(int64_t));
+
+    const size_t total = count + 1;
+    const size_t mid = total / 2;
+
+    memcpy(leaf->keys, keys, mid * sizeof(int64_t));
+    leaf->header.count = mid;
+
+    memcpy(right->keys, &keys[mid], (total - mid) * sizeof(int64_t));
+    right->header.leaf = 1;
+    right->header.count = total - mid;
+
+    // Link right between leaf and its old next sibling
+    right->header.prev = leaf_page;
+    right->header.next = leaf->header.next;
+    leaf->header.next = right_page;
+
+    if (split.next != NULL) {
+        split.next->header.prev = right_page;
+    }
+
+    bst_paged_insert_parent(bst, &split, right->keys[0], right_page,
+                            right_page + 1, slots);
+
+    bst_paged_unpin(&bst->pool, leaf, 1);
+    bst_paged_split_unpin(bst, &split, 1);
+
+    return SUCCESS;
+}
+
+bst_paged_t *bst_paged_new(const char *path, size_t frames, BST_ERROR *err) {
+    if (frames < BST_PAGED_MIN_FRAMES) {
+        frames = BST_PAGED_MIN_FRAMES;
+    }
+
+    bst_paged_t *bst = malloc(sizeof(bst_paged_t));
+
+    if (bst == NULL) {
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+        return NULL;
+    }
+
+    if (pthread_rwlock_init(&bst->rwl, NULL)) {
+        free(bst);
+
+        if (err != NULL) {
+            *err = PT_RWLOCK_INIT_FAILURE;
+        }
+        return NULL;
+    }
+
+    int fd = -1;
+
+    if (path != NULL) {
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    } else {
+        const char *dir = getenv("TMPDIR");
+        char tmp[4096];
+
+        snprintf(tmp, sizeof(tmp), "%s/bst_paged.XXXXXX",
+                 dir != NULL ? dir : "/tmp");
+
+        fd = mkstemp(tmp);
+        if (fd >= 0) {
+            unlink(tmp); // Gone with the last descriptor
+        }
+    }
+
+    if (fd < 0) {
+        pthread_rwlock_destroy(&bst->rwl);
+        free(bst);
+
+        if (err != NULL) {
+            *err = IO_FAILURE;
+        }
+        return NULL;
+    }
+
+    if (!bst_paged_pool_init(&bst->pool, fd, frames)) {
+        close(fd);
+        pthread_rwlock_destroy(&bst->rwl);
+        free(bst);
+
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+        return NULL;
+    }
+
+    // The tree starts as one empty leaf
+    BST_ERROR e = SUCCESS;
+    bst->pages = 1;
+    bst->root = bst->pages++;
+    bst->height = 1;
+    bst->count = 0;
+
+    bst_paged_leaf_t *root = bst_paged_pin(&bst->pool, bst->root, 1, &e);
+    root->header.leaf = 1;
+    bst_paged_unpin(&bst->pool, root, 1);
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return bst;
+}
+
+BST_ERROR bst_paged_add(bst_paged_t **bst, const int64_t value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_wrlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    uint64_t path[BST_PAGED_MAX_HEIGHT];
+    size_t slots[BST_PAGED_MAX_HEIGHT];
+    uint64_t leaf_page = BST_PAGED_NO_PAGE;
+    BST_ERROR err = SUCCESS;
+
+    bst_paged_leaf_t *leaf =
+        bst_paged_find_leaf(bst_, value, path, slots, &leaf_page, &err);
+
+    if (leaf == NULL) {
+        return bst_paged_unlock(bst_, err);
+    }
+
+    const size_t count = leaf->header.count;
+    const size_t pos = bst_paged_lower_bound(leaf->keys, count, value);
+
+    if (pos < count && leaf->keys[pos] == value) {
+        bst_paged_unpin(&bst_->pool, leaf, 0);
+        return bst_paged_unlock(bst_, VALUE_EXISTS);
+    }
+
+    if (count < BST_PAGED_LEAF_KEYS) {
+        memmove(&leaf->keys[pos + 1], &leaf->keys[pos],
+                (count - pos) * sizeof(int64_t));
+        leaf->keys[pos] = value;
+        leaf->header.count++;
+        bst_paged_unpin(&bst_->pool, leaf, 1);
+    } else {
+        err = bst_paged_split_leaf(bst_, leaf, leaf_page, pos, value, path,
+                                   slots);
+
+        if (!IS_SUCCESS(err)) {
+            return bst_paged_unlock(bst_, err);
+        }
+    }
+
+    bst_->count++;
+
+    return bst_paged_unlock(bst_, SUCCESS);
+}
+
+BST_ERROR bst_paged_search(bst_paged_t **bst, const int64_t value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    if (bst_->count == 0) {
+        return bst_paged_unlock(bst_, BST_EMPTY);
+    }
+
+    BST_ERROR err = SUCCESS;
+    const bst_paged_leaf_t *leaf =
+        bst_paged_find_leaf(bst_, value, NULL, NULL, NULL, &err);
+
+    if (leaf == NULL) {
+        return bst_paged_unlock(bst_, err);
+    }
+
+    const size_t count = leaf->header.count;
+    const size_t pos = bst_paged_lower_bound(leaf->keys, count, value);
+    const int found = pos < count && leaf->keys[pos] == value;
+
+    bst_paged_unpin(&bst_->pool, leaf, 0);
+
+    return bst_paged_unlock(bst_, found ? VALUE_EXISTS : VALUE_NONEXISTENT);
+}
+
+// Finds the first (last) value, walking the leaf chain past emptied leaves.
+// Called with the read lock held on a non empty tree.
+static BST_ERROR bst_paged_edge(bst_paged_t *bst, const int last,
+                                int64_t *value) {
+    BST_ERROR err = SUCCESS;
+    uint64_t page = bst->root;
+
+    for (uint32_t level = 0; level + 1 < bst->height; level++) {
+        const bst_paged_inner_t *inner =
+            bst_paged_pin(&bst->pool, page, 0, &err);
+
+        if (inner == NULL) {
+            return err;
+        }
+
+        const uint64_t child =
+            inner->children[last ? inner->header.count : 0];
+        bst_paged_unpin(&bst->pool, inner, 0);
+        page = child;
+    }
+
+    while (page != BST_PAGED_NO_PAGE) {
+        const bst_paged_leaf_t *leaf = bst_paged_pin(&bst->pool, page, 0, &err);
+
+        if (leaf == NULL) {
+            return err;
+        }
+
+        const size_t count = leaf->header.count;
+
+        if (count > 0) {
+            if (value != NULL) {
+                *value = leaf->keys[last ? count - 1 : 0];
+            }
+
+            bst_paged_unpin(&bst->pool, leaf, 0);
+            return SUCCESS;
+        }
+
+        page = last ? leaf->header.prev : leaf->header.next;
+        bst_paged_unpin(&bst->pool, leaf, 0);
+    }
+
+    return BST_EMPTY;
+}
+
+BST_ERROR bst_paged_min(bst_paged_t **bst, int64_t *value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    if (bst_->count == 0) {
+        return bst_paged_unlock(bst_, BST_EMPTY);
+    }
+
+    return bst_paged_unlock(bst_, bst_paged_edge(bst_, 0, value));
+}
+
+BST_ERROR bst_paged_max(bst_paged_t **bst, int64_t *value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    if (bst_->count == 0) {
+        return bst_paged_unlock(bst_, BST_EMPTY);
+    }
+
+    return bst_paged_unlock(bst_, bst_paged_edge(bst_, 1, value));
+}
+
+BST_ERROR bst_paged_node_count(bst_paged_t **bst, size_t *value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    if (value != NULL) {
+        *value = bst_->count;
+    }
+
+    return bst_paged_unlock(bst_, SUCCESS);
+}
+
+BST_ERROR bst_paged_delete(bst_paged_t **bst, const int64_t value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_wrlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    if (bst_->count == 0) {
+        return bst_paged_unlock(bst_, BST_EMPTY);
+    }
+
+    BST_ERROR err = SUCCESS;
+    bst_paged_leaf_t *leaf =
+        bst_paged_find_leaf(bst_, value, NULL, NULL, NULL, &err);
+
+    if (leaf == NULL) {
+        return bst_paged_unlock(bst_, err);
+    }
+
+    const size_t count = leaf->header.count;
+    const size_t pos = bst_paged_lower_bound(leaf->keys, count, value);
+
+    if (pos == count || leaf->keys[pos] != value) {
+        bst_paged_unpin(&bst_->pool, leaf, 0);
+        return bst_paged_unlock(bst_, VALUE_NONEXISTENT);
+    }
+
+    // Leaves are never merged, an emptied leaf stays in the chain
+    memmove(&leaf->keys[pos], &leaf->keys[pos + 1],
+            (count - pos - 1) * sizeof(int64_t));
+    leaf->header.count--;
+    bst_paged_unpin(&bst_->pool, leaf, 1);
+
+    bst_->count--;
+
+    return bst_paged_unlock(bst_, SUCCESS);
+}
+
+BST_ERROR bst_paged_memory_stats(bst_paged_t **bst,
+                                 bst_memory_stats_t *stats) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    if (stats != NULL) {
+        const bst_paged_pool_t *pool = &bst_->pool;
+        const size_t locks = sizeof(pthread_rwlock_t) + sizeof(pthread_mutex_t);
+
+        stats->live_nodes = bst_->count;
+        stats->node_bytes = pool->capacity * BST_PAGED_PAGE_SIZE;
+        stats->lock_bytes = locks;
+        stats->meta_bytes = sizeof(bst_paged_t) - locks +
+                            pool->capacity * sizeof(bst_paged_frame_t) +
+                            (pool->bucket_mask + 1) * sizeof(int32_t);
+        stats->pending_nodes = 0;
+        stats->pending_bytes = 0;
+        stats->allocs = bst_->pages - 1;
+        stats->frees = 0;
+    }
+
+    return bst_paged_unlock(bst_, SUCCESS);
+}
+
+BST_ERROR bst_paged_pool_stats(bst_paged_t **bst,
+                               bst_paged_pool_stats_t *stats) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    if (stats != NULL) {
+        // Readers pin pages under the read lock, the counters need the pool
+        pthread_mutex_lock(&bst_->pool.mtx);
+
+        stats->frames = bst_->pool.capacity;
+        stats->pages = bst_->pages - 1;
+        stats->hits = bst_->pool.hits;
+        stats->misses = bst_->pool.misses;
+        stats->writebacks = bst_->pool.writebacks;
+
+        pthread_mutex_unlock(&bst_->pool.mtx);
+    }
+
+    return bst_paged_unlock(bst_, SUCCESS);
+}
+
+BST_ERROR bst_paged_save(bst_paged_t **bst, const char *path) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+    bst_snapshot_writer_t writer;
+
+    BST_ERROR err = bst_snapshot_writer_open(&writer, path);
+
+    if (!IS_SUCCESS(err)) {
+        return err;
+    }
+
+    if (pthread_rwlock_rdlock(&bst_->rwl)) {
+        bst_snapshot_writer_close(&writer, 1);
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    // Leftmost leaf, then the whole chain in key order
+    uint64_t page = bst_->root;
+    err = SUCCESS;
+
+    for (uint32_t level = 0; level + 1 < bst_->height && IS_SUCCESS(err);
+         level++) {
+        const bst_paged_inner_t *inner =
+            bst_paged_pin(&bst_->pool, page, 0, &err);
+
+        if (inner != NULL) {
+            page = inner->children[0];
+            bst_paged_unpin(&bst_->pool, inner, 0);
+        }
+    }
+
+    while (page != BST_PAGED_NO_PAGE && IS_SUCCESS(err)) {
+        const bst_paged_leaf_t *leaf =
+            bst_paged_pin(&bst_->pool, page, 0, &err);
+
+        if (leaf != NULL) {
+            for (size_t i = 0; i < leaf->header.count; i++) {
+                bst_snapshot_writer_append(&writer, leaf->keys[i]);
+            }
+
+            page = leaf->header.next;
+            bst_paged_unpin(&bst_->pool, leaf, 0);
+        }
+    }
+
+    const BST_ERROR unlocked = bst_paged_unlock(bst_, SUCCESS);
+    const BST_ERROR closed =
+        bst_snapshot_writer_close(&writer, !IS_SUCCESS(err));
+
+    err = IS_SUCCESS(err) ? closed : err;
+
+    if (unlocked & PT_RWLOCK_UNLOCK_FAILURE) {
+        err |= PT_RWLOCK_UNLOCK_FAILURE;
+    }
+
+    return err;
+}
+
+// Fills leaves in key order and builds the inner levels bottom up, each level
+// spreading its pages evenly over the parents.
+static BST_ERROR bst_paged_build(bst_paged_t *bst, const int64_t *keys,
+                                 const size_t count) {
+    if (count == 0) {
+        return SUCCESS;
+    }
+
+    size_t nodes = (count + BST_PAGED_LEAF_KEYS - 1) / BST_PAGED_LEAF_KEYS;
+    uint64_t *pages = malloc(nodes * sizeof(uint64_t));
+    int64_t *firsts = malloc(nodes * sizeof(int64_t));
+
+    if (pages == NULL || firsts == NULL) {
+        free(pages);
+        free(firsts);
+        return MALLOC_FAILURE;
+    }
+
+    // The empty root leaf becomes the first leaf, the rest are consecutive
+    const uint64_t base = bst->pages;
+    BST_ERROR err = SUCCESS;
+
+    for (size_t i = 0; i < nodes; i++) {
+        pages[i] = i == 0 ? bst->root : base + i - 1;
+    }
+    bst->pages += nodes - 1;
+
+    for (size_t i = 0, at = 0; i < nodes && IS_SUCCESS(err); i++) {
+        const size_t n = count / nodes + (i < count % nodes);
+        bst_paged_leaf_t *leaf = bst_paged_pin(&bst->pool, pages[i], i, &err);
+
+        if (leaf == NULL) {
+            break;
+        }
+
+        leaf->header.leaf = 1;
+        leaf->header.count = n;
+        leaf->header.prev = i > 0 ? pages[i - 1] : BST_PAGED_NO_PAGE;
+        leaf->header.next = i + 1 < nodes ? pages[i + 1] : BST_PAGED_NO_PAGE;
+        memcpy(leaf->keys, &keys[at], n * sizeof(int64_t));
+
+        firsts[i] = keys[at];
+        at += n;
+
+        bst_paged_unpin(&bst->pool, leaf, 1);
+    }
+
+    uint32_t height = 1;
+
+    while (nodes > 1 && IS_SUCCESS(err)) {
+        const size_t parents =
+            (nodes + BST_PAGED_INNER_KEYS) / (BST_PAGED_INNER_KEYS + 1);
+
+        for (size_t p = 0, at = 0; p < parents && IS_SUCCESS(err); p++) {
+            const size_t n = nodes / parents + (p < nodes % parents);
+            const uint64_t page = bst->pages;
+            bst_paged_inner_t *inner = bst_paged_pin(&bst->pool, page, 1, &err);
+
+            if (inner == NULL) {
+                break;
+            }
+
+            bst->pages++;
+
+            inner->header.count = n - 1;
+            memcpy(inner->children, &pages[at], n * sizeof(uint64_t));
+            memcpy(inner->keys, &firsts[at + 1], (n - 1) * sizeof(int64_t));
+
+            // p <= at, so the level below is not overwritten before use
+            pages[p] = page;
+            firsts[p] = firsts[at];
+            at += n;
+
+            bst_paged_unpin(&bst->pool, inner, 1);
+        }
+
+        nodes = parents;
+        height++;
+    }
+
+    if (IS_SUCCESS(err)) {
+        bst->root = pages[0];
+        bst->height = height;
+        bst->count = count;
+    }
+
+    free(pages);
+    free(firsts);
+
+    return err;
+}
+
+bst_paged_t *bst_paged_load(const char *path, const size_t frames,
+                            BST_ERROR *err) {
+    bst_snapshot_t snap;
+    BST_ERROR e = bst_snapshot_map(path, &snap);
+
+    if (!IS_SUCCESS(e)) {
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst_paged_t *bst = bst_paged_new(NULL, frames, &e);
+
+    if (bst == NULL) {
+        bst_snapshot_unmap(&snap);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    e = bst_paged_build(bst, snap.keys, snap.count);
+    bst_snapshot_unmap(&snap);
+
+    if (!IS_SUCCESS(e)) {
+        bst_paged_free(&bst);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return bst;
+}
+
+BST_ERROR bst_paged_free(bst_paged_t **bst) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_paged_t *bst_ = *bst;
+
+    if (pthread_rwlock_wrlock(&bst_->rwl)) {
+        return PT_RWLOCK_LOCK_FAILURE;
+    }
+
+    *bst = NULL; // No other operations will start
+
+    bst_paged_pool_destroy(&bst_->pool);
+
+    pthread_rwlock_unlock(&bst_->rwl);
+
+    if (pthread_rwlock_destroy(&bst_->rwl)) {
+        return PT_RWLOCK_DESTROY_FAILURE;
+    }
+
+    free(bst_);
+
+    return SUCCESS;
+}
+
+// The bst_paged_engine wrappers, see bst_engine.h
+static void *bst_paged_engine_new(const bst_engine_config_t *config,
+                                  BST_ERROR *err) {
+    return bst_paged_new(NULL, config->frames, err);
+}
+
+static BST_ERROR bst_paged_engine_free(void **bst) {
+    return bst_paged_free((bst_paged_t **)bst);
+}
+
+static BST_ERROR bst_paged_engine_add(void **bst, const int64_t value) {
+    return bst_paged_add((bst_paged_t **)bst, value);
+}
+
+static BST_ERROR bst_paged_engine_search(void **bst, const int64_t value) {
+    return bst_paged_search((bst_paged_t **)bst, value);
+}
+
+static BST_ERROR bst_paged_engine_min(void **bst, int64_t *value) {
+    return bst_paged_min((bst_paged_t **)bst, value);
+}
+
+static BST_ERROR bst_paged_engine_max(void **bst, int64_t *value) {
+    return bst_paged_max((bst_paged_t **)bst, value);
+}
+
+static BST_ERROR bst_paged_engine_delete(void **bst, const int64_t value) {
+    return bst_paged_delete((bst_paged_t **)bst, value);
+}
+
+static BST_ERROR bst_paged_engine_count(void **bst, size_t *value) {
+    return bst_paged_node_count((bst_paged_t **)bst, value);
+}
+
+static BST_ERROR bst_paged_engine_stats(void **bst, bst_engine_stats_t *stats) {
+    bst_paged_pool_stats_t pool = {0};
+
+    BST_ERROR e = bst_paged_memory_stats((bst_paged_t **)bst, &stats->memory);
+    e |= bst_paged_pool_stats((bst_paged_t **)bst, &pool);
+    stats->pool_hits = pool.hits;
+    stats->pool_misses = pool.misses;
+    stats->pool_writebacks = pool.writebacks;
+
+    return e;
+}
+
+const bst_engine_ops bst_paged_engine = {
+    .abi_version = BST_ENGINE_ABI_VERSION,
+    .name = "PAGED",
+    .threaded = 1,
+    .node_size = BST_PAGED_PAGE_SIZE,
+    .node_lock = "none",
+    .new = bst_paged_engine_new,
+    .free = bst_paged_engine_free,
+    .add = bst_paged_engine_add,
+    .search = bst_paged_engine_search,
+    .min = bst_paged_engine_min,
+    .max = bst_paged_engine_max,
+    .delete = bst_paged_engine_delete,
+    .count = bst_paged_engine_count,
+    .stats = bst_paged_engine_stats,
+    .save_background = NULL,
+};
@@ -0,0 +1,389 @@
+/*
+Universidade Aberta
+File: bst_paged.h
+Author: Hugo Gonçalves, 2100562
+
+Disk resident B+tree with a CLOCK buffer pool
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_PAGED_H_
+#define BST_PAGED_H_
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/bst_common.h"
+#include "../../include/bst_engine.h"
+
+/**
+ * Size of every tree page on disk and of every buffer pool frame.
+ */
+#define BST_PAGED_PAGE_SIZE 4096
+
+/**
+ * Default buffer pool capacity in frames, 4 MB.
+ */
+#define BST_PAGED_DEFAULT_FRAMES 1024
+
+/**
+ * Smallest buffer pool, enough for a split (leaf, new leaf, sibling) and a
+ * few concurrent readers.
+ */
+#define BST_PAGED_MIN_FRAMES 16
+
+/**
+ * Page number meaning no page. Page 0 of the file is never used by the tree.
+ */
+#define BST_PAGED_NO_PAGE 0
+
+/**
+ * Header at the start of every tree page. prev and next link the leaves in
+ * key order, they are unused in inner pages.
+ */
+typedef struct bst_paged_page_header {
+    uint16_t leaf;
+    uint16_t count;
+    uint32_t reserved;
+    uint64_t prev;
+    uint64_t next;
+} bst_paged_page_header_t;
+
+#define BST_PAGED_LEAF_KEYS                                                    \
+    ((BST_PAGED_PAGE_SIZE - sizeof(bst_paged_page_header_t)) / sizeof(int64_t))
+
+#define BST_PAGED_INNER_KEYS                                                   \
+    ((BST_PAGED_PAGE_SIZE - sizeof(bst_paged_page_header_t) -                  \
+      sizeof(uint64_t)) /                                                      \
+     (sizeof(int64_t) + sizeof(uint64_t)))
+
+/**
+ * Leaf page, count keys in ascending order.
+ */
+typedef struct bst_paged_leaf {
+    bst_paged_page_header_t header;
+    int64_t keys[BST_PAGED_LEAF_KEYS];
+} bst_paged_leaf_t;
+
+/**
+ * Inner page, count keys and count + 1 children. Keys below keys[i] are under
+ * children[i], keys from keys[i] on under children[i + 1].
+ */
+typedef struct bst_paged_inner {
+    bst_paged_page_header_t header;
+    int64_t keys[BST_PAGED_INNER_KEYS];
+    uint64_t children[BST_PAGED_INNER_KEYS + 1];
+} bst_paged_inner_t;
+
+/**
+ * Buffer pool frame. A frame with pins > 0 is never evicted, referenced is
+ * the CLOCK second chance bit.
+ */
+typedef struct bst_paged_frame {
+    uint64_t page;
+    uint32_t pins;
+    uint8_t dirty;
+    uint8_t referenced;
+    int32_t next; // next frame in the same hash bucket, -1 ends the chain
+} bst_paged_frame_t;
+
+/**
+ * Fixed capacity page cache over the tree file. Pages are read with pread()
+ * on a miss and written back with pwrite() when a dirty frame is evicted.
+ * mtx guards the frames, the page table and the counters.
+ */
+typedef struct bst_paged_pool {
+    int fd;
+    size_t capacity;
+    char *memory; // capacity frames of BST_PAGED_PAGE_SIZE bytes
+    bst_paged_frame_t *frames;
+    int32_t *buckets;
+    size_t bucket_mask;
+    size_t hand;
+    pthread_mutex_t mtx;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;
+} bst_paged_pool_t;
+
+/**
+ * The BST. A B+tree whose pages live in a file and are accessed through the
+ * buffer pool. The global RwLock orders tree operations like the MT CGL BST,
+ * searches share it and only contend on the pool mutex.
+ *
+ * Deleting never merges pages, emptied leaves stay linked and are skipped by
+ * min and max.
+ */
+typedef struct bst_paged {
+    size_t count;
+    uint64_t root;
+    uint64_t pages; // next page number to allocate
+    uint32_t height;
+    pthread_rwlock_t rwl;
+    bst_paged_pool_t pool;
+} bst_paged_t;
+
+typedef struct bst_paged_pool_stats {
+    size_t frames;
+    uint64_t pages;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;
+} bst_paged_pool_stats_t;
+
+// Prototypes
+/**
+ * Allocates a new paged BST returning the pointer to it.
+ *
+ * Check the bitmask of err for possible error combinations:
+ * SUCCESS                - pointer to BST is returned.
+ *
+ * MALLOC_FAILURE         - failed to allocate the BST or its buffer pool.
+ *
+ * IO_FAILURE             - failed to create the tree file.
+ *
+ * PT_RWLOCK_INIT_FAILURE - Failed to init the RwLock, BST is freed.
+ *
+ * @param path   tree file, truncated. NULL for an unlinked temporary file in
+ *  $TMPDIR or /tmp.
+ * @param frames buffer pool capacity in pages, at least BST_PAGED_MIN_FRAMES.
+ * @param err NULL (no effect) or allocated pointer to store any errors
+ * @return bst or NULL on failure
+ */
+bst_paged_t *bst_paged_new(const char *path, size_t frames, BST_ERROR *err);
+
+/**
+ * Adds a new value to the BST - Thread safe.
+ *
+ * @param bst   the BST to add the value to.
+ * @param value the value to add.
+ * @return
+ * SUCCESS                  - Value added.
+ *
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * VALUE_EXISTS             - when the value already exists.
+ *
+ * MALLOC_FAILURE           - every buffer pool frame is pinned.
+ *
+ * IO_FAILURE               - a page read or write back failed.
+ *
+ * PT_RWLOCK_LOCK_FAILURE   - when failed to lock the global RwLock, no changes
+ *  to the BST.
+ *
+ * PT_RWLOCK_UNLOCK_FAILURE - when failed to unlock the global RwLock, paired
+ *  with the result.
+ */
+BST_ERROR bst_paged_add(bst_paged_t **bst, int64_t value);
+
+/**
+ * Searches the BST for the given value - Thread safe.
+ *
+ * @param bst   the BST to search the value.
+ * @param value the value to search.
+ * @return
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * BST_EMPTY                - when the BST is empty.
+ *
+ * VALUE_EXISTS             - value exists in the BST.
+ *
+ * VALUE_NONEXISTENT        - value does not exist in the BST.
+ *
+ * MALLOC_FAILURE           - every buffer pool frame is pinned.
+ *
+ * IO_FAILURE               - a page read or write back failed.
+ *
+ * PT_RWLOCK_LOCK_FAILURE   - when failed to lock the global RwLock.
+ *
+ * PT_RWLOCK_UNLOCK_FAILURE - when failed to unlock the global RwLock, paired
+ *  with the result.
+ */
+BST_ERROR bst_paged_search(bst_paged_t **bst, int64_t value);
+
+/**
+ * Finds and places in value the min value in the BST - Thread safe.
+ *
+ * @param bst   the BST to search the min value.
+ * @param value pointer to place the min value or NULL.
+ * @return
+ * SUCCESS   - min value found.
+ *
+ * BST_NULL  - when provided bst pointer is null.
+ *
+ * BST_EMPTY - when the BST is empty.
+ *
+ * Or MALLOC_FAILURE, IO_FAILURE and RwLock errors as bst_paged_search().
+ */
+BST_ERROR bst_paged_min(bst_paged_t **bst, int64_t *value);
+
+/**
+ * Finds and places in value the max value in the BST - Thread safe.
+ *
+ * @param bst   the BST to search the max value.
+ * @param value pointer to place the max value or NULL.
+ * @return
+ * SUCCESS   - max value found.
+ *
+ * BST_NULL  - when provided bst pointer is null.
+ *
+ * BST_EMPTY - when the BST is empty.
+ *
+ * Or MALLOC_FAILURE, IO_FAILURE and RwLock errors as bst_paged_search().
+ */
+BST_ERROR bst_paged_max(bst_paged_t **bst, int64_t *value);
+
+/**
+ * Counts the number of values in the BST - Thread safe.
+ *
+ * @param bst   the BST to count.
+ * @param value pointer to place the count.
+ * @return
+ * SUCCESS                  - count placed in value.
+ *
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * PT_RWLOCK_LOCK_FAILURE   - when failed to lock the global RwLock.
+ *
+ * PT_RWLOCK_UNLOCK_FAILURE - when failed to unlock the global RwLock.
+ */
+BST_ERROR bst_paged_node_count(bst_paged_t **bst, size_t *value);
+
+/**
+ * Deletes a value from the BST - Thread safe.
+ *
+ * @param bst   the BST to delete the value from.
+ * @param value the value to delete.
+ * @return
+ * SUCCESS           - Value deleted.
+ *
+ * BST_NULL          - when provided bst pointer is null.
+ *
+ * BST_EMPTY         - when the BST is empty.
+ *
+ * VALUE_NONEXISTENT - value does not exist in the BST.
+ *
+ * Or MALLOC_FAILURE, IO_FAILURE and RwLock errors as bst_paged_add().
+ */
+BST_ERROR bst_paged_delete(bst_paged_t **bst, int64_t value);
+
+/**
+ * Reports the memory footprint of the BST - Thread safe. node_bytes is the
+ * buffer pool, the tree itself is on disk. live_nodes counts values, allocs
+ * counts tree pages.
+ *
+ * @param bst   the BST.
+ * @param stats statistics to fill.
+ * @return
+ * SUCCESS                  - stats filled.
+ *
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * PT_RWLOCK_LOCK_FAILURE   - when failed to lock the global RwLock.
+ *
+ * PT_RWLOCK_UNLOCK_FAILURE - when failed to unlock the global RwLock.
+ */
+BST_ERROR bst_paged_memory_stats(bst_paged_t **bst, bst_memory_stats_t *stats);
+
+/**
+ * Reports buffer pool hits, misses (page reads) and write backs - Thread
+ * safe.
+ *
+ * @param bst   the BST.
+ * @param stats statistics to fill.
+ * @return
+ * SUCCESS                  - stats filled.
+ *
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * PT_RWLOCK_LOCK_FAILURE   - when failed to lock the global RwLock.
+ *
+ * PT_RWLOCK_UNLOCK_FAILURE - when failed to unlock the global RwLock.
+ */
+BST_ERROR bst_paged_pool_stats(bst_paged_t **bst,
+                               bst_paged_pool_stats_t *stats);
+
+/**
+ * Writes a snapshot of the BST to path, see bst_snapshot.h - Thread safe.
+ * Walks the leaf chain under the read lock, values come out sorted.
+ *
+ * @param bst  the BST to save.
+ * @param path the snapshot file path.
+ * @return
+ * SUCCESS        - snapshot written.
+ *
+ * BST_NULL       - when provided bst pointer is null.
+ *
+ * MALLOC_FAILURE - failed to allocate the writer or every frame is pinned.
+ *
+ * IO_FAILURE     - failed to read a page or write the snapshot, path is
+ *  untouched.
+ *
+ * Or RwLock errors as bst_paged_search().
+ */
+BST_ERROR bst_paged_save(bst_paged_t **bst, const char *path);
+
+/**
+ * Creates a BST from a snapshot written by any bst_*_save(). Leaves are
+ * filled in key order and the inner levels built on top of them, no
+ * comparisons are made.
+ *
+ * Check the bitmask of err for possible error combinations:
+ * SUCCESS          - pointer to BST is returned.
+ *
+ * MALLOC_FAILURE   - failed to allocate the BST or the page index.
+ *
+ * IO_FAILURE       - failed to map the snapshot or write a page.
+ *
+ * INVALID_SNAPSHOT - path is not a valid snapshot.
+ *
+ * @param path   the snapshot file path.
+ * @param frames buffer pool capacity in pages, as bst_paged_new(). The tree
+ *  file is a temporary one.
+ * @param err NULL (no effect) or allocated pointer to store any errors
+ * @return NULL or BST
+ */
+bst_paged_t *bst_paged_load(const char *path, size_t frames, BST_ERROR *err);
+
+/**
+ * Frees a BST and its buffer pool and closes its tree file.
+ *
+ * @param bst the bst to free.
+ * @return
+ * BST_NULL                  - when provided bst pointer is null.
+ *
+ * PT_RWLOCK_LOCK_FAILURE    - when failed to lock the global RwLock, no
+ *  changes to the BST.
+ *
+ * PT_RWLOCK_DESTROY_FAILURE - when failed to destroy the global RwLock.
+ *
+ * SUCCESS                   - bst freed.
+ */
+BST_ERROR bst_paged_free(bst_paged_t **bst);
+
+/**
+ * The PAGED BST as a bst_engine_ops, see bst_engine.h.
+ */
+extern const bst_engine_ops bst_paged_engine;
+#endif // BST_PAGED_H_
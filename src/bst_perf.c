@@ -0,0 +1,140 @@
+/*
+Universidade Aberta
+File: bst_perf.c
+Author: Hugo Gonçalves, 2100562
+
+Per thread performance counters
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "include/bst_perf.h"
+
+#define BST_PERF_L1D_READ_MISS                                                 \
+    (PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |            \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// Type and config of each counter, in enum bst_perf_counter order
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} bst_perf_events[BST_PERF_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, BST_PERF_L1D_READ_MISS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+static int bst_perf_event_open(const int counter, const int exclude_kernel) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = bst_perf_events[counter].type;
+    attr.config = bst_perf_events[counter].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // This thread on any CPU
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+BST_ERROR bst_perf_open(bst_perf_t *perf) {
+    int opened = 0;
+
+    for (int i = 0; i < BST_PERF_COUNTERS; i++) {
+        perf->fd[i] = bst_perf_event_open(i, 0);
+
+        // perf_event_paranoid 2 and above only allow user space counting
+        if (perf->fd[i] == -1 && (errno == EACCES || errno == EPERM)) {
+            perf->fd[i] = bst_perf_event_open(i, 1);
+        }
+
+        perf->value[i] = 0;
+        opened += perf->fd[i] != -1;
+    }
+
+    return opened > 0 ? SUCCESS : IO_FAILURE;
+}
+
+void bst_perf_start(bst_perf_t *perf) {
+    for (int i = 0; i < BST_PERF_COUNTERS; i++) {
+        if (perf->fd[i] != -1) {
+            ioctl(perf->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void bst_perf_stop(bst_perf_t *perf) {
+    for (int i = 0; i < BST_PERF_COUNTERS; i++) {
+        if (perf->fd[i] != -1) {
+            ioctl(perf->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    for (int i = 0; i < BST_PERF_COUNTERS; i++) {
+        // value, time enabled, time running
+        uint64_t read_values[3];
+
+        perf->value[i] = 0;
+
+        if (perf->fd[i] == -1 ||
+            read(perf->fd[i], read_values, sizeof(read_values)) !=
+                sizeof(read_values) ||
+            read_values[2] == 0) {
+            continue;
+        }
+
+        perf->value[i] = read_values[2] < read_values[1]
+                             ? (uint64_t)((double)read_values[0] *
+                                          read_values[1] / read_values[2])
+                             : read_values[0];
+    }
+}
+
+int bst_perf_available(const bst_perf_t *perf, const int counter) {
+    return perf->fd[counter] != -1;
+}
+
+void bst_perf_close(bst_perf_t *perf) {
+    for (int i = 0; i < BST_PERF_COUNTERS; i++) {
+        if (perf->fd[i] != -1) {
+            close(perf->fd[i]);
+            perf->fd[i] = -1;
+        }
+    }
+}
@@ -0,0 +1,530 @@
+/*
+Universidade Aberta
+File: bst_pool.c
+Author: Hugo Gonçalves, 2100562
+
+Contiguous node pool addressed by 32-bit indices
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/bst_arena.h"
+#include "include/bst_pool.h"
+
+// Smallest reservation accepted before giving up, 1M nodes
+#define BST_POOL_MIN_NODES (1u << 20)
+
+// Page table entries read from /proc/self/pagemap at once
+#define BST_POOL_PAGEMAP_BATCH 512
+
+#define PM_PRESENT (1ull << 63)
+#define PM_SWAPPED (1ull << 62)
+#define PM_FILE (1ull << 61)
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t bst_pool_hash(uint64_t h, const void *data, const size_t len) {
+    const uint64_t *w = data;
+
+    for (size_t i = 0; i < len / sizeof(uint64_t); i++) {
+        h = (h ^ w[i]) * FNV_PRIME;
+    }
+
+    return h;
+}
+
+static uint64_t bst_pool_header_checksum(const bst_pool_header_t *header) {
+    return bst_pool_hash(FNV_OFFSET, header,
+                         offsetof(bst_pool_header_t, checksum));
+}
+
+BST_ERROR bst_pool_init(bst_pool_t *pool, const size_t node_size) {
+    size_t nodes = UINT32_MAX;
+
+    while (nodes >= BST_POOL_MIN_NODES) {
+        void *base = bst_arena_reserve(nodes * node_size, PROT_NONE);
+
+        if (base != NULL) {
+            pool->base = base;
+            pool->node_size = node_size;
+            pool->reserved = nodes * node_size;
+            pool->committed = 0;
+            pool->next = 1; // Index 0 is BST_POOL_NIL
+            pool->free = BST_POOL_NIL;
+            pool->fd = -1;
+            pool->epoch = 0;
+            pool->journal = NULL;
+            return SUCCESS;
+        }
+
+        nodes /= 2;
+    }
+
+    return MALLOC_FAILURE;
+}
+
+static int bst_pool_grow(bst_pool_t *pool) {
+    size_t grow = BST_POOL_GROW_BYTES;
+
+    if (pool->committed + grow > pool->reserved) {
+        grow = pool->reserved - pool->committed;
+    }
+
+    if (grow < pool->node_size) {
+        return 0;
+    }
+
+    if (pool->fd >= 0) {
+        // The file grows with the pool, new pages read as zeros
+        const off_t size = BST_POOL_HEADER_BYTES + pool->committed + grow;
+
+        if (ftruncate(pool->fd, size)) {
+            return 0;
+        }
+
+        if (mmap(pool->base + pool->committed, grow, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_FIXED, pool->fd,
+                 BST_POOL_HEADER_BYTES + pool->committed) == MAP_FAILED) {
+            return 0;
+        }
+    } else if (mprotect(pool->base + pool->committed, grow,
+                        PROT_READ | PROT_WRITE)) {
+        return 0;
+    }
+
+    pool->committed += grow;
+
+    return 1;
+}
+
+uint32_t bst_pool_alloc(bst_pool_t *pool) {
+    if (pool->free != BST_POOL_NIL) {
+        const uint32_t ref = pool->free;
+
+        // Released nodes hold the next released index in their first bytes
+        memcpy(&pool->free, pool->base + (size_t)ref * pool->node_size,
+               sizeof(uint32_t));
+
+        return ref;
+    }
+
+    if (pool->next == UINT32_MAX) {
+        return BST_POOL_NIL;
+    }
+
+    if ((size_t)(pool->next + 1) * pool->node_size > pool->committed &&
+        !bst_pool_grow(pool)) {
+        return BST_POOL_NIL;
+    }
+
+    return pool->next++;
+}
+
+void bst_pool_release(bst_pool_t *pool, const uint32_t ref) {
+    memcpy(pool->base + (size_t)ref * pool->node_size, &pool->free,
+           sizeof(uint32_t));
+    pool->free = ref;
+}
+
+// Writes len bytes at offset, retrying short writes
+static int bst_pool_pwrite(const int fd, const void *buf, size_t len,
+                           off_t offset) {
+    const char *p = buf;
+
+    while (len > 0) {
+        const ssize_t n = pwrite(fd, p, len, offset);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+
+        p += n;
+        len -= n;
+        offset += n;
+    }
+
+    return 1;
+}
+
+// Reads len bytes at offset, returns 0 on a short file
+static int bst_pool_pread(const int fd, void *buf, size_t len, off_t offset) {
+    char *p = buf;
+
+    while (len > 0) {
+        const ssize_t n = pread(fd, p, len, offset);
+
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+
+        p += n;
+        len -= n;
+        offset += n;
+    }
+
+    return 1;
+}
+
+static int bst_pool_header_valid(const bst_pool_header_t *header) {
+    return memcmp(header->magic, BST_POOL_MAGIC, sizeof(BST_POOL_MAGIC)) ==
+               0 &&
+           header->version == BST_POOL_VERSION &&
+           header->checksum == bst_pool_header_checksum(header);
+}
+
+// Copies a complete journal newer than the file header into the file. A torn
+// journal means the crash came before the checkpoint was durable and the file
+// still holds the previous one, it is dropped. Returns 0 on I/O failure.
+static int bst_pool_recover(const int fd, const char *journal) {
+    const int jfd = open(journal, O_RDWR);
+
+    if (jfd < 0) {
+        return errno == ENOENT;
+    }
+
+    bst_pool_journal_header_t jh;
+    bst_pool_header_t header;
+    struct stat st;
+    char *entries = NULL;
+    int ok = 1;
+
+    if (fstat(jfd, &st) || (size_t)st.st_size < sizeof(jh) ||
+        !bst_pool_pread(jfd, &jh, sizeof(jh), 0) ||
+        memcmp(jh.magic, BST_POOL_JOURNAL_MAGIC,
+               sizeof(BST_POOL_JOURNAL_MAGIC)) != 0 ||
+        jh.bytes != st.st_size - sizeof(jh)) {
+        goto done;
+    }
+
+    if (bst_pool_pread(fd, &header, sizeof(header), 0) &&
+        bst_pool_header_valid(&header) && header.epoch >= jh.epoch) {
+        goto done; // Already applied
+    }
+
+    entries = malloc(jh.bytes);
+    if (entries == NULL ||
+        !bst_pool_pread(jfd, entries, jh.bytes, sizeof(jh))) {
+        ok = 0;
+        goto done;
+    }
+
+    if (bst_pool_hash(FNV_OFFSET, entries, jh.bytes) != jh.checksum) {
+        goto done;
+    }
+
+    for (size_t at = 0; at < jh.bytes && ok;) {
+        uint64_t entry[2];
+        memcpy(entry, entries + at, sizeof(entry));
+        at += sizeof(entry);
+
+        ok = bst_pool_pwrite(fd, entries + at, entry[1], entry[0]);
+        at += entry[1];
+    }
+
+    ok = ok && fdatasync(fd) == 0;
+
+done:
+    free(entries);
+
+    if (ok && ftruncate(jfd, 0)) {
+        ok = 0;
+    }
+
+    close(jfd);
+
+    return ok;
+}
+
+BST_ERROR bst_pool_open(bst_pool_t *pool, const size_t node_size,
+                        const char *path, uint32_t *root, uint64_t *count) {
+    const BST_ERROR err = bst_pool_init(pool, node_size);
+    if (!IS_SUCCESS(err)) {
+        return err;
+    }
+
+    const size_t len = strlen(path);
+    pool->journal = malloc(len + 9);
+    if (pool->journal == NULL) {
+        bst_pool_destroy(pool);
+        return MALLOC_FAILURE;
+    }
+
+    memcpy(pool->journal, path, len);
+    memcpy(pool->journal + len, ".journal", 9);
+
+    pool->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (pool->fd < 0 || !bst_pool_recover(pool->fd, pool->journal)) {
+        bst_pool_destroy(pool);
+        return IO_FAILURE;
+    }
+
+    struct stat st;
+    bst_pool_header_t header = {0};
+
+    if (fstat(pool->fd, &st)) {
+        bst_pool_destroy(pool);
+        return IO_FAILURE;
+    }
+
+    if (st.st_size == 0) {
+        // New pool, epoch 0 is the empty tree
+        memcpy(header.magic, BST_POOL_MAGIC, sizeof(BST_POOL_MAGIC));
+        header.version = BST_POOL_VERSION;
+        header.node_size = node_size;
+        header.root = BST_POOL_NIL;
+        header.next = 1;
+        header.free = BST_POOL_NIL;
+        header.checksum = bst_pool_header_checksum(&header);
+
+        if (ftruncate(pool->fd, BST_POOL_HEADER_BYTES) ||
+            !bst_pool_pwrite(pool->fd, &header, sizeof(header), 0) ||
+            fdatasync(pool->fd)) {
+            bst_pool_destroy(pool);
+            return IO_FAILURE;
+        }
+
+        st.st_size = BST_POOL_HEADER_BYTES;
+    } else if (st.st_size < BST_POOL_HEADER_BYTES ||
+               !bst_pool_pread(pool->fd, &header, sizeof(header), 0) ||
+               !bst_pool_header_valid(&header) ||
+               header.node_size != node_size) {
+        bst_pool_destroy(pool);
+        return INVALID_SNAPSHOT;
+    }
+
+    // The file only grows in BST_POOL_GROW_BYTES steps
+    const size_t committed = st.st_size - BST_POOL_HEADER_BYTES;
+
+    if (committed > pool->reserved ||
+        (header.next > 1 && (size_t)header.next * node_size > committed)) {
+        bst_pool_destroy(pool);
+        return INVALID_SNAPSHOT;
+    }
+
+    if (committed > 0 &&
+        mmap(pool->base, committed, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, pool->fd,
+             BST_POOL_HEADER_BYTES) == MAP_FAILED) {
+        bst_pool_destroy(pool);
+        return IO_FAILURE;
+    }
+
+    pool->committed = committed;
+    pool->next = header.next;
+    pool->free = header.free;
+    pool->epoch = header.epoch;
+
+    *root = header.root;
+    *count = header.count;
+
+    return SUCCESS;
+}
+
+// Fills pages with the indices of the node array pages written since the last
+// checkpoint. A written page of a private file mapping is an anonymous copy,
+// pagemap reports it present or swapped without the file page bit. Without
+// pagemap every committed page is returned.
+static size_t bst_pool_dirty_pages(const bst_pool_t *pool, const size_t page,
+                                   size_t *pages) {
+    const size_t count = pool->committed / page;
+    const int fd = open("/proc/self/pagemap", O_RDONLY);
+
+    if (fd < 0) {
+        for (size_t i = 0; i < count; i++) {
+            pages[i] = i;
+        }
+        return count;
+    }
+
+    const size_t first = (uintptr_t)pool->base / page;
+    uint64_t entries[BST_POOL_PAGEMAP_BATCH];
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i += BST_POOL_PAGEMAP_BATCH) {
+        size_t batch = count - i;
+        if (batch > BST_POOL_PAGEMAP_BATCH) {
+            batch = BST_POOL_PAGEMAP_BATCH;
+        }
+
+        if (!bst_pool_pread(fd, entries, batch * sizeof(uint64_t),
+                            (first + i) * sizeof(uint64_t))) {
+            // Unreadable, assume the rest is dirty
+            for (size_t j = i; j < count; j++) {
+                pages[n++] = j;
+            }
+            break;
+        }
+
+        for (size_t j = 0; j < batch; j++) {
+            const uint64_t e = entries[j];
+
+            if ((e & PM_SWAPPED) || ((e & PM_PRESENT) && !(e & PM_FILE))) {
+                pages[n++] = i + j;
+            }
+        }
+    }
+
+    close(fd);
+
+    return n;
+}
+
+// Appends one journal entry, updating the checksum
+static int bst_pool_journal_append(const int jfd, off_t *at, uint64_t *h,
+                                   const uint64_t offset, const void *data,
+                                   const uint64_t len) {
+    const uint64_t entry[2] = {offset, len};
+
+    *h = bst_pool_hash(*h, entry, sizeof(entry));
+    *h = bst_pool_hash(*h, data, len);
+
+    if (!bst_pool_pwrite(jfd, entry, sizeof(entry), *at) ||
+        !bst_pool_pwrite(jfd, data, len, *at + sizeof(entry))) {
+        return 0;
+    }
+
+    *at += sizeof(entry) + len;
+
+    return 1;
+}
+
+BST_ERROR bst_pool_checkpoint(bst_pool_t *pool, const uint32_t root,
+                              const uint64_t count) {
+    if (pool->fd < 0) {
+        return IO_FAILURE;
+    }
+
+    const size_t page = sysconf(_SC_PAGESIZE);
+    size_t *pages = malloc((pool->committed / page + 1) * sizeof(size_t));
+
+    if (pages == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    const size_t n = bst_pool_dirty_pages(pool, page, pages);
+
+    bst_pool_header_t header = {0};
+    memcpy(header.magic, BST_POOL_MAGIC, sizeof(BST_POOL_MAGIC));
+    header.version = BST_POOL_VERSION;
+    header.node_size = pool->node_size;
+    header.epoch = pool->epoch + 1;
+    header.count = count;
+    header.root = root;
+    header.next = pool->next;
+    header.free = pool->free;
+    header.checksum = bst_pool_header_checksum(&header);
+
+    // 1. Journal the dirty pages and the next header
+    const int jfd = open(pool->journal, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (jfd < 0) {
+        free(pages);
+        return IO_FAILURE;
+    }
+
+    bst_pool_journal_header_t jh = {0};
+    memcpy(jh.magic, BST_POOL_JOURNAL_MAGIC, sizeof(BST_POOL_JOURNAL_MAGIC));
+    jh.epoch = header.epoch;
+    jh.checksum = FNV_OFFSET;
+
+    off_t at = sizeof(jh);
+    int ok = 1;
+
+    for (size_t i = 0; i < n && ok; i++) {
+        ok = bst_pool_journal_append(
+            jfd, &at, &jh.checksum, BST_POOL_HEADER_BYTES + pages[i] * page,
+            pool->base + pages[i] * page, page);
+    }
+
+    ok = ok && bst_pool_journal_append(jfd, &at, &jh.checksum, 0, &header,
+                                       sizeof(header));
+
+    jh.bytes = at - sizeof(jh);
+
+    ok = ok && bst_pool_pwrite(jfd, &jh, sizeof(jh), 0) && fdatasync(jfd) == 0;
+
+    // 2. Copy them into the file, the journal covers a crash from here on
+    for (size_t i = 0; i < n && ok; i++) {
+        ok = bst_pool_pwrite(pool->fd, pool->base + pages[i] * page, page,
+                             BST_POOL_HEADER_BYTES + pages[i] * page);
+    }
+
+    ok = ok && bst_pool_pwrite(pool->fd, &header, sizeof(header), 0) &&
+         fdatasync(pool->fd) == 0;
+
+    // 3. Retire the journal, replaying it again would be harmless
+    if (ok && ftruncate(jfd, 0)) {
+        ok = 0;
+    }
+
+    close(jfd);
+
+    if (ok) {
+        // Drop the private copies, the pages map the file again and the next
+        // checkpoint only sees pages written after this one
+        for (size_t i = 0; i < n; i++) {
+            madvise(pool->base + pages[i] * page, page, MADV_DONTNEED);
+        }
+
+        pool->epoch = header.epoch;
+    }
+
+    free(pages);
+
+    return ok ? SUCCESS : IO_FAILURE;
+}
+
+void bst_pool_destroy(bst_pool_t *pool) {
+    if (pool->base != NULL) {
+        bst_arena_unreserve(pool->base, pool->reserved);
+    }
+
+    if (pool->fd >= 0) {
+        close(pool->fd);
+    }
+
+    free(pool->journal);
+
+    pool->base = NULL;
+    pool->reserved = 0;
+    pool->committed = 0;
+    pool->next = 1;
+    pool->free = BST_POOL_NIL;
+    pool->fd = -1;
+    pool->journal = NULL;
+}
@@ -0,0 +1,90 @@
+/*
+Universidade Aberta
+File: bst_rand.c
+Author: Hugo Gonçalves, 2100562
+
+Per thread xoshiro256** random number streams
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include "include/bst_rand.h"
+
+static inline uint64_t bst_rand_rotl(const uint64_t x, const int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+void bst_rand_seed(bst_rand_t *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        // splitmix64
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+uint64_t bst_rand_next(bst_rand_t *rng) {
+    uint64_t *s = rng->s;
+    const uint64_t result = bst_rand_rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = bst_rand_rotl(s[3], 45);
+
+    return result;
+}
+
+void bst_rand_jump(bst_rand_t *rng) {
+    static const uint64_t jump[] = {0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull,
+                                    0xa9582618e03fc9aaull, 0x39abdc4529b1661cull};
+    uint64_t s[4] = {0, 0, 0, 0};
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & (1ull << b)) {
+                s[0] ^= rng->s[0];
+                s[1] ^= rng->s[1];
+                s[2] ^= rng->s[2];
+                s[3] ^= rng->s[3];
+            }
+            bst_rand_next(rng);
+        }
+    }
+
+    rng->s[0] = s[0];
+    rng->s[1] = s[1];
+    rng->s[2] = s[2];
+    rng->s[3] = s[3];
+}
+
+uint64_t bst_rand_below(bst_rand_t *rng, const uint64_t n) {
+    return (uint64_t)(((unsigned __int128)bst_rand_next(rng) * n) >> 64);
+}
+
+double bst_rand_double(bst_rand_t *rng) {
+    return (bst_rand_next(rng) >> 11) * 0x1.0p-53;
+}
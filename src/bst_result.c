@@ -0,0 +1,388 @@
+/*
+Universidade Aberta
+File: bst_result.c
+Author: Hugo Gonçalves, 2100562
+
+Test results as CSV and JSON lines
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/bst_result.h"
+
+static BST_ERROR bst_result_append(bst_result_t *result, const int kind,
+                                   const char *name, char *value) {
+    if (result->count == result->capacity) {
+        const size_t capacity = result->capacity ? result->capacity * 2 : 64;
+        bst_result_field_t *fields =
+            realloc(result->fields, sizeof(bst_result_field_t) * capacity);
+        if (fields == NULL) {
+            free(value);
+            return MALLOC_FAILURE;
+        }
+
+        result->fields = fields;
+        result->capacity = capacity;
+    }
+
+    char *copy = strdup(name);
+    if (copy == NULL) {
+        free(value);
+        return MALLOC_FAILURE;
+    }
+
+    result->fields[result->count++] =
+        (bst_result_field_t){.name = copy, .value = value, .kind = kind};
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_result_add(bst_result_t *result, const int kind,
+                         const char *name, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    const int size = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    char *value = malloc(size + 1);
+    if (value == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    va_start(args, format);
+    vsnprintf(value, size + 1, format, args);
+    va_end(args);
+
+    return bst_result_append(result, kind, name, value);
+}
+
+BST_ERROR bst_result_extend(bst_result_t *result, const bst_result_t *other) {
+    for (size_t i = 0; i < other->count; i++) {
+        const bst_result_field_t *f = &other->fields[i];
+
+        char *value = strdup(f->value);
+        if (value == NULL ||
+            bst_result_append(result, f->kind, f->name, value) != SUCCESS) {
+            return MALLOC_FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+const char *bst_result_get(const bst_result_t *result, const char *name) {
+    for (size_t i = 0; i < result->count; i++) {
+        if (strcmp(result->fields[i].name, name) == 0) {
+            return result->fields[i].value;
+        }
+    }
+
+    return NULL;
+}
+
+void bst_result_write_csv(const bst_result_t *result, FILE *out) {
+    for (size_t i = 0; i < result->count; i++) {
+        fprintf(out, i == 0 ? "%s" : ",%s", result->fields[i].value);
+    }
+
+    fputc('\n', out);
+}
+
+static void bst_result_write_string(const char *s, FILE *out) {
+    fputc('"', out);
+
+    for (; *s != '\0'; s++) {
+        const unsigned char c = *s;
+
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+
+    fputc('"', out);
+}
+
+// Writes a number as printed, or null when it is empty or not a finite number
+static void bst_result_write_number(const char *begin, const char *end,
+                                    FILE *out) {
+    char *parsed;
+    const double v = strtod(begin, &parsed);
+
+    if (begin == end || parsed != end || !isfinite(v)) {
+        fputs("null", out);
+        return;
+    }
+
+    fwrite(begin, 1, end - begin, out);
+}
+
+void bst_result_write_json(const bst_result_t *result, FILE *out) {
+    fputc('{', out);
+
+    for (size_t i = 0; i < result->count; i++) {
+        const bst_result_field_t *f = &result->fields[i];
+
+        if (i > 0) {
+            fputc(',', out);
+        }
+
+        bst_result_write_string(f->name, out);
+        fputc(':', out);
+
+        switch (f->kind) {
+        case BST_RESULT_TEXT:
+            bst_result_write_string(f->value, out);
+            break;
+        case BST_RESULT_LIST:
+            fputc('[', out);
+            for (const char *p = f->value; *p != '\0';) {
+                const char *end = strchr(p, ';');
+                if (end == NULL) {
+                    end = p + strlen(p);
+                }
+
+                if (p != f->value) {
+                    fputc(',', out);
+                }
+
+                bst_result_write_number(p, end, out);
+                p = *end == ';' ? end + 1 : end;
+            }
+            fputc(']', out);
+            break;
+        default:
+            bst_result_write_number(f->value, f->value + strlen(f->value),
+                                    out);
+            break;
+        }
+    }
+
+    fputs("}\n", out);
+}
+
+static const char *bst_result_skip(const char *p) {
+    while (isspace((unsigned char)*p)) {
+        p++;
+    }
+
+    return p;
+}
+
+// Reads a JSON string at p into an allocated string, returns the end of it or
+// NULL when it is malformed. Escapes of characters above 0x7f become ?.
+static const char *bst_result_parse_string(const char *p, char **out) {
+    if (*p++ != '"') {
+        return NULL;
+    }
+
+    char *s = malloc(strlen(p) + 1);
+    if (s == NULL) {
+        return NULL;
+    }
+
+    size_t n = 0;
+
+    while (*p != '"') {
+        char c = *p++;
+
+        if (c == '\0') {
+            free(s);
+            return NULL;
+        }
+
+        if (c == '\\') {
+            c = *p++;
+
+            switch (c) {
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'u': {
+                unsigned code;
+                if (sscanf(p, "%4x", &code) != 1) {
+                    free(s);
+                    return NULL;
+                }
+
+                c = code < 0x80 ? (char)code : '?';
+                p += 4;
+                break;
+            }
+            case '"':
+            case '\\':
+            case '/':
+                break;
+            default:
+                free(s);
+                return NULL;
+            }
+        }
+
+        s[n++] = c;
+    }
+
+    s[n] = '\0';
+    *out = s;
+
+    return p + 1;
+}
+
+// Reads a number, true, false or null at p, returns the end of it
+static const char *bst_result_parse_scalar(const char *p, char **out) {
+    const char *end = p;
+
+    while (*end != '\0' && *end != ',' && *end != '}' && *end != ']' &&
+           !isspace((unsigned char)*end)) {
+        end++;
+    }
+
+    if (end == p) {
+        return NULL;
+    }
+
+    const int null = end - p == 4 && strncmp(p, "null", 4) == 0;
+
+    *out = strndup(p, null ? 0 : end - p);
+
+    return *out != NULL ? end : NULL;
+}
+
+BST_ERROR bst_result_parse_json(const char *line, bst_result_t *result) {
+    const char *p = bst_result_skip(line);
+
+    if (*p++ != '{') {
+        return INVALID_RESULT;
+    }
+
+    p = bst_result_skip(p);
+
+    while (*p != '}') {
+        char *name = NULL;
+        char *value = NULL;
+        int kind = BST_RESULT_NUMBER;
+
+        p = bst_result_parse_string(p, &name);
+        if (p == NULL) {
+            return INVALID_RESULT;
+        }
+
+        p = bst_result_skip(p);
+        if (*p++ != ':') {
+            free(name);
+            return INVALID_RESULT;
+        }
+
+        p = bst_result_skip(p);
+
+        if (*p == '"') {
+            kind = BST_RESULT_TEXT;
+            p = bst_result_parse_string(p, &value);
+        } else if (*p == '[') {
+            // Back to the ; separated CSV form
+            kind = BST_RESULT_LIST;
+            value = calloc(strlen(p) + 1, 1);
+            p = bst_result_skip(p + 1);
+
+            while (value != NULL && *p != ']') {
+                char *item;
+
+                p = bst_result_parse_scalar(p, &item);
+                if (p == NULL) {
+                    break;
+                }
+
+                if (value[0] != '\0') {
+                    strcat(value, ";");
+                }
+
+                strcat(value, item);
+                free(item);
+
+                p = bst_result_skip(p);
+                if (*p == ',') {
+                    p = bst_result_skip(p + 1);
+                } else if (*p != ']') {
+                    p = NULL;
+                    break;
+                }
+            }
+
+            p = p != NULL ? p + 1 : NULL;
+        } else {
+            p = bst_result_parse_scalar(p, &value);
+        }
+
+        if (p == NULL || value == NULL) {
+            free(name);
+            free(value);
+            return INVALID_RESULT;
+        }
+
+        const BST_ERROR e = bst_result_append(result, kind, name, value);
+        free(name);
+        if (e != SUCCESS) {
+            return e;
+        }
+
+        p = bst_result_skip(p);
+        if (*p == ',') {
+            p = bst_result_skip(p + 1);
+        } else if (*p != '}') {
+            return INVALID_RESULT;
+        }
+    }
+
+    return *bst_result_skip(p + 1) == '\0' ? SUCCESS : INVALID_RESULT;
+}
+
+void bst_result_free(bst_result_t *result) {
+    for (size_t i = 0; i < result->count; i++) {
+        free(result->fields[i].name);
+        free(result->fields[i].value);
+    }
+
+    free(result->fields);
+    *result = (bst_result_t){0};
+}
@@ -0,0 +1,836 @@
+/*
+Universidade Aberta
+File: bst_snapshot.c
+Author: Hugo Gonçalves, 2100562
+
+Binary BST snapshot format
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/bst_snapshot.h"
+
+// Keys buffered before each write()
+#define BST_SNAPSHOT_BUFFER_KEYS 65536
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static _Atomic bst_snapshot_format_t format = BST_SNAPSHOT_RAW;
+
+static inline uint64_t bst_snapshot_hash(const uint64_t h, const int64_t key) {
+    return (h ^ (uint64_t)key) * FNV_PRIME;
+}
+
+void bst_snapshot_set_format(const bst_snapshot_format_t format_) {
+    format = format_;
+}
+
+bst_snapshot_format_t bst_snapshot_format(void) { return format; }
+
+static inline uint64_t bst_snapshot_load64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+static inline void bst_snapshot_store64(uint8_t *p, const uint64_t v) {
+    const uint64_t le = htole64(v);
+    memcpy(p, &le, sizeof(le));
+}
+
+static inline size_t bst_snapshot_packed_bytes(const size_t keys,
+                                               const uint32_t width) {
+    return keys > 0 ? ((keys - 1) * width + 7) / 8 : 0;
+}
+
+// Packs the gaps of n ascending keys into out at the width of the largest
+// gap. out must have BST_SNAPSHOT_PACKED_PAD bytes past the packed size.
+static size_t bst_snapshot_pack(const int64_t *keys, const size_t n,
+                                uint8_t *out, uint32_t *width) {
+    uint64_t bits = 0;
+
+    for (size_t i = 1; i < n; i++) {
+        bits |= (uint64_t)keys[i] - (uint64_t)keys[i - 1] - 1;
+    }
+
+    const uint32_t w = bits ? 64 - __builtin_clzll(bits) : 0;
+    const size_t bytes = bst_snapshot_packed_bytes(n, w);
+
+    memset(out, 0, bytes + BST_SNAPSHOT_PACKED_PAD);
+
+    for (size_t i = 1; i < n && w > 0; i++) {
+        const uint64_t gap = (uint64_t)keys[i] - (uint64_t)keys[i - 1] - 1;
+        const size_t bit = (i - 1) * w;
+        const unsigned shift = bit & 7;
+        uint8_t *p = out + bit / 8;
+
+        bst_snapshot_store64(p, bst_snapshot_load64(p) | gap << shift);
+
+        // Wider than the 64-bit window at this shift
+        if (shift + w > 64) {
+            p[8] |= gap >> (64 - shift);
+        }
+    }
+
+    *width = w;
+    return bytes;
+}
+
+// Unpacks n width bit gaps. Every gap is read on its own, there is no
+// dependency between iterations.
+static void bst_snapshot_unpack(const uint8_t *data, const uint32_t width,
+                                const size_t n, uint64_t *gaps) {
+    if (width == 0) {
+        memset(gaps, 0, n * sizeof(uint64_t));
+        return;
+    }
+
+    const uint64_t mask = width == 64 ? ~0ull : (1ull << width) - 1;
+
+    if (width <= 57) {
+        for (size_t i = 0; i < n; i++) {
+            const size_t bit = i * width;
+            gaps[i] = bst_snapshot_load64(data + bit / 8) >> (bit & 7) & mask;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const size_t bit = i * width;
+        const unsigned shift = bit & 7;
+        uint64_t v = bst_snapshot_load64(data + bit / 8) >> shift;
+
+        if (shift > 0) {
+            v |= (uint64_t)data[bit / 8 + 8] << (64 - shift);
+        }
+
+        gaps[i] = v & mask;
+    }
+}
+
+static size_t bst_snapshot_block_count(const bst_snapshot_packed_t *packed,
+                                       const size_t b) {
+    const size_t left = packed->count - b * BST_SNAPSHOT_BLOCK_KEYS;
+    return left < BST_SNAPSHOT_BLOCK_KEYS ? left : BST_SNAPSHOT_BLOCK_KEYS;
+}
+
+// Decodes block b into keys, returns the number of keys
+static size_t bst_snapshot_decode(const bst_snapshot_packed_t *packed,
+                                  const size_t b, int64_t *keys) {
+    const bst_snapshot_block_t *block = &packed->index[b];
+    const size_t n = bst_snapshot_block_count(packed, b);
+    uint64_t gaps[BST_SNAPSHOT_BLOCK_KEYS];
+
+    bst_snapshot_unpack(packed->data + block->offset, block->width, n - 1,
+                        gaps);
+
+    uint64_t key = block->first;
+    keys[0] = block->first;
+
+    for (size_t i = 1; i < n; i++) {
+        key += gaps[i - 1] + 1;
+        keys[i] = (int64_t)key;
+    }
+
+    return n;
+}
+
+// Writes len bytes at offset, retrying short writes
+static int bst_snapshot_pwrite(const int fd, const void *buf, size_t len,
+                               off_t offset) {
+    const char *p = buf;
+
+    while (len > 0) {
+        const ssize_t n = pwrite(fd, p, len, offset);
+
+        if (n < 0) {
+            return 0;
+        }
+
+        p += n;
+        len -= n;
+        offset += n;
+    }
+
+    return 1;
+}
+
+// Encodes the buffered keys into blocks and writes them in one go
+static void bst_snapshot_flush_packed(bst_snapshot_writer_t *writer) {
+    size_t used = 0;
+
+    for (size_t i = 0; i < writer->buffered; i += BST_SNAPSHOT_BLOCK_KEYS) {
+        const size_t left = writer->buffered - i;
+        const size_t n =
+            left < BST_SNAPSHOT_BLOCK_KEYS ? left : BST_SNAPSHOT_BLOCK_KEYS;
+
+        if (writer->blocks == writer->index_capacity) {
+            const size_t capacity = 2 * writer->index_capacity;
+            bst_snapshot_block_t *index =
+                realloc(writer->index, capacity * sizeof(bst_snapshot_block_t));
+
+            if (index == NULL) {
+                writer->failed = 1;
+                return;
+            }
+
+            writer->index = index;
+            writer->index_capacity = capacity;
+        }
+
+        bst_snapshot_block_t *block = &writer->index[writer->blocks++];
+
+        block->first = writer->buffer[i];
+        block->offset = writer->offset + used;
+        block->reserved = 0;
+        used += bst_snapshot_pack(&writer->buffer[i], n, writer->packed + used,
+                                  &block->width);
+    }
+
+    if (!bst_snapshot_pwrite(writer->fd, writer->packed, used,
+                             writer->offset)) {
+        writer->failed = 1;
+    }
+
+    writer->offset += used;
+}
+
+static void bst_snapshot_flush(bst_snapshot_writer_t *writer) {
+    if (writer->buffered == 0 || writer->failed) {
+        writer->buffered = 0;
+        return;
+    }
+
+    if (writer->format == BST_SNAPSHOT_PACKED) {
+        bst_snapshot_flush_packed(writer);
+        writer->buffered = 0;
+        return;
+    }
+
+    const off_t offset = sizeof(bst_snapshot_header_t) +
+                         (writer->count - writer->buffered) * sizeof(int64_t);
+
+    if (!bst_snapshot_pwrite(writer->fd, writer->buffer,
+                             writer->buffered * sizeof(int64_t), offset)) {
+        writer->failed = 1;
+    }
+
+    writer->buffered = 0;
+}
+
+BST_ERROR bst_snapshot_writer_open(bst_snapshot_writer_t *writer,
+                                   const char *path) {
+    const size_t len = strlen(path);
+
+    writer->format = format;
+    writer->tmp_path = malloc(len + 5);
+    writer->buffer = malloc(BST_SNAPSHOT_BUFFER_KEYS * sizeof(int64_t));
+    writer->packed = NULL;
+    writer->index = NULL;
+
+    if (writer->format == BST_SNAPSHOT_PACKED) {
+        // Blocks never grow past the raw keys
+        writer->packed = malloc(BST_SNAPSHOT_BUFFER_KEYS * sizeof(int64_t) +
+                                BST_SNAPSHOT_PACKED_PAD);
+        writer->index = malloc(1024 * sizeof(bst_snapshot_block_t));
+    }
+
+    if (writer->tmp_path == NULL || writer->buffer == NULL ||
+        (writer->format == BST_SNAPSHOT_PACKED &&
+         (writer->packed == NULL || writer->index == NULL))) {
+        free(writer->tmp_path);
+        free(writer->buffer);
+        free(writer->packed);
+        free(writer->index);
+        return MALLOC_FAILURE;
+    }
+
+    memcpy(writer->tmp_path, path, len);
+    memcpy(writer->tmp_path + len, ".tmp", 5);
+
+    writer->fd = open(writer->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (writer->fd < 0) {
+        free(writer->tmp_path);
+        free(writer->buffer);
+        free(writer->packed);
+        free(writer->index);
+        return IO_FAILURE;
+    }
+
+    writer->path = path;
+    writer->buffered = 0;
+    writer->count = 0;
+    writer->checksum = FNV_OFFSET;
+    writer->failed = 0;
+    writer->blocks = 0;
+    writer->index_capacity = 1024;
+    writer->offset = sizeof(bst_snapshot_packed_header_t);
+
+    return SUCCESS;
+}
+
+void bst_snapshot_writer_append(bst_snapshot_writer_t *writer,
+                                const int64_t key) {
+    writer->buffer[writer->buffered++] = key;
+    writer->count++;
+    writer->checksum = bst_snapshot_hash(writer->checksum, key);
+
+    if (writer->buffered == BST_SNAPSHOT_BUFFER_KEYS) {
+        bst_snapshot_flush(writer);
+    }
+}
+
+// Writes the padding, the block index and the header of a compressed
+// snapshot
+static int bst_snapshot_close_packed(bst_snapshot_writer_t *writer) {
+    const uint8_t pad[BST_SNAPSHOT_PACKED_PAD] = {0};
+    const uint64_t index_offset =
+        (writer->offset + BST_SNAPSHOT_PACKED_PAD + 7) & ~(uint64_t)7;
+
+    bst_snapshot_packed_header_t header = {0};
+    memcpy(header.magic, BST_SNAPSHOT_PACKED_MAGIC,
+           sizeof(BST_SNAPSHOT_PACKED_MAGIC));
+    header.version = BST_SNAPSHOT_VERSION;
+    header.block_keys = BST_SNAPSHOT_BLOCK_KEYS;
+    header.count = writer->count;
+    header.blocks = writer->blocks;
+    header.index_offset = index_offset;
+    header.checksum = writer->checksum;
+
+    return bst_snapshot_pwrite(writer->fd, pad, sizeof(pad), writer->offset) &&
+           bst_snapshot_pwrite(writer->fd, writer->index,
+                               writer->blocks * sizeof(bst_snapshot_block_t),
+                               index_offset) &&
+           bst_snapshot_pwrite(writer->fd, &header, sizeof(header), 0);
+}
+
+BST_ERROR bst_snapshot_writer_close(bst_snapshot_writer_t *writer,
+                                    const int abort) {
+    bst_snapshot_flush(writer);
+
+    int ok = !abort && !writer->failed;
+
+    if (ok && writer->format == BST_SNAPSHOT_PACKED) {
+        ok = bst_snapshot_close_packed(writer);
+    } else if (ok) {
+        bst_snapshot_header_t header = {0};
+        memcpy(header.magic, BST_SNAPSHOT_MAGIC, sizeof(BST_SNAPSHOT_MAGIC));
+        header.version = BST_SNAPSHOT_VERSION;
+        header.key_size = sizeof(int64_t);
+        header.count = writer->count;
+        header.checksum = writer->checksum;
+
+        ok = bst_snapshot_pwrite(writer->fd, &header, sizeof(header), 0);
+    }
+
+    ok = ok && fsync(writer->fd) == 0;
+
+    if (close(writer->fd)) {
+        ok = 0;
+    }
+
+    if (ok && rename(writer->tmp_path, writer->path)) {
+        ok = 0;
+    }
+
+    if (!ok) {
+        unlink(writer->tmp_path);
+    }
+
+    free(writer->tmp_path);
+    free(writer->buffer);
+    free(writer->packed);
+    free(writer->index);
+    writer->tmp_path = NULL;
+    writer->buffer = NULL;
+    writer->packed = NULL;
+    writer->index = NULL;
+
+    return ok ? SUCCESS : IO_FAILURE;
+}
+
+// Maps a whole file read only for a front to back pass
+static BST_ERROR bst_snapshot_mmap(const char *path, void **map,
+                                   size_t *size) {
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return IO_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return IO_FAILURE;
+    }
+
+    // Not even a magic
+    if ((size_t)st.st_size < 8) {
+        close(fd);
+        return INVALID_SNAPSHOT;
+    }
+
+    *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (*map == MAP_FAILED) {
+        return IO_FAILURE;
+    }
+
+    madvise(*map, st.st_size, MADV_SEQUENTIAL);
+    *size = st.st_size;
+
+    return SUCCESS;
+}
+
+// Validates the header and block index of a mapped compressed snapshot, every
+// block must fit before the index
+static int bst_snapshot_packed_layout(void *map, const size_t size,
+                                      bst_snapshot_packed_t *packed) {
+    const bst_snapshot_packed_header_t *header = map;
+
+    if (size < sizeof(bst_snapshot_packed_header_t) ||
+        memcmp(header->magic, BST_SNAPSHOT_PACKED_MAGIC,
+               sizeof(BST_SNAPSHOT_PACKED_MAGIC)) != 0 ||
+        header->version != BST_SNAPSHOT_VERSION ||
+        header->block_keys != BST_SNAPSHOT_BLOCK_KEYS ||
+        header->blocks != (header->count + BST_SNAPSHOT_BLOCK_KEYS - 1) /
+                              BST_SNAPSHOT_BLOCK_KEYS ||
+        header->index_offset % 8 != 0 || header->index_offset > size ||
+        header->blocks > (size - header->index_offset) /
+                             sizeof(bst_snapshot_block_t)) {
+        return 0;
+    }
+
+    packed->map = map;
+    packed->size = size;
+    packed->data = map;
+    packed->index = (const bst_snapshot_block_t *)((const char *)map +
+                                                   header->index_offset);
+    packed->blocks = header->blocks;
+    packed->count = header->count;
+
+    for (size_t b = 0; b < packed->blocks; b++) {
+        const bst_snapshot_block_t *block = &packed->index[b];
+
+        if (block->width > 64 ||
+            block->offset < sizeof(bst_snapshot_packed_header_t) ||
+            block->offset > header->index_offset ||
+            header->index_offset - block->offset <
+                bst_snapshot_packed_bytes(bst_snapshot_block_count(packed, b),
+                                          block->width) +
+                    BST_SNAPSHOT_PACKED_PAD) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Decodes every block to check the checksum and the key order, the keys are
+// kept in out when set
+static int bst_snapshot_packed_verify(const bst_snapshot_packed_t *packed,
+                                      const uint64_t checksum, int64_t *out) {
+    int64_t block[BST_SNAPSHOT_BLOCK_KEYS];
+    uint64_t h = FNV_OFFSET;
+    int64_t last = 0;
+
+    for (size_t b = 0; b < packed->blocks; b++) {
+        int64_t *keys = out != NULL ? &out[b * BST_SNAPSHOT_BLOCK_KEYS] : block;
+        const size_t n = bst_snapshot_decode(packed, b, keys);
+
+        for (size_t i = 0; i < n; i++) {
+            h = bst_snapshot_hash(h, keys[i]);
+
+            // A gap wrapping past INT64_MAX shows up as a descending key
+            if ((b > 0 || i > 0) && keys[i] <= last) {
+                return 0;
+            }
+
+            last = keys[i];
+        }
+    }
+
+    return h == checksum;
+}
+
+static BST_ERROR bst_snapshot_map_packed(void *map, const size_t size,
+                                         bst_snapshot_t *snap) {
+    const bst_snapshot_packed_header_t *header = map;
+    bst_snapshot_packed_t packed;
+
+    if (!bst_snapshot_packed_layout(map, size, &packed)) {
+        munmap(map, size);
+        return INVALID_SNAPSHOT;
+    }
+
+    int64_t *keys = malloc((packed.count > 0 ? packed.count : 1) *
+                           sizeof(int64_t));
+
+    if (keys == NULL) {
+        munmap(map, size);
+        return MALLOC_FAILURE;
+    }
+
+    const int valid = bst_snapshot_packed_verify(&packed, header->checksum,
+                                                 keys);
+    munmap(map, size);
+
+    if (!valid) {
+        free(keys);
+        return INVALID_SNAPSHOT;
+    }
+
+    snap->map = NULL;
+    snap->size = 0;
+    snap->keys = keys;
+    snap->count = packed.count;
+    snap->decoded = keys;
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_snapshot_map(const char *path, bst_snapshot_t *snap) {
+    void *map = NULL;
+    size_t size = 0;
+
+    BST_ERROR err = bst_snapshot_mmap(path, &map, &size);
+
+    if (!IS_SUCCESS(err)) {
+        return err;
+    }
+
+    if (memcmp(map, BST_SNAPSHOT_PACKED_MAGIC,
+               sizeof(BST_SNAPSHOT_PACKED_MAGIC)) == 0) {
+        return bst_snapshot_map_packed(map, size, snap);
+    }
+
+    if (size < sizeof(bst_snapshot_header_t)) {
+        munmap(map, size);
+        return INVALID_SNAPSHOT;
+    }
+
+    const bst_snapshot_header_t *header = map;
+    const int64_t *keys = (const int64_t *)(header + 1);
+    const size_t available =
+        (size - sizeof(bst_snapshot_header_t)) / sizeof(int64_t);
+
+    int valid = memcmp(header->magic, BST_SNAPSHOT_MAGIC,
+                       sizeof(BST_SNAPSHOT_MAGIC)) == 0 &&
+                header->version == BST_SNAPSHOT_VERSION &&
+                header->key_size == sizeof(int64_t) &&
+                header->count <= available;
+
+    if (valid) {
+        uint64_t checksum = FNV_OFFSET;
+
+        for (size_t i = 0; i < header->count; i++) {
+            checksum = bst_snapshot_hash(checksum, keys[i]);
+
+            if (i > 0 && keys[i] <= keys[i - 1]) {
+                valid = 0;
+                break;
+            }
+        }
+
+        valid = valid && checksum == header->checksum;
+    }
+
+    if (!valid) {
+        munmap(map, size);
+        return INVALID_SNAPSHOT;
+    }
+
+    snap->map = map;
+    snap->size = size;
+    snap->keys = keys;
+    snap->count = header->count;
+    snap->decoded = NULL;
+
+    return SUCCESS;
+}
+
+void bst_snapshot_unmap(bst_snapshot_t *snap) {
+    if (snap->map != NULL) {
+        munmap(snap->map, snap->size);
+    }
+
+    free(snap->decoded);
+
+    snap->map = NULL;
+    snap->size = 0;
+    snap->keys = NULL;
+    snap->count = 0;
+    snap->decoded = NULL;
+}
+
+BST_ERROR bst_snapshot_packed_map(const char *path,
+                                  bst_snapshot_packed_t *packed) {
+    void *map = NULL;
+    size_t size = 0;
+
+    BST_ERROR err = bst_snapshot_mmap(path, &map, &size);
+
+    if (!IS_SUCCESS(err)) {
+        return err;
+    }
+
+    const bst_snapshot_packed_header_t *header = map;
+
+    if (!bst_snapshot_packed_layout(map, size, packed) ||
+        !bst_snapshot_packed_verify(packed, header->checksum, NULL)) {
+        munmap(map, size);
+        packed->map = NULL;
+        return INVALID_SNAPSHOT;
+    }
+
+    // Lookups touch a single block
+    madvise(map, size, MADV_RANDOM);
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_snapshot_packed_search(const bst_snapshot_packed_t *packed,
+                                     const int64_t value) {
+    if (packed->count == 0) {
+        return BST_EMPTY;
+    }
+
+    // The last block starting at or below value
+    size_t lo = 0, hi = packed->blocks;
+
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (packed->index[mid].first <= value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0) {
+        return VALUE_NONEXISTENT;
+    }
+
+    int64_t keys[BST_SNAPSHOT_BLOCK_KEYS];
+    const size_t n = bst_snapshot_decode(packed, lo - 1, keys);
+
+    lo = 0;
+    hi = n;
+
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (keys[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo < n && keys[lo] == value ? VALUE_EXISTS : VALUE_NONEXISTENT;
+}
+
+BST_ERROR bst_snapshot_packed_min(const bst_snapshot_packed_t *packed,
+                                  int64_t *value) {
+    if (packed->count == 0) {
+        return BST_EMPTY;
+    }
+
+    if (value != NULL) {
+        *value = packed->index[0].first;
+    }
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_snapshot_packed_max(const bst_snapshot_packed_t *packed,
+                                  int64_t *value) {
+    if (packed->count == 0) {
+        return BST_EMPTY;
+    }
+
+    int64_t keys[BST_SNAPSHOT_BLOCK_KEYS];
+    const size_t n = bst_snapshot_decode(packed, packed->blocks - 1, keys);
+
+    if (value != NULL) {
+        *value = keys[n - 1];
+    }
+
+    return SUCCESS;
+}
+
+void bst_snapshot_packed_unmap(bst_snapshot_packed_t *packed) {
+    if (packed->map != NULL) {
+        munmap(packed->map, packed->size);
+    }
+
+    packed->map = NULL;
+    packed->size = 0;
+    packed->data = NULL;
+    packed->index = NULL;
+    packed->blocks = 0;
+    packed->count = 0;
+}
+
+/**
+ * Result sent from the snapshot child to the parent.
+ */
+typedef struct bst_snapshot_job_result {
+    BST_ERROR err;
+    double duration_ms;
+    size_t cow_kb;
+} bst_snapshot_job_result_t;
+
+static double bst_snapshot_ms(const struct timespec *from) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - from->tv_sec) * 1e3 +
+           (now.tv_nsec - from->tv_nsec) / 1e6;
+}
+
+// Pages mapped by this process only, 0 when smaps_rollup is missing
+static size_t bst_snapshot_private_dirty_kb(void) {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+
+    if (f == NULL) {
+        return 0;
+    }
+
+    char line[256];
+    size_t kb = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "Private_Dirty: %zu kB", &kb) == 1) {
+            break;
+        }
+    }
+
+    fclose(f);
+
+    return kb;
+}
+
+BST_ERROR bst_snapshot_fork(bst_snapshot_job_t *job, const char *path,
+                            int (*save)(void *, bst_snapshot_writer_t *),
+                            void *ctx) {
+    int fds[2];
+
+    if (pipe(fds)) {
+        return IO_FAILURE;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    const pid_t pid = fork();
+
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return MALLOC_FAILURE;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        bst_snapshot_job_result_t result = {0};
+        const size_t before = bst_snapshot_private_dirty_kb();
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        bst_snapshot_writer_t writer;
+        result.err = bst_snapshot_writer_open(&writer, path);
+
+        if (IS_SUCCESS(result.err)) {
+            const int saved = save(ctx, &writer);
+
+            result.err = bst_snapshot_writer_close(&writer, !saved);
+            if (!saved) {
+                result.err = MALLOC_FAILURE;
+            }
+        }
+
+        // Read after the write buffers are released
+        const size_t after = bst_snapshot_private_dirty_kb();
+
+        result.duration_ms = bst_snapshot_ms(&start);
+        result.cow_kb = after > before ? after - before : 0;
+
+        const int ok = write(fds[1], &result, sizeof(result)) ==
+                       (ssize_t)sizeof(result);
+
+        // No atexit handlers, they belong to the parent
+        _exit(ok && IS_SUCCESS(result.err) ? 0 : 1);
+    }
+
+    close(fds[1]);
+
+    job->pid = pid;
+    job->pipe = fds[0];
+    job->fork_ms = bst_snapshot_ms(&start);
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_snapshot_job_wait(bst_snapshot_job_t *job,
+                                bst_snapshot_job_stats_t *stats) {
+    bst_snapshot_job_result_t result = {.err = UNKNOWN};
+
+    if (read(job->pipe, &result, sizeof(result)) != (ssize_t)sizeof(result)) {
+        result.err = UNKNOWN;
+    }
+
+    close(job->pipe);
+
+    int status = 0;
+    while (waitpid(job->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    if (stats != NULL) {
+        stats->fork_ms = job->fork_ms;
+        stats->duration_ms = result.duration_ms;
+        stats->cow_kb = result.cow_kb;
+    }
+
+    job->pid = -1;
+    job->pipe = -1;
+
+    return result.err;
+}
@@ -31,11 +31,39 @@ IN THE SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../include/bst_arena.h"
 #include "../include/bst_common.h"
+#include "../include/bst_snapshot.h"
 #include "include/bst_st.h"
 
-bst_st_node_t *bst_st_node_new(const int64_t value, BST_ERROR *err) {
-    bst_st_node_t *node = malloc(sizeof(bst_st_node_t));
+static inline bst_st_node_t *bst_st_node(const bst_st_t *bst,
+                                         const bst_st_ref_t ref) {
+#ifdef BST_COMPACT_NODES
+    return ref == BST_ST_NIL ? NULL : (bst_st_node_t *)bst->pool.base + ref;
+#else
+    (void)bst;
+    return ref;
+#endif
+}
+
+static inline bst_st_ref_t bst_st_ref(const bst_st_t *bst,
+                                      bst_st_node_t *node) {
+#ifdef BST_COMPACT_NODES
+    return node == NULL ? BST_ST_NIL
+                        : (bst_st_ref_t)(node - (bst_st_node_t *)bst->pool.base);
+#else
+    (void)bst;
+    return node;
+#endif
+}
+
+bst_st_node_t *bst_st_node_new(bst_st_t *bst, const int64_t value,
+                               BST_ERROR *err) {
+#ifdef BST_COMPACT_NODES
+    bst_st_node_t *node = bst_st_node(bst, bst_pool_alloc(&bst->pool));
+#else
+    bst_st_node_t *node = bst_arena_alloc(sizeof(bst_st_node_t));
+#endif
 
     if (node == NULL) {
         if (err != NULL) {
@@ -46,8 +74,9 @@ bst_st_node_t *bst_st_node_new(const int64_t value, BST_ERROR *err) {
     }
 
     node->value = value;
-    node->left = NULL;
-    node->right = NULL;
+    node->left = BST_ST_NIL;
+    node->right = BST_ST_NIL;
+    bst->allocs++;
 
     if (err != NULL) {
         *err = SUCCESS;
@@ -56,6 +85,16 @@ bst_st_node_t *bst_st_node_new(const int64_t value, BST_ERROR *err) {
     return node;
 }
 
+static void bst_st_node_release(bst_st_t *bst, bst_st_node_t *node) {
+    bst->frees++;
+
+#ifdef BST_COMPACT_NODES
+    bst_pool_release(&bst->pool, bst_st_ref(bst, node));
+#else
+    bst_arena_free(node, sizeof(bst_st_node_t));
+#endif
+}
+
 bst_st_t *bst_st_new(BST_ERROR *err) {
     bst_st_t *bst = malloc(sizeof(bst_st_t));
 
@@ -66,8 +105,21 @@ bst_st_t *bst_st_new(BST_ERROR *err) {
         return NULL;
     }
 
+#ifdef BST_COMPACT_NODES
+    if (!IS_SUCCESS(bst_pool_init(&bst->pool, sizeof(bst_st_node_t)))) {
+        free(bst);
+
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+        return NULL;
+    }
+#endif
+
     bst->count = 0;
-    bst->root = NULL;
+    bst->root = BST_ST_NIL;
+    bst->allocs = 0;
+    bst->frees = 0;
 
     if (err != NULL) {
         *err = SUCCESS;
@@ -82,12 +134,12 @@ BST_ERROR bst_st_add(bst_st_t **bst, const int64_t value) {
 
     bst_st_t *bst_ = *bst;
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_ST_NIL) {
         BST_ERROR err;
-        bst_st_node_t *node = bst_st_node_new(value, &err);
+        bst_st_node_t *node = bst_st_node_new(bst_, value, &err);
 
         if (IS_SUCCESS(err)) {
-            bst_->root = node;
+            bst_->root = bst_st_ref(bst_, node);
         } else {
             return err;
         }
@@ -96,16 +148,16 @@ BST_ERROR bst_st_add(bst_st_t **bst, const int64_t value) {
         return SUCCESS;
     }
 
-    bst_st_node_t *root = bst_->root;
+    bst_st_node_t *root = bst_st_node(bst_, bst_->root);
 
     while (root != NULL) {
         if (compare(value, root->value) < 0) {
-            if (root->left == NULL) {
+            if (root->left == BST_ST_NIL) {
                 BST_ERROR err;
-                bst_st_node_t *node = bst_st_node_new(value, &err);
+                bst_st_node_t *node = bst_st_node_new(bst_, value, &err);
 
                 if (IS_SUCCESS(err)) {
-                    root->left = node;
+                    root->left = bst_st_ref(bst_, node);
                 } else {
                     return err;
                 }
@@ -114,14 +166,14 @@ BST_ERROR bst_st_add(bst_st_t **bst, const int64_t value) {
                 return SUCCESS;
             }
 
-            root = root->left;
+            root = bst_st_node(bst_, root->left);
         } else if (compare(value, root->value) > 0) {
-            if (root->right == NULL) {
+            if (root->right == BST_ST_NIL) {
                 BST_ERROR err;
-                bst_st_node_t *node = bst_st_node_new(value, &err);
+                bst_st_node_t *node = bst_st_node_new(bst_, value, &err);
 
                 if (IS_SUCCESS(err)) {
-                    root->right = node;
+                    root->right = bst_st_ref(bst_, node);
                 } else {
                     return err;
                 }
@@ -130,7 +182,7 @@ BST_ERROR bst_st_add(bst_st_t **bst, const int64_t value) {
                 return SUCCESS;
             }
 
-            root = root->right;
+            root = bst_st_node(bst_, root->right);
         } else {
             return VALUE_EXISTS;
         }
@@ -146,15 +198,15 @@ BST_ERROR bst_st_search(bst_st_t **bst, const int64_t value) {
 
     const bst_st_t *bst_ = *bst;
 
-    const bst_st_node_t *root = bst_->root;
+    const bst_st_node_t *root = bst_st_node(bst_, bst_->root);
 
     while (root != NULL) {
         if (root->value == value) {
             return VALUE_EXISTS;
         } else if (compare(value, root->value) < 0) {
-            root = root->left;
+            root = bst_st_node(bst_, root->left);
         } else if (compare(value, root->value) > 0) {
-            root = root->right;
+            root = bst_st_node(bst_, root->right);
         }
     }
 
@@ -168,14 +220,14 @@ BST_ERROR bst_st_min(bst_st_t **bst, int64_t *value) {
 
     const bst_st_t *bst_ = *bst;
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_ST_NIL) {
         return BST_EMPTY;
     }
 
-    const bst_st_node_t *root = bst_->root;
+    const bst_st_node_t *root = bst_st_node(bst_, bst_->root);
 
-    while (root->left != NULL) {
-        root = root->left;
+    while (root->left != BST_ST_NIL) {
+        root = bst_st_node(bst_, root->left);
     }
 
     if (value != NULL) {
@@ -192,14 +244,14 @@ BST_ERROR bst_st_max(bst_st_t **bst, int64_t *value) {
 
     const bst_st_t *bst_ = *bst;
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_ST_NIL) {
         return BST_EMPTY;
     }
 
-    const bst_st_node_t *root = bst_->root;
+    const bst_st_node_t *root = bst_st_node(bst_, bst_->root);
 
-    while (root->right != NULL) {
-        root = root->right;
+    while (root->right != BST_ST_NIL) {
+        root = bst_st_node(bst_, root->right);
     }
 
     if (value != NULL) {
@@ -216,20 +268,20 @@ BST_ERROR bst_st_delete(bst_st_t **bst, const int64_t value) {
 
     bst_st_t *bst_ = *bst;
 
-    if (bst_->root == NULL) {
+    if (bst_->root == BST_ST_NIL) {
         return BST_EMPTY;
     }
 
-    bst_st_node_t *current = bst_->root, *parent = NULL;
+    bst_st_node_t *current = bst_st_node(bst_, bst_->root), *parent = NULL;
 
     // Find the node
     while (current != NULL && current->value != value) {
         if (compare(value, current->value) < 0) {
             parent = current;
-            current = current->left;
+            current = bst_st_node(bst_, current->left);
         } else {
             parent = current;
-            current = current->right;
+            current = bst_st_node(bst_, current->right);
         }
     }
 
@@ -238,14 +290,14 @@ BST_ERROR bst_st_delete(bst_st_t **bst, const int64_t value) {
     }
 
     // Node with two children
-    if (current->left != NULL && current->right != NULL) {
-        bst_st_node_t *successor = current->right;
+    if (current->left != BST_ST_NIL && current->right != BST_ST_NIL) {
+        bst_st_node_t *successor = bst_st_node(bst_, current->right);
         bst_st_node_t *successor_parent = current;
 
         // Find in-order successor and its parent
-        while (successor->left != NULL) {
+        while (successor->left != BST_ST_NIL) {
             successor_parent = successor;
-            successor = successor->left;
+            successor = bst_st_node(bst_, successor->left);
         }
 
         // Replace current node's data with successor's data
@@ -257,21 +309,23 @@ BST_ERROR bst_st_delete(bst_st_t **bst, const int64_t value) {
     }
 
     // Node with one or zero children
-    bst_st_node_t *child =
-        current->left != NULL ? current->left : current->right;
+    const bst_st_ref_t child =
+        current->left != BST_ST_NIL ? current->left : current->right;
+    const bst_st_ref_t current_ref = bst_st_ref(bst_, current);
     if (parent == NULL) {
         bst_->root = child; // Delete the root node
-    } else if (parent->left == current) {
+    } else if (parent->left == current_ref) {
         parent->left = child;
     } else {
         parent->right = child;
     }
 
-    free(current);
+    bst_st_node_release(bst_, current);
     bst_->count--;
     return SUCCESS;
 }
 
+#ifndef BST_COMPACT_NODES
 static void bst_node_free(bst_st_node_t *root) {
     if (root == NULL) {
         return;
@@ -285,9 +339,233 @@ static void bst_node_free(bst_st_node_t *root) {
         bst_node_free(root->right);
     }
 
-    free(root);
+    bst_arena_free(root, sizeof(bst_st_node_t));
+}
+#endif
+
+BST_ERROR bst_st_memory_stats(bst_st_t **bst, bst_memory_stats_t *stats) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    const bst_st_t *bst_ = *bst;
+
+    if (stats != NULL) {
+        stats->live_nodes = bst_->allocs - bst_->frees;
+#ifdef BST_COMPACT_NODES
+        stats->node_bytes = bst_->pool.committed;
+#else
+        stats->node_bytes = stats->live_nodes * sizeof(bst_st_node_t);
+#endif
+        stats->lock_bytes = 0;
+        stats->meta_bytes = sizeof(bst_st_t);
+        stats->pending_nodes = 0;
+        stats->pending_bytes = 0;
+        stats->allocs = bst_->allocs;
+        stats->frees = bst_->frees;
+    }
+
+    return SUCCESS;
+}
+
+// Appends every value in order, returns 0 if the traversal stack can't grow
+static int bst_st_save_nodes(bst_st_t *bst, bst_snapshot_writer_t *writer) {
+    size_t capacity = 64, top = 0;
+    bst_st_node_t **stack = malloc(capacity * sizeof(bst_st_node_t *));
+
+    if (stack == NULL) {
+        return 0;
+    }
+
+    bst_st_node_t *node = bst_st_node(bst, bst->root);
+
+    while (node != NULL || top > 0) {
+        while (node != NULL) {
+            if (top == capacity) {
+                bst_st_node_t **s =
+                    realloc(stack, 2 * capacity * sizeof(bst_st_node_t *));
+
+                if (s == NULL) {
+                    free(stack);
+                    return 0;
+                }
+
+                stack = s;
+                capacity *= 2;
+            }
+
+            stack[top++] = node;
+            node = bst_st_node(bst, node->left);
+        }
+
+        node = stack[--top];
+        bst_snapshot_writer_append(writer, node->value);
+        node = bst_st_node(bst, node->right);
+    }
+
+    free(stack);
+
+    return 1;
+}
+
+BST_ERROR bst_st_save(bst_st_t **bst, const char *path) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_st_t *bst_ = *bst;
+    bst_snapshot_writer_t writer;
+
+    BST_ERROR err = bst_snapshot_writer_open(&writer, path);
+
+    if (!IS_SUCCESS(err)) {
+        return err;
+    }
+
+    const int saved = bst_st_save_nodes(bst_, &writer);
+
+    err = bst_snapshot_writer_close(&writer, !saved);
+
+    return saved ? err : MALLOC_FAILURE;
+}
+
+// Runs in the snapshot child on its copy of the tree
+static int bst_st_save_child(void *bst, bst_snapshot_writer_t *writer) {
+    return bst_st_save_nodes(bst, writer);
+}
+
+BST_ERROR bst_st_save_background(bst_st_t **bst, const char *path,
+                                 bst_snapshot_job_t *job) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    return bst_snapshot_fork(job, path, bst_st_save_child, *bst);
+}
+
+// Builds a balanced subtree from the sorted keys [lo, hi), the middle key is
+// the subtree root. Stops allocating after the first failure, err is set and
+// the partial tree stays linked so it can be freed.
+static bst_st_node_t *bst_st_build(bst_st_t *bst, const int64_t *keys,
+                                   const size_t lo, const size_t hi,
+                                   BST_ERROR *err) {
+    if (lo >= hi || !IS_SUCCESS(*err)) {
+        return NULL;
+    }
+
+    const size_t mid = lo + (hi - lo) / 2;
+    bst_st_node_t *node = bst_st_node_new(bst, keys[mid], err);
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    bst_st_node_t *left = bst_st_build(bst, keys, lo, mid, err);
+    bst_st_node_t *right = bst_st_build(bst, keys, mid + 1, hi, err);
+
+    node->left = bst_st_ref(bst, left);
+    node->right = bst_st_ref(bst, right);
+
+    return node;
+}
+
+bst_st_t *bst_st_load(const char *path, BST_ERROR *err) {
+    bst_snapshot_t snap;
+    BST_ERROR e = bst_snapshot_map(path, &snap);
+
+    if (!IS_SUCCESS(e)) {
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst_st_t *bst = bst_st_new(&e);
+
+    if (bst == NULL) {
+        bst_snapshot_unmap(&snap);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    const size_t count = snap.count;
+    bst_st_node_t *root = bst_st_build(bst, snap.keys, 0, count, &e);
+    bst_snapshot_unmap(&snap);
+
+    bst->root = bst_st_ref(bst, root);
+
+    if (!IS_SUCCESS(e)) {
+        bst_st_free(&bst);
+
+        if (err != NULL) {
+            *err = e;
+        }
+
+        return NULL;
+    }
+
+    bst->count = count;
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return bst;
+}
+
+#ifdef BST_COMPACT_NODES
+bst_st_t *bst_st_open(const char *path, BST_ERROR *err) {
+    bst_st_t *bst = malloc(sizeof(bst_st_t));
+
+    if (bst == NULL) {
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+        return NULL;
+    }
+
+    uint32_t root = BST_ST_NIL;
+    uint64_t count = 0;
+
+    const BST_ERROR e = bst_pool_open(&bst->pool, sizeof(bst_st_node_t), path,
+                                      &root, &count);
+
+    if (!IS_SUCCESS(e)) {
+        free(bst);
+
+        if (err != NULL) {
+            *err = e;
+        }
+        return NULL;
+    }
+
+    bst->count = count;
+    bst->root = root;
+    bst->allocs = count; // Nodes allocated before the restart
+    bst->frees = 0;
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+    return bst;
 }
 
+BST_ERROR bst_st_checkpoint(bst_st_t **bst) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    bst_st_t *bst_ = *bst;
+
+    return bst_pool_checkpoint(&bst_->pool, bst_->root, bst_->count);
+}
+#endif
+
 BST_ERROR bst_st_free(bst_st_t **bst) {
     if (bst == NULL || *bst == NULL) {
         return BST_NULL;
@@ -297,9 +575,81 @@ BST_ERROR bst_st_free(bst_st_t **bst) {
 
     *bst = NULL;
 
+#ifdef BST_COMPACT_NODES
+    bst_pool_destroy(&bst_->pool); // Releases every node at once
+#else
     bst_node_free(bst_->root);
+#endif
 
     free(bst_);
 
     return SUCCESS;
-}
\ No newline at end of file
+}
+
+// The bst_st_engine wrappers, see bst_engine.h
+static void *bst_st_engine_new(const bst_engine_config_t *config,
+                               BST_ERROR *err) {
+    (void)config;
+    return bst_st_new(err);
+}
+
+static BST_ERROR bst_st_engine_free(void **bst) {
+    return bst_st_free((bst_st_t **)bst);
+}
+
+static BST_ERROR bst_st_engine_add(void **bst, const int64_t value) {
+    return bst_st_add((bst_st_t **)bst, value);
+}
+
+static BST_ERROR bst_st_engine_search(void **bst, const int64_t value) {
+    return bst_st_search((bst_st_t **)bst, value);
+}
+
+static BST_ERROR bst_st_engine_min(void **bst, int64_t *value) {
+    return bst_st_min((bst_st_t **)bst, value);
+}
+
+static BST_ERROR bst_st_engine_max(void **bst, int64_t *value) {
+    return bst_st_max((bst_st_t **)bst, value);
+}
+
+static BST_ERROR bst_st_engine_delete(void **bst, const int64_t value) {
+    return bst_st_delete((bst_st_t **)bst, value);
+}
+
+static BST_ERROR bst_st_engine_count(void **bst, size_t *value) {
+    if (bst == NULL || *bst == NULL) {
+        return BST_NULL;
+    }
+
+    *value = ((bst_st_t *)*bst)->count;
+    return SUCCESS;
+}
+
+static BST_ERROR bst_st_engine_stats(void **bst, bst_engine_stats_t *stats) {
+    *stats = (bst_engine_stats_t){0};
+    return bst_st_memory_stats((bst_st_t **)bst, &stats->memory);
+}
+
+static BST_ERROR bst_st_engine_save_background(void **bst, const char *path,
+                                               bst_snapshot_job_t *job) {
+    return bst_st_save_background((bst_st_t **)bst, path, job);
+}
+
+const bst_engine_ops bst_st_engine = {
+    .abi_version = BST_ENGINE_ABI_VERSION,
+    .name = "ST",
+    .threaded = 0,
+    .node_size = sizeof(bst_st_node_t),
+    .node_lock = "none",
+    .new = bst_st_engine_new,
+    .free = bst_st_engine_free,
+    .add = bst_st_engine_add,
+    .search = bst_st_engine_search,
+    .min = bst_st_engine_min,
+    .max = bst_st_engine_max,
+    .delete = bst_st_engine_delete,
+    .count = bst_st_engine_count,
+    .stats = bst_st_engine_stats,
+    .save_background = bst_st_engine_save_background,
+};
@@ -32,14 +32,32 @@ IN THE SOFTWARE.
 #include <stdint.h>
 
 #include "../../include/bst_common.h"
+#include "../../include/bst_engine.h"
+#include "../../include/bst_snapshot.h"
+
+#ifdef BST_COMPACT_NODES
+#include "../../include/bst_pool.h"
+
+/**
+ * Reference to a tree node, 32-bit index into the BST node pool
+ */
+typedef uint32_t bst_st_ref_t;
+#define BST_ST_NIL BST_POOL_NIL
+#else
+/**
+ * Reference to a tree node
+ */
+typedef struct bst_st_node *bst_st_ref_t;
+#define BST_ST_NIL NULL
+#endif
 
 /**
- * Holds a tree node with pointer to both children nodes
+ * Holds a tree node with references to both children nodes
  */
 typedef struct bst_st_node {
     int64_t value;
-    struct bst_st_node *left;
-    struct bst_st_node *right;
+    bst_st_ref_t left;
+    bst_st_ref_t right;
 } bst_st_node_t;
 
 /**
@@ -47,7 +65,12 @@ typedef struct bst_st_node {
  */
 typedef struct bst_st {
     size_t count;
-    bst_st_node_t *root;
+    bst_st_ref_t root;
+    size_t allocs;
+    size_t frees;
+#ifdef BST_COMPACT_NODES
+    bst_pool_t pool;
+#endif
 } bst_st_t;
 
 // Prototypes
@@ -139,6 +162,120 @@ BST_ERROR bst_st_max(bst_st_t **bst, int64_t *value);
  */
 BST_ERROR bst_st_delete(bst_st_t **bst, int64_t value);
 
+/**
+ * Finds and places in stats the memory held by the BST.
+ *
+ * @param bst   the BST to measure.
+ * @param stats pointer to store the memory stats, memory must be
+ * pre-allocated.
+ * @return
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * SUCCESS                  - stats are stored in stats, if stats is not NULL.
+ */
+BST_ERROR bst_st_memory_stats(bst_st_t **bst, bst_memory_stats_t *stats);
+
+/**
+ * Writes a snapshot of the BST to path, see bst_snapshot.h for the format. The
+ * snapshot is written to a temporary file and renamed over path once synced.
+ *
+ * @param bst  the BST to save.
+ * @param path the snapshot file path.
+ * @return
+ * BST_NULL                 - when provided bst pointer is null.
+ *
+ * MALLOC_FAILURE           - failed to allocate the traversal stack, path is
+ *  untouched.
+ *
+ * IO_FAILURE               - failed to write the snapshot, path is untouched.
+ *
+ * SUCCESS                  - snapshot written.
+ */
+BST_ERROR bst_st_save(bst_st_t **bst, const char *path);
+
+/**
+ * Creates a BST from a snapshot written by any bst_*_save(). The file is
+ * mapped and the tree is built balanced straight from the sorted keys, no
+ * comparisons are made.
+ *
+ * Check the bitmask of err for possible error combinations:
+ * SUCCESS          - pointer to BST is returned.
+ *
+ * MALLOC_FAILURE   - failed to allocate the BST or its nodes.
+ *
+ * IO_FAILURE       - failed to open or map path.
+ *
+ * INVALID_SNAPSHOT - path is not a valid snapshot.
+ *
+ * @param path the snapshot file path.
+ * @param err NULL (no effect) or allocated pointer to store any errors
+ * @return NULL or BST
+ */
+bst_st_t *bst_st_load(const char *path, BST_ERROR *err);
+
+/**
+ * Writes a snapshot of the BST to path in the background. A forked child
+ * writes the snapshot from its copy-on-write view of the tree, the BST may
+ * change as soon as this returns. Wait for the snapshot with
+ * bst_snapshot_job_wait().
+ *
+ * @param bst  the BST to save.
+ * @param path the snapshot file path.
+ * @param job  job to start.
+ * @return
+ * BST_NULL       - when provided bst pointer is null.
+ *
+ * IO_FAILURE     - failed to create the result pipe.
+ *
+ * MALLOC_FAILURE - fork() failed.
+ *
+ * SUCCESS        - the child is writing the snapshot.
+ */
+BST_ERROR bst_st_save_background(bst_st_t **bst, const char *path,
+                                 bst_snapshot_job_t *job);
+
+#ifdef BST_COMPACT_NODES
+/**
+ * Opens the persistent BST stored at path, creating an empty one if the file
+ * does not exist. Nodes live in a file backed node pool (bst_pool_open())
+ * and are used straight from the mapping, the tree is not rebuilt.
+ *
+ * The tree opened is the one of the last checkpoint, changes made after it are
+ * lost on a crash or when the BST is freed.
+ *
+ * Check the bitmask of err for possible error combinations:
+ * SUCCESS          - pointer to BST is returned.
+ *
+ * MALLOC_FAILURE   - failed to allocate the BST or reserve its pool.
+ *
+ * IO_FAILURE       - failed to open, recover or map path.
+ *
+ * INVALID_SNAPSHOT - path is not a pool file of this BST type.
+ *
+ * @param path the pool file path.
+ * @param err NULL (no effect) or allocated pointer to store any errors
+ * @return NULL or BST
+ */
+bst_st_t *bst_st_open(const char *path, BST_ERROR *err);
+
+/**
+ * Makes the current tree durable, bst_st_open() returns it after a restart
+ * or crash. Only pages changed since the last checkpoint are written.
+ *
+ * @param bst the BST returned by bst_st_open().
+ * @return
+ * SUCCESS        - checkpoint durable.
+ *
+ * BST_NULL       - when provided bst pointer is null.
+ *
+ * MALLOC_FAILURE - failed to allocate the dirty page list.
+ *
+ * IO_FAILURE     - bst is not persistent or a write failed, the previous
+ *  checkpoint stays valid.
+ */
+BST_ERROR bst_st_checkpoint(bst_st_t **bst);
+#endif
+
 /**
  * Frees a BST.
  *
@@ -149,4 +286,9 @@ BST_ERROR bst_st_delete(bst_st_t **bst, int64_t value);
  * SUCCESS  - bst and all nodes freed.
  */
 BST_ERROR bst_st_free(bst_st_t **bst);
+
+/**
+ * The ST BST as a bst_engine_ops, see bst_engine.h.
+ */
+extern const bst_engine_ops bst_st_engine;
 #endif // BST_ST_H_
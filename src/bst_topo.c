@@ -0,0 +1,320 @@
+/*
+Universidade Aberta
+File: bst_topo.c
+Author: Hugo Gonçalves, 2100562
+
+CPU topology and thread placement
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/bst_topo.h"
+
+// Longest CPU list read from sysfs
+#define BST_TOPO_LINE_BYTES 4096
+
+// Parses a CPU list in the sysfs format, "0-3,8,10-11", into an allocated
+// array of CPU numbers in list order
+static BST_ERROR bst_topo_parse(const char *s, int **cpus, size_t *count) {
+    *cpus = NULL;
+    *count = 0;
+
+    for (const char *p = s;;) {
+        char *end;
+
+        if (!isdigit((unsigned char)*p)) {
+            break;
+        }
+
+        errno = 0;
+        const long lo = strtol(p, &end, 10);
+        long hi = lo;
+        p = end;
+
+        if (*p == '-') {
+            p++;
+            if (!isdigit((unsigned char)*p)) {
+                break;
+            }
+
+            hi = strtol(p, &end, 10);
+            p = end;
+        }
+
+        if (errno != 0 || lo > hi || hi >= CPU_SETSIZE) {
+            break;
+        }
+
+        int *grown = realloc(*cpus, sizeof(int) * (*count + hi - lo + 1));
+        if (grown == NULL) {
+            free(*cpus);
+            *cpus = NULL;
+            return MALLOC_FAILURE;
+        }
+
+        *cpus = grown;
+        for (long cpu = lo; cpu <= hi; cpu++) {
+            (*cpus)[(*count)++] = (int)cpu;
+        }
+
+        if (*p == ',') {
+            p++;
+            continue;
+        }
+
+        if (*p == '\0' || *p == '\n') {
+            return SUCCESS;
+        }
+
+        break;
+    }
+
+    free(*cpus);
+    *cpus = NULL;
+    *count = 0;
+    return INVALID_CPU_LIST;
+}
+
+static int bst_topo_read_int(const char *root, const int cpu, const char *name,
+                             int *value) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof path, "%s/cpu%d/topology/%s", root, cpu, name);
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    const int read = fscanf(f, "%d", value) == 1;
+    fclose(f);
+
+    return read;
+}
+
+// Package, then core, then SMT sibling
+static int bst_topo_compact_cmp(const void *a, const void *b) {
+    const bst_topo_cpu_t *x = a, *y = b;
+
+    if (x->package != y->package) {
+        return x->package < y->package ? -1 : 1;
+    }
+
+    if (x->core != y->core) {
+        return x->core < y->core ? -1 : 1;
+    }
+
+    return (x->cpu > y->cpu) - (x->cpu < y->cpu);
+}
+
+// SMT sibling, then core within the package, then package
+static int bst_topo_scatter_cmp(const void *a, const void *b) {
+    const bst_topo_cpu_t *x = a, *y = b;
+
+    if (x->thread != y->thread) {
+        return x->thread < y->thread ? -1 : 1;
+    }
+
+    if (x->rank != y->rank) {
+        return x->rank < y->rank ? -1 : 1;
+    }
+
+    return (x->package > y->package) - (x->package < y->package);
+}
+
+BST_ERROR bst_topo_load(const char *root, bst_topo_t *topo) {
+    topo->cpus = NULL;
+    topo->count = 0;
+
+    char path[PATH_MAX];
+    char line[BST_TOPO_LINE_BYTES];
+    snprintf(path, sizeof path, "%s/online", root);
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return IO_FAILURE;
+    }
+
+    const int read = fgets(line, sizeof line, f) != NULL;
+    fclose(f);
+
+    if (!read) {
+        return IO_FAILURE;
+    }
+
+    int *online;
+    size_t n;
+    BST_ERROR e = bst_topo_parse(line, &online, &n);
+    if (e != SUCCESS) {
+        return e == MALLOC_FAILURE ? MALLOC_FAILURE : IO_FAILURE;
+    }
+
+    topo->cpus = malloc(sizeof(bst_topo_cpu_t) * n);
+    if (topo->cpus == NULL) {
+        free(online);
+        return MALLOC_FAILURE;
+    }
+
+    // Containers and taskset may leave only some of the online CPUs
+    cpu_set_t allowed;
+    const int masked = sched_getaffinity(0, sizeof allowed, &allowed) == 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const int cpu = online[i];
+
+        if (masked && !CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+
+        bst_topo_cpu_t *c = &topo->cpus[topo->count++];
+        c->cpu = cpu;
+
+        // core holds the core_id of sysfs until the cores are numbered, the
+        // negative ids given to CPUs without one are never shared
+        if (!bst_topo_read_int(root, cpu, "physical_package_id",
+                               &c->package) ||
+            !bst_topo_read_int(root, cpu, "core_id", &c->core)) {
+            c->package = 0;
+            c->core = INT_MIN + cpu;
+        }
+    }
+
+    free(online);
+
+    if (topo->count == 0) {
+        bst_topo_free(topo);
+        return IO_FAILURE;
+    }
+
+    qsort(topo->cpus, topo->count, sizeof(bst_topo_cpu_t),
+          bst_topo_compact_cmp);
+
+    // Number the cores and the SMT siblings of each one
+    int core = -1, rank = 0, thread = 0;
+    int last_package = 0, last_id = 0;
+
+    for (size_t i = 0; i < topo->count; i++) {
+        bst_topo_cpu_t *c = &topo->cpus[i];
+        const int id = c->core;
+
+        if (i > 0 && c->package == last_package && id == last_id) {
+            thread++;
+        } else {
+            rank = i > 0 && c->package == last_package ? rank + 1 : 0;
+            core++;
+            thread = 0;
+        }
+
+        last_package = c->package;
+        last_id = id;
+        c->core = core;
+        c->rank = rank;
+        c->thread = thread;
+    }
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_topo_place(const bst_topo_t *topo, const int placement,
+                         const char *list, const size_t n, int *cpus) {
+    if (placement == BST_TOPO_LIST) {
+        int *order;
+        size_t count;
+        const BST_ERROR e = bst_topo_parse(list, &order, &count);
+        if (e != SUCCESS) {
+            return e;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (bst_topo_find(topo, order[i]) == NULL) {
+                free(order);
+                return INVALID_CPU_LIST;
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            cpus[i] = order[i % count];
+        }
+
+        free(order);
+        return SUCCESS;
+    }
+
+    // The topology is kept in compact order
+    bst_topo_cpu_t *order = malloc(sizeof(bst_topo_cpu_t) * topo->count);
+    if (order == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    memcpy(order, topo->cpus, sizeof(bst_topo_cpu_t) * topo->count);
+
+    if (placement == BST_TOPO_SCATTER) {
+        qsort(order, topo->count, sizeof(bst_topo_cpu_t),
+              bst_topo_scatter_cmp);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        cpus[i] = order[i % topo->count].cpu;
+    }
+
+    free(order);
+    return SUCCESS;
+}
+
+const bst_topo_cpu_t *bst_topo_find(const bst_topo_t *topo, const int cpu) {
+    for (size_t i = 0; i < topo->count; i++) {
+        if (topo->cpus[i].cpu == cpu) {
+            return &topo->cpus[i];
+        }
+    }
+
+    return NULL;
+}
+
+BST_ERROR bst_topo_pin(const pthread_t thread, const int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return INVALID_CPU_LIST;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return pthread_setaffinity_np(thread, sizeof set, &set) == 0
+               ? SUCCESS
+               : INVALID_CPU_LIST;
+}
+
+void bst_topo_free(bst_topo_t *topo) {
+    free(topo->cpus);
+    topo->cpus = NULL;
+    topo->count = 0;
+}
@@ -0,0 +1,221 @@
+/*
+Universidade Aberta
+File: bst_trace.c
+Author: Hugo Gonçalves, 2100562
+
+Per thread operation trace ring files
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/bst_trace.h"
+
+bst_trace_t *bst_trace_create(const char *path, const uint32_t thread,
+                              const size_t capacity, BST_ERROR *err) {
+    bst_trace_t *trace = calloc(1, sizeof(bst_trace_t));
+
+    if (trace == NULL) {
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+        return NULL;
+    }
+
+    trace->size = sizeof(bst_trace_header_t) +
+                  (capacity > 0 ? capacity : 1) * sizeof(bst_trace_record_t);
+    trace->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (trace->fd >= 0 && ftruncate(trace->fd, (off_t)trace->size) == 0) {
+        trace->map = mmap(NULL, trace->size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, trace->fd, 0);
+    } else {
+        trace->map = MAP_FAILED;
+    }
+
+    if (trace->map == MAP_FAILED) {
+        if (trace->fd >= 0) {
+            close(trace->fd);
+        }
+        free(trace);
+        if (err != NULL) {
+            *err = IO_FAILURE;
+        }
+        return NULL;
+    }
+
+    trace->header = trace->map;
+    trace->records = (bst_trace_record_t *)(trace->header + 1);
+
+    memcpy(trace->header->magic, BST_TRACE_MAGIC, sizeof(BST_TRACE_MAGIC));
+    trace->header->version = BST_TRACE_VERSION;
+    trace->header->thread = thread;
+    trace->header->capacity = capacity > 0 ? capacity : 1;
+    trace->header->written = 0;
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return trace;
+}
+
+void bst_trace_record(bst_trace_t *trace, const bst_trace_op_t op,
+                      const int64_t key, const BST_ERROR result) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    bst_trace_header_t *h = trace->header;
+    bst_trace_record_t *r = &trace->records[h->written % h->capacity];
+
+    r->time_ns = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    r->key = key;
+    r->op = op;
+    r->result = result;
+
+    // Published after the record, a crashed process leaves whole records.
+    // The file is only read after the writer is gone, so keeping the
+    // compiler from sinking the record stores below the count is enough.
+    atomic_signal_fence(memory_order_release);
+    h->written++;
+}
+
+bst_trace_t *bst_trace_open(const char *path, BST_ERROR *err) {
+    bst_trace_t *trace = calloc(1, sizeof(bst_trace_t));
+
+    if (trace == NULL) {
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+        return NULL;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(trace);
+        if (err != NULL) {
+            *err = IO_FAILURE;
+        }
+        return NULL;
+    }
+
+    trace->fd = -1;
+    trace->size = (size_t)st.st_size;
+    trace->map = MAP_FAILED;
+
+    if (trace->size >= sizeof(bst_trace_header_t)) {
+        trace->map = mmap(NULL, trace->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    BST_ERROR e = SUCCESS;
+
+    if (trace->size < sizeof(bst_trace_header_t)) {
+        e = INVALID_TRACE;
+    } else if (trace->map == MAP_FAILED) {
+        e = IO_FAILURE;
+    } else {
+        trace->header = trace->map;
+        trace->records = (bst_trace_record_t *)(trace->header + 1);
+
+        const bst_trace_header_t *h = trace->header;
+        const size_t room = (trace->size - sizeof(bst_trace_header_t)) /
+                            sizeof(bst_trace_record_t);
+
+        if (memcmp(h->magic, BST_TRACE_MAGIC, sizeof(BST_TRACE_MAGIC)) != 0 ||
+            h->version != BST_TRACE_VERSION || h->capacity == 0 ||
+            room < bst_trace_count(trace)) {
+            munmap(trace->map, trace->size);
+            e = INVALID_TRACE;
+        }
+    }
+
+    if (!IS_SUCCESS(e)) {
+        free(trace);
+        trace = NULL;
+    }
+
+    if (err != NULL) {
+        *err = e;
+    }
+
+    return trace;
+}
+
+size_t bst_trace_count(const bst_trace_t *trace) {
+    const bst_trace_header_t *h = trace->header;
+    return h->written < h->capacity ? h->written : h->capacity;
+}
+
+const bst_trace_record_t *bst_trace_at(const bst_trace_t *trace,
+                                       const size_t i) {
+    const bst_trace_header_t *h = trace->header;
+    const uint64_t first = h->written - bst_trace_count(trace);
+
+    return &trace->records[(first + i) % h->capacity];
+}
+
+BST_ERROR bst_trace_close(bst_trace_t **trace) {
+    if (trace == NULL || *trace == NULL) {
+        return BST_NULL;
+    }
+
+    bst_trace_t *t = *trace;
+    int ok = 1;
+
+    if (t->fd >= 0) {
+        const bst_trace_header_t *h = t->header;
+        size_t used = t->size;
+
+        if (h->written < h->capacity) {
+            used = sizeof(bst_trace_header_t) +
+                   h->written * sizeof(bst_trace_record_t);
+        }
+
+        munmap(t->map, t->size);
+
+        if (ftruncate(t->fd, (off_t)used) != 0 || close(t->fd) != 0) {
+            ok = 0;
+        }
+    } else {
+        munmap(t->map, t->size);
+    }
+
+    free(t);
+    *trace = NULL;
+
+    return ok ? SUCCESS : IO_FAILURE;
+}
@@ -0,0 +1,601 @@
+/*
+Universidade Aberta
+File: bst_wal.c
+Author: Hugo Gonçalves, 2100562
+
+Write-ahead log with group commit
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/bst_wal.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+// Buffer states. A buffer stays in the log list until bst_wal_close(),
+// FREE buffers are adopted by the next new thread. ORPHANED means the log
+// was closed while a thread still owned it, the owner frees it on release.
+enum { WAL_FREE = 0, WAL_ACTIVE = 1, WAL_ORPHANED = 2 };
+
+// Buffer owned by the calling thread, cached across appends
+static _Thread_local bst_wal_buffer_t *wal_local = NULL;
+
+static pthread_key_t wal_key;
+static pthread_once_t wal_key_once = PTHREAD_ONCE_INIT;
+
+static uint32_t bst_wal_check(const uint64_t seq, const int64_t value,
+                              const uint32_t op) {
+    uint64_t h = FNV_OFFSET;
+    h = (h ^ seq) * FNV_PRIME;
+    h = (h ^ (uint64_t)value) * FNV_PRIME;
+    h = (h ^ op) * FNV_PRIME;
+
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static int bst_wal_record_valid(const bst_wal_record_t *r) {
+    return r->seq != 0 &&
+           (r->op == BST_WAL_ADD || r->op == BST_WAL_DELETE) &&
+           r->check == bst_wal_check(r->seq, r->value, r->op);
+}
+
+// Writes len bytes, retrying short writes
+static int bst_wal_write(const int fd, const void *buf, size_t len) {
+    const char *p = buf;
+
+    while (len > 0) {
+        const ssize_t n = write(fd, p, len);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return 1;
+}
+
+static void bst_wal_buffer_destroy(bst_wal_buffer_t *buf) {
+    pthread_mutex_destroy(&buf->mtx);
+    free(buf->records);
+    free(buf);
+}
+
+static void bst_wal_buffer_release(bst_wal_buffer_t *buf) {
+    // Buffered records stay, the log writer drains them
+    if (atomic_exchange(&buf->state, WAL_FREE) == WAL_ORPHANED) {
+        bst_wal_buffer_destroy(buf);
+    }
+}
+
+static void bst_wal_thread_exit(void *buf) { bst_wal_buffer_release(buf); }
+
+static void bst_wal_key_create(void) {
+    pthread_key_create(&wal_key, bst_wal_thread_exit);
+}
+
+static bst_wal_buffer_t *bst_wal_buffer_acquire(bst_wal_t *wal) {
+    pthread_once(&wal_key_once, bst_wal_key_create);
+
+    // Adopt a buffer released by a thread that is gone
+    bst_wal_buffer_t *buf = atomic_load(&wal->buffers);
+    while (buf != NULL) {
+        int expected = WAL_FREE;
+        if (atomic_load(&buf->state) == WAL_FREE &&
+            atomic_compare_exchange_strong(&buf->state, &expected,
+                                           WAL_ACTIVE)) {
+            return buf;
+        }
+        buf = buf->next;
+    }
+
+    buf = calloc(1, sizeof(bst_wal_buffer_t));
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    buf->records = malloc(BST_WAL_BUFFER_RECORDS * sizeof(bst_wal_record_t));
+    if (buf->records == NULL) {
+        free(buf);
+        return NULL;
+    }
+
+    pthread_mutex_init(&buf->mtx, NULL);
+    buf->capacity = BST_WAL_BUFFER_RECORDS;
+    atomic_store(&buf->state, WAL_ACTIVE);
+    buf->wal = wal;
+
+    // Insert into the log buffer list
+    bst_wal_buffer_t *old_head = NULL;
+    do {
+        old_head = atomic_load(&wal->buffers);
+        buf->next = old_head;
+    } while (!atomic_compare_exchange_weak(&wal->buffers, &old_head, buf));
+
+    return buf;
+}
+
+// Returns the calling thread buffer for wal, registering one on first use.
+static bst_wal_buffer_t *bst_wal_buffer(bst_wal_t *wal) {
+    bst_wal_buffer_t *buf = wal_local;
+
+    if (buf != NULL && buf->wal == wal &&
+        atomic_load(&buf->state) == WAL_ACTIVE) {
+        return buf;
+    }
+
+    if (buf != NULL) {
+        bst_wal_buffer_release(buf);
+    }
+
+    buf = bst_wal_buffer_acquire(wal);
+    wal_local = buf;
+    pthread_setspecific(wal_key, buf);
+
+    return buf;
+}
+
+// Lowers upto below the first record still buffered in buf.
+static void bst_wal_left_behind(const bst_wal_buffer_t *buf, uint64_t *upto) {
+    for (size_t i = 0; i < buf->count; i++) {
+        if (buf->records[i].seq <= *upto) {
+            *upto = buf->records[i].seq - 1;
+        }
+    }
+}
+
+// Moves every buffered record into the log writer batch. When the batch
+// cannot grow the rest stays buffered for the next commit and upto is
+// lowered below every record left behind, so only the records written
+// become durable.
+static size_t bst_wal_drain(bst_wal_t *wal, uint64_t *upto) {
+    size_t n = 0;
+    int full = 0;
+
+    for (bst_wal_buffer_t *buf = atomic_load(&wal->buffers); buf != NULL;
+         buf = buf->next) {
+        pthread_mutex_lock(&buf->mtx);
+
+        if (full) {
+            bst_wal_left_behind(buf, upto);
+            pthread_mutex_unlock(&buf->mtx);
+            continue;
+        }
+
+        if (buf->count > 0 && n + buf->count > wal->batch_capacity) {
+            size_t capacity = wal->batch_capacity * 2;
+            while (capacity < n + buf->count) {
+                capacity *= 2;
+            }
+
+            bst_wal_record_t *batch =
+                realloc(wal->batch, capacity * sizeof(bst_wal_record_t));
+            if (batch == NULL) {
+                full = 1;
+                bst_wal_left_behind(buf, upto);
+                pthread_mutex_unlock(&buf->mtx);
+                continue;
+            }
+
+            wal->batch = batch;
+            wal->batch_capacity = capacity;
+        }
+
+        memcpy(wal->batch + n, buf->records,
+               buf->count * sizeof(bst_wal_record_t));
+        n += buf->count;
+        buf->count = 0;
+
+        pthread_mutex_unlock(&buf->mtx);
+    }
+
+    return n;
+}
+
+static void bst_wal_deadline(struct timespec *ts) {
+    clock_gettime(CLOCK_REALTIME, ts);
+
+    ts->tv_nsec += BST_WAL_FLUSH_INTERVAL_US * 1000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+// Log writer. Sleeps until a thread waits on a commit or the flush interval
+// passes with records buffered, then writes everything buffered by every
+// thread with one write and one fdatasync.
+static void *bst_wal_writer(void *arg) {
+    bst_wal_t *wal = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&wal->mtx);
+        while (!wal->stop && (wal->failed || wal->requested <= wal->durable)) {
+            struct timespec ts;
+            bst_wal_deadline(&ts);
+
+            const int rc =
+                pthread_cond_timedwait(&wal->work_cond, &wal->mtx, &ts);
+
+            if (rc == ETIMEDOUT && !wal->failed &&
+                atomic_load(&wal->next_seq) - 1 > wal->durable) {
+                break;
+            }
+        }
+        const int stop = wal->stop;
+        const int failed = wal->failed;
+        pthread_mutex_unlock(&wal->mtx);
+
+        // A failed log only waits to be closed
+        if (failed) {
+            break;
+        }
+
+        // Sequence numbers are taken under the buffer locks, every record
+        // below upto is either already durable or drained below
+        uint64_t upto = atomic_load(&wal->next_seq) - 1;
+        const size_t n = bst_wal_drain(wal, &upto);
+        const size_t bytes = n * sizeof(bst_wal_record_t);
+
+        int ok = 1;
+        if (n > 0) {
+            ok = bst_wal_write(wal->fd, wal->batch, bytes) &&
+                 fdatasync(wal->fd) == 0;
+        }
+
+        pthread_mutex_lock(&wal->mtx);
+        if (ok) {
+            if (upto > wal->durable) {
+                wal->durable = upto;
+            }
+            if (n > 0) {
+                wal->records += n;
+                wal->commits++;
+                wal->bytes += bytes;
+                if (n > wal->max_batch) {
+                    wal->max_batch = n;
+                }
+            }
+        } else {
+            wal->failed = 1;
+        }
+        pthread_cond_broadcast(&wal->durable_cond);
+        pthread_mutex_unlock(&wal->mtx);
+
+        if (stop && (!ok || atomic_load(&wal->next_seq) - 1 <= upto)) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// Cuts a torn tail off an existing log and sets last to its highest sequence
+// number, 0 for an empty log. Returns 0 on I/O failure.
+static int bst_wal_recover_tail(const int fd, uint64_t *last) {
+    struct stat st;
+    if (fstat(fd, &st)) {
+        return 0;
+    }
+
+    bst_wal_record_t r;
+    off_t offset = 0;
+    *last = 0;
+
+    while (offset + (off_t)sizeof(r) <= st.st_size) {
+        if (pread(fd, &r, sizeof(r), offset) != sizeof(r) ||
+            !bst_wal_record_valid(&r)) {
+            break;
+        }
+
+        if (r.seq > *last) {
+            *last = r.seq;
+        }
+        offset += sizeof(r);
+    }
+
+    if (offset != st.st_size && ftruncate(fd, offset)) {
+        return 0;
+    }
+
+    return lseek(fd, offset, SEEK_SET) == offset;
+}
+
+bst_wal_t *bst_wal_open(const char *path, BST_ERROR *err) {
+    bst_wal_t *wal = calloc(1, sizeof(bst_wal_t));
+    if (wal != NULL) {
+        wal->batch = malloc(BST_WAL_BUFFER_RECORDS * sizeof(bst_wal_record_t));
+    }
+
+    if (wal == NULL || wal->batch == NULL) {
+        free(wal);
+        if (err != NULL) {
+            *err = MALLOC_FAILURE;
+        }
+        return NULL;
+    }
+
+    wal->batch_capacity = BST_WAL_BUFFER_RECORDS;
+
+    uint64_t last = 0;
+    wal->fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (wal->fd < 0 || !bst_wal_recover_tail(wal->fd, &last)) {
+        if (wal->fd >= 0) {
+            close(wal->fd);
+        }
+        free(wal->batch);
+        free(wal);
+        if (err != NULL) {
+            *err = IO_FAILURE;
+        }
+        return NULL;
+    }
+
+    atomic_store(&wal->next_seq, last + 1);
+    atomic_store(&wal->buffers, NULL);
+    wal->durable = last;
+    wal->requested = last;
+
+    pthread_mutex_init(&wal->mtx, NULL);
+    pthread_cond_init(&wal->work_cond, NULL);
+    pthread_cond_init(&wal->durable_cond, NULL);
+
+    if (pthread_create(&wal->writer, NULL, bst_wal_writer, wal)) {
+        pthread_cond_destroy(&wal->durable_cond);
+        pthread_cond_destroy(&wal->work_cond);
+        pthread_mutex_destroy(&wal->mtx);
+        close(wal->fd);
+        free(wal->batch);
+        free(wal);
+        if (err != NULL) {
+            *err = UNKNOWN;
+        }
+        return NULL;
+    }
+
+    if (err != NULL) {
+        *err = SUCCESS;
+    }
+
+    return wal;
+}
+
+BST_ERROR bst_wal_append(bst_wal_t *wal, const bst_wal_op_t op,
+                         const int64_t value, uint64_t *seq) {
+    bst_wal_buffer_t *buf = bst_wal_buffer(wal);
+    if (buf == NULL) {
+        return MALLOC_FAILURE;
+    }
+
+    pthread_mutex_lock(&buf->mtx);
+
+    if (buf->count == buf->capacity) {
+        bst_wal_record_t *records = realloc(
+            buf->records, buf->capacity * 2 * sizeof(bst_wal_record_t));
+        if (records == NULL) {
+            pthread_mutex_unlock(&buf->mtx);
+            return MALLOC_FAILURE;
+        }
+
+        buf->records = records;
+        buf->capacity *= 2;
+    }
+
+    bst_wal_record_t *r = &buf->records[buf->count++];
+    r->seq = atomic_fetch_add(&wal->next_seq, 1);
+    r->value = value;
+    r->op = op;
+    r->check = bst_wal_check(r->seq, value, op);
+
+    *seq = r->seq;
+
+    pthread_mutex_unlock(&buf->mtx);
+
+    return SUCCESS;
+}
+
+BST_ERROR bst_wal_wait(bst_wal_t *wal, const uint64_t seq) {
+    pthread_mutex_lock(&wal->mtx);
+
+    if (seq > wal->requested) {
+        wal->requested = seq;
+        pthread_cond_signal(&wal->work_cond);
+    }
+
+    while (wal->durable < seq && !wal->failed) {
+        pthread_cond_wait(&wal->durable_cond, &wal->mtx);
+    }
+
+    const int durable = wal->durable >= seq;
+
+    pthread_mutex_unlock(&wal->mtx);
+
+    return durable ? SUCCESS : IO_FAILURE;
+}
+
+BST_ERROR bst_wal_commit(bst_wal_t *wal, const bst_wal_op_t op,
+                         const int64_t value) {
+    uint64_t seq = 0;
+
+    const BST_ERROR be = bst_wal_append(wal, op, value, &seq);
+    if (be != SUCCESS) {
+        return be;
+    }
+
+    return bst_wal_wait(wal, seq);
+}
+
+static int bst_wal_record_compare(const void *a, const void *b) {
+    const uint64_t x = ((const bst_wal_record_t *)a)->seq;
+    const uint64_t y = ((const bst_wal_record_t *)b)->seq;
+
+    return (x > y) - (x < y);
+}
+
+BST_ERROR bst_wal_replay(const char *path,
+                         BST_ERROR (*apply)(void *ctx, bst_wal_op_t op,
+                                            int64_t value),
+                         void *ctx, size_t *replayed) {
+    if (replayed != NULL) {
+        *replayed = 0;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT ? SUCCESS : IO_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return IO_FAILURE;
+    }
+
+    const size_t available = st.st_size / sizeof(bst_wal_record_t);
+    if (available == 0) {
+        close(fd);
+        return SUCCESS;
+    }
+
+    bst_wal_record_t *records = malloc(available * sizeof(bst_wal_record_t));
+    if (records == NULL) {
+        close(fd);
+        return MALLOC_FAILURE;
+    }
+
+    size_t len = available * sizeof(bst_wal_record_t);
+    char *p = (char *)records;
+    off_t offset = 0;
+
+    while (len > 0) {
+        const ssize_t n = pread(fd, p, len, offset);
+
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            free(records);
+            close(fd);
+            return IO_FAILURE;
+        }
+
+        p += n;
+        len -= n;
+        offset += n;
+    }
+
+    close(fd);
+
+    // The log ends at the first torn record
+    size_t count = 0;
+    while (count < available && bst_wal_record_valid(&records[count])) {
+        count++;
+    }
+
+    qsort(records, count, sizeof(bst_wal_record_t), bst_wal_record_compare);
+
+    BST_ERROR result = SUCCESS;
+
+    for (size_t i = 0; i < count; i++) {
+        if (apply(ctx, records[i].op, records[i].value) & MALLOC_FAILURE) {
+            result = MALLOC_FAILURE;
+            break;
+        }
+
+        if (replayed != NULL) {
+            (*replayed)++;
+        }
+    }
+
+    free(records);
+
+    return result;
+}
+
+void bst_wal_stats(bst_wal_t *wal, bst_wal_stats_t *stats) {
+    pthread_mutex_lock(&wal->mtx);
+
+    stats->records = wal->records;
+    stats->commits = wal->commits;
+    stats->max_batch = wal->max_batch;
+    stats->bytes = wal->bytes;
+
+    pthread_mutex_unlock(&wal->mtx);
+}
+
+BST_ERROR bst_wal_close(bst_wal_t **wal) {
+    bst_wal_t *w = *wal;
+
+    pthread_mutex_lock(&w->mtx);
+    w->stop = 1;
+    pthread_cond_signal(&w->work_cond);
+    pthread_mutex_unlock(&w->mtx);
+
+    pthread_join(w->writer, NULL);
+
+    int ok = !w->failed;
+
+    if (close(w->fd)) {
+        ok = 0;
+    }
+
+    bst_wal_buffer_t *buf = atomic_load(&w->buffers);
+    while (buf != NULL) {
+        bst_wal_buffer_t *next = buf->next;
+
+        if (buf == wal_local) {
+            wal_local = NULL;
+            pthread_setspecific(wal_key, NULL);
+            bst_wal_buffer_destroy(buf);
+        } else if (atomic_exchange(&buf->state, WAL_ORPHANED) == WAL_FREE) {
+            bst_wal_buffer_destroy(buf);
+        }
+
+        buf = next;
+    }
+
+    pthread_cond_destroy(&w->durable_cond);
+    pthread_cond_destroy(&w->work_cond);
+    pthread_mutex_destroy(&w->mtx);
+    free(w->batch);
+    free(w);
+
+    *wal = NULL;
+
+    return ok ? SUCCESS : IO_FAILURE;
+}
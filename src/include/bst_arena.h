@@ -0,0 +1,120 @@
+/*
+Universidade Aberta
+File: bst_arena.h
+Author: Hugo Gonçalves, 2100562
+
+Node arena with transparent huge page support
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_ARENA_H_
+#define BST_ARENA_H_
+#include <stddef.h>
+
+#include "bst_common.h"
+
+/**
+ * Transparent huge page size and alignment of every arena region.
+ */
+#define BST_ARENA_HUGE_PAGE (2u << 20)
+
+/**
+ * Node sizes served by the arena, in BST_ARENA_ALIGN steps. Larger sizes
+ * always come from malloc.
+ */
+#define BST_ARENA_ALIGN 8
+#define BST_ARENA_MAX_SIZE 128
+
+/**
+ * Where tree nodes are allocated from:
+ *
+ * BST_ARENA_MALLOC    - malloc()/free(), the default.
+ *
+ * BST_ARENA_HUGEPAGES - 2 MB aligned regions advised with MADV_HUGEPAGE. Nodes
+ *  of the same size are packed together and released nodes are reused. When
+ *  the kernel has no transparent huge page support the regions fall back to
+ *  normal pages.
+ */
+typedef enum bst_arena_mode {
+    BST_ARENA_MALLOC = 0,
+    BST_ARENA_HUGEPAGES,
+} bst_arena_mode_t;
+
+// Prototypes
+/**
+ * Sets the node allocation mode for every BST type. Must be called before any
+ * BST is created, nodes are freed with the mode they were allocated with.
+ *
+ * @param mode the allocation mode.
+ */
+void bst_arena_set_mode(bst_arena_mode_t mode);
+
+/**
+ * @return the current node allocation mode.
+ */
+bst_arena_mode_t bst_arena_mode(void);
+
+/**
+ * Allocates a tree node of size bytes - Thread safe.
+ *
+ * @param size the node size.
+ * @return NULL or the node.
+ */
+void *bst_arena_alloc(size_t size);
+
+/**
+ * Releases a tree node allocated with bst_arena_alloc() - Thread safe.
+ *
+ * @param ptr  NULL (no effect) or the node.
+ * @param size the size the node was allocated with.
+ */
+void bst_arena_free(void *ptr, size_t size);
+
+/**
+ * Reserves size bytes of address space with prot access for a node pool.
+ * In BST_ARENA_HUGEPAGES mode the region is 2 MB aligned and advised with
+ * MADV_HUGEPAGE.
+ *
+ * @param size bytes to reserve, a multiple of the page size.
+ * @param prot mmap() protection of the region.
+ * @return NULL or the region.
+ */
+void *bst_arena_reserve(size_t size, int prot);
+
+/**
+ * Unmaps a region returned by bst_arena_reserve().
+ *
+ * @param base the region.
+ * @param size the size it was reserved with.
+ */
+void bst_arena_unreserve(void *base, size_t size);
+
+/**
+ * Reads /proc/self/smaps and sums the AnonHugePages of every arena region,
+ * i.e. how much node memory is actually backed by transparent huge pages.
+ *
+ * @return bytes backed by huge pages, 0 when none are or smaps can't be read.
+ */
+size_t bst_arena_huge_bytes(void);
+#endif // BST_ARENA_H_
@@ -30,6 +30,7 @@ IN THE SOFTWARE.
 
 #ifndef BST_COMMON_H_
 #define BST_COMMON_H_
+#include <stddef.h>
 
 #define PANIC(msg)                                                             \
     {                                                                          \
@@ -64,12 +65,35 @@ typedef enum BST_ERROR {
     PT_RWLOCK_LOCK_FAILURE         = (1u << 12),
     PT_RWLOCK_UNLOCK_FAILURE       = (1u << 13),
     UNKNOWN                        = (1u << 14),
-    CAS_FAILED                     = (1u << 15)
+    CAS_FAILED                     = (1u << 15),
+    IO_FAILURE                     = (1u << 16),
+    INVALID_SNAPSHOT               = (1u << 17),
+    INVALID_KEY_FILE               = (1u << 18),
+    INVALID_TRACE                  = (1u << 19),
+    INVALID_CPU_LIST               = (1u << 20),
+    INVALID_RESULT                 = (1u << 21)
 } BST_ERROR;
 // clang-format on
 
 #define IS_SUCCESS(a) (((a) & SUCCESS) == SUCCESS ? 1 : 0)
 
+/**
+ * Memory held by a BST, filled by bst_*_memory_stats(). node_bytes, lock_bytes
+ * and meta_bytes are disjoint and add up to the tree footprint. Nodes pending
+ * reclamation are still allocated, so they are part of live_nodes and
+ * node_bytes as well.
+ */
+typedef struct bst_memory_stats {
+    size_t live_nodes;    // nodes allocated and not freed yet
+    size_t node_bytes;    // bytes allocated for nodes, embedded locks excluded
+    size_t lock_bytes;    // node locks, lock tables and tree locks
+    size_t meta_bytes;    // tree struct and reclamation bookkeeping
+    size_t pending_nodes; // unlinked nodes waiting to be reclaimed
+    size_t pending_bytes; // bytes of the nodes waiting to be reclaimed
+    size_t allocs;        // node allocations since the tree was created
+    size_t frees;         // node frees since the tree was created
+} bst_memory_stats_t;
+
 // To simulate more complex tree node value comparison, there is a psuedosleep
 // implemented. Avoided using sleep or nanosleep to not have the thread hanging
 // after the sleep due to the kernel scheduler.
@@ -0,0 +1,90 @@
+/*
+Universidade Aberta
+File: bst_dist.h
+Author: Hugo Gonçalves, 2100562
+
+Skewed key selection for the test harness
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_DIST_H_
+#define BST_DIST_H_
+#include <stddef.h>
+
+#include "bst_rand.h"
+
+// YCSB's Zipfian constant
+#define BST_DIST_DEFAULT_THETA 0.99
+
+typedef enum bst_dist_kind {
+    // Every index equally likely
+    BST_DIST_UNIFORM,
+
+    // Index k picked with probability proportional to 1 / (k + 1)^theta
+    BST_DIST_ZIPF,
+
+    // hot_prob of the picks go to the first hot_frac of the indexes
+    BST_DIST_HOTSPOT,
+
+    // Zipfian over recency, index n - 1 is the most likely
+    BST_DIST_LATEST,
+} bst_dist_kind_t;
+
+/**
+ * Key index selector. Zipfian picks use rejection-inversion sampling
+ * (Hörmann and Derflinger), O(1) per pick for any number of indexes, with the
+ * constants that depend on theta computed once by bst_dist_init().
+ */
+typedef struct bst_dist {
+    bst_dist_kind_t kind;
+    double theta;
+    double hot_frac;
+    double hot_prob;
+    double h_x1; // H(1.5) - 1
+    double s;    // 2 - H^-1(H(2.5) - h(2))
+} bst_dist_t;
+
+// Prototypes
+/**
+ * Sets up a selector, the parameters a kind does not use are ignored.
+ *
+ * @param dist     the selector.
+ * @param kind     the distribution.
+ * @param theta    zipf and latest exponent, greater than 0.
+ * @param hot_frac hotspot share of the indexes, 0 to 1.
+ * @param hot_prob hotspot share of the picks, 0 to 1.
+ */
+void bst_dist_init(bst_dist_t *dist, bst_dist_kind_t kind, double theta,
+                   double hot_frac, double hot_prob);
+
+/**
+ * Picks an index - Thread safe, each thread keeps its own generator.
+ *
+ * @param dist the selector.
+ * @param rng  generator of the calling thread.
+ * @param n    number of indexes, at least 1.
+ * @return index from 0 to n - 1
+ */
+size_t bst_dist_next(const bst_dist_t *dist, bst_rand_t *rng, size_t n);
+#endif // BST_DIST_H_
@@ -0,0 +1,101 @@
+/*
+Universidade Aberta
+File: bst_engine.h
+Author: Hugo Gonçalves, 2100562
+
+BST engine interface shared by the built-in engines and plugins
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_ENGINE_H_
+#define BST_ENGINE_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bst_common.h"
+#include "bst_snapshot.h"
+
+// Bumped whenever bst_engine_ops changes, plugins built for another version
+// are refused
+#define BST_ENGINE_ABI_VERSION 1
+
+// Symbol of the bst_engine_ops a plugin exports
+#define BST_ENGINE_SYMBOL "bst_engine"
+
+/**
+ * Settings of a new tree, engines ignore the ones they have no use for.
+ */
+typedef struct bst_engine_config {
+    size_t frames; // buffer pool capacity of disk resident engines, in pages
+} bst_engine_config_t;
+
+/**
+ * Counters of a tree read by bst_engine_ops.stats.
+ */
+typedef struct bst_engine_stats {
+    bst_memory_stats_t memory;
+    uint64_t pool_hits; // buffer pool of disk resident engines, 0 otherwise
+    uint64_t pool_misses;
+    uint64_t pool_writebacks;
+} bst_engine_stats_t;
+
+/**
+ * Operations of a BST engine. The built-in engines export theirs as
+ * bst_<engine>_engine, a plugin is a shared object exporting one named
+ * bst_engine:
+ *
+ * const bst_engine_ops bst_engine = {
+ *     .abi_version = BST_ENGINE_ABI_VERSION,
+ *     .name = "MY",
+ *     ...
+ * };
+ *
+ * Every operation takes the address of the tree pointer new returned and
+ * returns the BST_ERROR bitmask of the bst_*_ functions: add VALUE_EXISTS,
+ * search and delete VALUE_NONEXISTENT, min and max BST_EMPTY. min and max
+ * accept a NULL value. Operations called by several threads at once must be
+ * safe to, unless threaded is 0.
+ */
+typedef struct bst_engine_ops {
+    uint32_t abi_version; // BST_ENGINE_ABI_VERSION
+    const char *name;     // bst_type of the results
+    int threaded;         // 0 tests the engine with a single thread
+    size_t node_size;     // printed by -i
+    const char *node_lock;
+
+    void *(*new)(const bst_engine_config_t *config, BST_ERROR *err);
+    BST_ERROR (*free)(void **bst);
+    BST_ERROR (*add)(void **bst, int64_t value);
+    BST_ERROR (*search)(void **bst, int64_t value);
+    BST_ERROR (*min)(void **bst, int64_t *value);
+    BST_ERROR (*max)(void **bst, int64_t *value);
+    BST_ERROR (*delete)(void **bst, int64_t value);
+    BST_ERROR (*count)(void **bst, size_t *value);
+    BST_ERROR (*stats)(void **bst, bst_engine_stats_t *stats);
+
+    // Optional, NULL when the engine has no background snapshot
+    BST_ERROR (*save_background)(void **bst, const char *path,
+                                 bst_snapshot_job_t *job);
+} bst_engine_ops;
+#endif // BST_ENGINE_H_
@@ -0,0 +1,94 @@
+/*
+Universidade Aberta
+File: bst_hist.h
+Author: Hugo Gonçalves, 2100562
+
+Log bucketed latency histograms
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_HIST_H_
+#define BST_HIST_H_
+#include <stddef.h>
+#include <stdint.h>
+
+// Each power of two range is split in 2^BST_HIST_SUB_BITS buckets, values
+// are kept within 1 / 2^BST_HIST_SUB_BITS (3%) of what was recorded
+#define BST_HIST_SUB_BITS 5
+#define BST_HIST_SUB_BUCKETS (1u << BST_HIST_SUB_BITS)
+#define BST_HIST_BUCKETS ((64 - BST_HIST_SUB_BITS + 1) * BST_HIST_SUB_BUCKETS)
+
+/**
+ * HDR style histogram of 64 bit values, values below BST_HIST_SUB_BUCKETS
+ * get a bucket each, above that every power of two range gets
+ * BST_HIST_SUB_BUCKETS of them. Not thread safe, keep one per thread and
+ * merge them.
+ */
+typedef struct bst_hist {
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[BST_HIST_BUCKETS];
+} bst_hist_t;
+
+// Prototypes
+/**
+ * Empties a histogram.
+ *
+ * @param hist the histogram.
+ */
+void bst_hist_reset(bst_hist_t *hist);
+
+/**
+ * Counts a value.
+ *
+ * @param hist  the histogram.
+ * @param value the value, latencies are in nanoseconds.
+ */
+void bst_hist_record(bst_hist_t *hist, uint64_t value);
+
+/**
+ * Adds the counts of from to into.
+ *
+ * @param into the histogram merged into.
+ * @param from the histogram merged.
+ */
+void bst_hist_merge(bst_hist_t *into, const bst_hist_t *from);
+
+/**
+ * Value at or below which percentile percent of the counted values are. The
+ * highest value of the bucket is returned, never more than the largest value
+ * counted.
+ *
+ * @param hist       the histogram.
+ * @param percentile 0 to 100, 100 returns the largest value counted.
+ * @return the value or 0 for an empty histogram.
+ */
+uint64_t bst_hist_percentile(const bst_hist_t *hist, double percentile);
+
+/**
+ * @param bucket bucket index, below BST_HIST_BUCKETS.
+ * @return the highest value counted in bucket.
+ */
+uint64_t bst_hist_bucket_max(size_t bucket);
+#endif // BST_HIST_H_
@@ -0,0 +1,96 @@
+/*
+Universidade Aberta
+File: bst_keys.h
+Author: Hugo Gonçalves, 2100562
+
+Key set import from files and streams
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_KEYS_H_
+#define BST_KEYS_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bst_common.h"
+#include "bst_snapshot.h"
+
+// Bytes looked at to tell text from binary key files
+#define BST_KEYS_SNIFF_BYTES 4096
+
+// Bytes read from a stream at a time
+#define BST_KEYS_STREAM_BYTES (1 << 20)
+
+/**
+ * Imported key set. Snapshots and binary files are used straight from their
+ * mapping, text is parsed into one allocated array.
+ */
+typedef struct bst_keys {
+    const int64_t *keys;
+    size_t count;
+    void *map; // mapped binary key file
+    size_t map_size;
+    int64_t *parsed;     // keys parsed from text or read from a stream
+    bst_snapshot_t snap; // mapped snapshot
+} bst_keys_t;
+
+// Prototypes
+/**
+ * Loads a key set, the format is detected from the content:
+ *
+ * snapshot - a file written by bst_*_save(), raw or compressed.
+ *
+ * text     - one decimal int64_t per line, surrounding blanks and empty lines
+ *  are allowed. Files are split in chunks at line boundaries and parsed by
+ *  threads straight into the key array.
+ *
+ * binary   - native int64_t keys, anything that is not text.
+ *
+ * path "-" reads text or binary keys from stdin as they arrive. Keys are kept
+ * in file order, duplicates included.
+ *
+ * @param path    key file path or "-".
+ * @param threads threads parsing a text file, at least 1.
+ * @param keys    key set to fill.
+ * @return
+ * SUCCESS          - keys and count are set.
+ *
+ * IO_FAILURE       - failed to open, map or read path.
+ *
+ * MALLOC_FAILURE   - failed to allocate the parsed keys.
+ *
+ * INVALID_KEY_FILE - a text line is not an int64_t or a binary file is not a
+ *  whole number of keys.
+ *
+ * INVALID_SNAPSHOT - a snapshot failed validation, see bst_snapshot_map().
+ */
+BST_ERROR bst_keys_load(const char *path, size_t threads, bst_keys_t *keys);
+
+/**
+ * Releases a key set loaded by bst_keys_load().
+ *
+ * @param keys the key set.
+ */
+void bst_keys_free(bst_keys_t *keys);
+#endif // BST_KEYS_H_
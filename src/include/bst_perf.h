@@ -0,0 +1,104 @@
+/*
+Universidade Aberta
+File: bst_perf.h
+Author: Hugo Gonçalves, 2100562
+
+Per thread performance counters
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_PERF_H_
+#define BST_PERF_H_
+#include <stdint.h>
+
+#include "bst_common.h"
+
+/**
+ * Counters of bst_perf_t. The hardware ones need a PMU the process may use,
+ * which containers and virtual machines often do not have, the software ones
+ * are counted by the kernel and only need perf_event_open() itself.
+ */
+enum bst_perf_counter {
+    BST_PERF_CYCLES,
+    BST_PERF_INSTRUCTIONS,
+    BST_PERF_L1D_MISSES,
+    BST_PERF_LLC_MISSES,
+    BST_PERF_BRANCH_MISSES,
+    BST_PERF_TASK_CLOCK, // nanoseconds on a CPU
+    BST_PERF_CONTEXT_SWITCHES,
+    BST_PERF_PAGE_FAULTS,
+    BST_PERF_COUNTERS,
+};
+
+/**
+ * Counters of the thread that opened them, stopped between measurements.
+ */
+typedef struct bst_perf {
+    int fd[BST_PERF_COUNTERS]; // -1 for counters that failed to open
+    uint64_t value[BST_PERF_COUNTERS];
+} bst_perf_t;
+
+// Prototypes
+/**
+ * Opens the counters of the calling thread, stopped. Each counter is opened
+ * on its own so missing hardware counters leave the software ones. Kernel
+ * time is counted when perf_event_paranoid allows it.
+ *
+ * @param perf counters to open, closed with bst_perf_close().
+ * @return
+ * SUCCESS    - at least one counter is open.
+ *
+ * IO_FAILURE - no counter could be opened, perf is closed.
+ */
+BST_ERROR bst_perf_open(bst_perf_t *perf);
+
+/**
+ * Zeroes and starts the open counters.
+ *
+ * @param perf the counters.
+ */
+void bst_perf_start(bst_perf_t *perf);
+
+/**
+ * Stops the open counters and reads them into value. Counters the kernel
+ * multiplexed on the PMU are scaled to the time they were enabled.
+ *
+ * @param perf the counters.
+ */
+void bst_perf_stop(bst_perf_t *perf);
+
+/**
+ * @param perf    the counters.
+ * @param counter one of enum bst_perf_counter.
+ * @return 1 when counter is open, 0 otherwise
+ */
+int bst_perf_available(const bst_perf_t *perf, int counter);
+
+/**
+ * Closes the counters.
+ *
+ * @param perf the counters.
+ */
+void bst_perf_close(bst_perf_t *perf);
+#endif // BST_PERF_H_
@@ -0,0 +1,197 @@
+/*
+Universidade Aberta
+File: bst_pool.h
+Author: Hugo Gonçalves, 2100562
+
+Contiguous node pool addressed by 32-bit indices
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_POOL_H_
+#define BST_POOL_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bst_common.h"
+
+/**
+ * Null node index, index 0 is never handed out by the pool.
+ */
+#define BST_POOL_NIL 0
+
+/**
+ * Bytes committed each time the pool runs out of nodes.
+ */
+#define BST_POOL_GROW_BYTES (2u << 20)
+
+#define BST_POOL_MAGIC "BSTPOOL"
+#define BST_POOL_JOURNAL_MAGIC "BSTJRNL"
+#define BST_POOL_VERSION 1
+
+/**
+ * File offset of the node array in a file backed pool, the header sits in
+ * front of it. Large enough to keep the node array page aligned with 64 KB
+ * pages.
+ */
+#define BST_POOL_HEADER_BYTES 65536
+
+/**
+ * Header of a file backed pool, the tree as of the last checkpoint. root and
+ * count belong to the BST, next and free to the pool. checksum is FNV-1a over
+ * the words before it.
+ */
+typedef struct bst_pool_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_size;
+    uint64_t epoch;
+    uint64_t count;
+    uint32_t root;
+    uint32_t next;
+    uint32_t free;
+    uint32_t reserved;
+    uint64_t checksum;
+} bst_pool_header_t;
+
+/**
+ * Checkpoint journal header. Followed by entries, each a file offset and a
+ * length as two uint64_t and then length bytes, bytes is the size of all
+ * entries and checksum is FNV-1a over their words.
+ */
+typedef struct bst_pool_journal_header {
+    char magic[8];
+    uint64_t epoch;
+    uint64_t bytes;
+    uint64_t checksum;
+} bst_pool_journal_header_t;
+
+/**
+ * Contiguous node array addressed by 32-bit indices. The whole index space is
+ * reserved up front and committed in BST_POOL_GROW_BYTES steps, so nodes
+ * never move and pointers to them stay valid until the pool is destroyed.
+ * The reservation comes from bst_arena_reserve() so it follows the arena
+ * mode, each growth step is one huge page in BST_ARENA_HUGEPAGES mode.
+ *
+ * A file backed pool maps the node array of its file MAP_PRIVATE, writes
+ * stay in copy-on-write pages and the file keeps the tree of the last
+ * checkpoint (the shadow root in the header). A checkpoint first writes the
+ * pages changed since the last one and the next header to a journal next to
+ * the file, syncs it and only then copies them into the file, so a crash at
+ * any point leaves either the previous or the next epoch after recovery.
+ *
+ * Not thread safe, callers serialize allocations.
+ */
+typedef struct bst_pool {
+    char *base;
+    size_t node_size;
+    size_t reserved;  // bytes of address space reserved
+    size_t committed; // bytes with read/write access
+    uint32_t next;    // next never allocated index
+    uint32_t free;    // head of the released nodes list
+    int fd;           // backing file, -1 for anonymous memory
+    uint64_t epoch;   // last checkpoint of a file backed pool
+    char *journal;    // checkpoint journal path
+} bst_pool_t;
+
+// Prototypes
+/**
+ * Reserves the address space for up to UINT32_MAX nodes of node_size bytes,
+ * halving the reservation until the kernel accepts it.
+ *
+ * @param pool      pool to initialize.
+ * @param node_size size of each node, at least sizeof(uint32_t).
+ * @return
+ * SUCCESS        - pool ready.
+ *
+ * MALLOC_FAILURE - no address space could be reserved.
+ */
+BST_ERROR bst_pool_init(bst_pool_t *pool, size_t node_size);
+
+/**
+ * Allocates a node, reusing released nodes first.
+ *
+ * @param pool the pool to allocate from.
+ * @return the node index or BST_POOL_NIL if the pool is exhausted.
+ */
+uint32_t bst_pool_alloc(bst_pool_t *pool);
+
+/**
+ * Returns a node to the pool.
+ *
+ * @param pool the pool the node was allocated from.
+ * @param ref  the node index.
+ */
+void bst_pool_release(bst_pool_t *pool, uint32_t ref);
+
+/**
+ * Opens the file backed pool at path, creating an empty one if the file does
+ * not exist. A complete journal left by a crash during a checkpoint is applied
+ * first. The nodes are mapped and usable at once, nothing is read up front.
+ *
+ * @param pool      pool to initialize.
+ * @param node_size size of each node, must match the file.
+ * @param path      the pool file path.
+ * @param root      set to the root index of the last checkpoint.
+ * @param count     set to the node count of the last checkpoint.
+ * @return
+ * SUCCESS          - pool ready.
+ *
+ * MALLOC_FAILURE   - no address space could be reserved.
+ *
+ * IO_FAILURE       - failed to open, recover or map the file.
+ *
+ * INVALID_SNAPSHOT - not a pool file, unsupported version, other node size or
+ *  corrupt header.
+ */
+BST_ERROR bst_pool_open(bst_pool_t *pool, size_t node_size, const char *path,
+                        uint32_t *root, uint64_t *count);
+
+/**
+ * Makes the current nodes, root and count the state bst_pool_open() returns
+ * after a restart or crash. Only the pages written since the last checkpoint
+ * are journaled and written back, found through /proc/self/pagemap, or every
+ * page when it is unavailable.
+ *
+ * @param pool  a file backed pool.
+ * @param root  the BST root index.
+ * @param count the BST node count.
+ * @return
+ * SUCCESS        - checkpoint durable.
+ *
+ * MALLOC_FAILURE - failed to allocate the dirty page list.
+ *
+ * IO_FAILURE     - not a file backed pool, or a write or sync failed. The file
+ *  still holds the previous checkpoint.
+ */
+BST_ERROR bst_pool_checkpoint(bst_pool_t *pool, uint32_t root,
+                              uint64_t count);
+
+/**
+ * Unmaps the pool, every node is released at once. A file backed pool keeps
+ * its last checkpoint, later changes are discarded.
+ *
+ * @param pool the pool to destroy.
+ */
+void bst_pool_destroy(bst_pool_t *pool);
+#endif // BST_POOL_H_
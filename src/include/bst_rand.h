@@ -0,0 +1,83 @@
+/*
+Universidade Aberta
+File: bst_rand.h
+Author: Hugo Gonçalves, 2100562
+
+Per thread xoshiro256** random number streams
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_RAND_H_
+#define BST_RAND_H_
+#include <stdint.h>
+
+/**
+ * xoshiro256** generator (Blackman and Vigna), 256 bits of state with a
+ * period of 2^256 - 1. Not thread safe, give every thread its own stream:
+ * copies of one generator each advanced by bst_rand_jump() never overlap
+ * for 2^128 numbers.
+ */
+typedef struct bst_rand {
+    uint64_t s[4];
+} bst_rand_t;
+
+// Prototypes
+/**
+ * Seeds a generator, the state is filled by splitmix64 so any seed,
+ * including 0, gives a well mixed state.
+ *
+ * @param rng  the generator.
+ * @param seed the seed.
+ */
+void bst_rand_seed(bst_rand_t *rng, uint64_t seed);
+
+/**
+ * Advances a generator by 2^128 numbers, the start of the next stream.
+ *
+ * @param rng the generator.
+ */
+void bst_rand_jump(bst_rand_t *rng);
+
+/**
+ * @param rng the generator.
+ * @return the next 64 random bits.
+ */
+uint64_t bst_rand_next(bst_rand_t *rng);
+
+/**
+ * Random number below n by multiply and shift (Lemire), without the modulo
+ * of rand() % n. The bias is below n / 2^64.
+ *
+ * @param rng the generator.
+ * @param n   the bound, at least 1.
+ * @return number from 0 to n - 1
+ */
+uint64_t bst_rand_below(bst_rand_t *rng, uint64_t n);
+
+/**
+ * @param rng the generator.
+ * @return uniform double in [0, 1) with 53 random bits.
+ */
+double bst_rand_double(bst_rand_t *rng);
+#endif // BST_RAND_H_
@@ -0,0 +1,144 @@
+/*
+Universidade Aberta
+File: bst_result.h
+Author: Hugo Gonçalves, 2100562
+
+Test results as CSV and JSON lines
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_RESULT_H_
+#define BST_RESULT_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bst_common.h"
+
+/**
+ * How a field is written to JSON, every field is a plain CSV column.
+ *
+ * BST_RESULT_NUMBER - a JSON number, null when empty or not finite.
+ *
+ * BST_RESULT_TEXT   - a JSON string.
+ *
+ * BST_RESULT_LIST   - numbers separated by ; in CSV, a JSON array.
+ */
+enum bst_result_kind {
+    BST_RESULT_NUMBER,
+    BST_RESULT_TEXT,
+    BST_RESULT_LIST,
+};
+
+typedef struct bst_result_field {
+    char *name;
+    char *value; // formatted as in the CSV, empty when not measured
+    int kind;    // enum bst_result_kind
+} bst_result_field_t;
+
+/**
+ * Named fields of one test result, in column order. Zero initialized it is
+ * empty.
+ */
+typedef struct bst_result {
+    bst_result_field_t *fields;
+    size_t count;
+    size_t capacity;
+} bst_result_t;
+
+// Prototypes
+/**
+ * Appends a field formatted by printf.
+ *
+ * @param result the result.
+ * @param kind   one of enum bst_result_kind.
+ * @param name   the JSON name.
+ * @param format printf format of the value, "" for a field not measured.
+ * @return
+ * SUCCESS        - the field is appended.
+ *
+ * MALLOC_FAILURE - failed to allocate the field.
+ */
+BST_ERROR bst_result_add(bst_result_t *result, int kind, const char *name,
+                         const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/**
+ * Appends copies of every field of another result.
+ *
+ * @param result the result.
+ * @param other  fields to append.
+ * @return
+ * SUCCESS        - the fields are appended.
+ *
+ * MALLOC_FAILURE - failed to allocate a field.
+ */
+BST_ERROR bst_result_extend(bst_result_t *result, const bst_result_t *other);
+
+/**
+ * @param result the result.
+ * @param name   the JSON name.
+ * @return the value of the first field named name, NULL when there is none
+ */
+const char *bst_result_get(const bst_result_t *result, const char *name);
+
+/**
+ * Writes the values separated by commas and a newline.
+ *
+ * @param result the result.
+ * @param out    the stream.
+ */
+void bst_result_write_csv(const bst_result_t *result, FILE *out);
+
+/**
+ * Writes the result as one JSON object on a line of its own.
+ *
+ * @param result the result.
+ * @param out    the stream.
+ */
+void bst_result_write_json(const bst_result_t *result, FILE *out);
+
+/**
+ * Reads a line written by bst_result_write_json() into an empty result.
+ * Strings become BST_RESULT_TEXT fields, arrays BST_RESULT_LIST fields and
+ * numbers, booleans and null BST_RESULT_NUMBER fields, null ones empty.
+ *
+ * @param line   the JSON object.
+ * @param result empty result to fill, freed with bst_result_free().
+ * @return
+ * SUCCESS        - the fields are read.
+ *
+ * MALLOC_FAILURE - failed to allocate a field.
+ *
+ * INVALID_RESULT - line is not a flat JSON object.
+ */
+BST_ERROR bst_result_parse_json(const char *line, bst_result_t *result);
+
+/**
+ * Frees the fields, the result is empty afterwards.
+ *
+ * @param result the result.
+ */
+void bst_result_free(bst_result_t *result);
+#endif // BST_RESULT_H_
@@ -0,0 +1,353 @@
+/*
+Universidade Aberta
+File: bst_snapshot.h
+Author: Hugo Gonçalves, 2100562
+
+Binary BST snapshot format
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_SNAPSHOT_H_
+#define BST_SNAPSHOT_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "bst_common.h"
+
+#define BST_SNAPSHOT_MAGIC "BSTSNAP"
+#define BST_SNAPSHOT_PACKED_MAGIC "BSTSNPZ"
+#define BST_SNAPSHOT_VERSION 1
+
+// Keys per compressed block, each block is decoded on its own
+#define BST_SNAPSHOT_BLOCK_KEYS 128
+
+// Zero bytes after the last block, decoding reads whole words past a block
+#define BST_SNAPSHOT_PACKED_PAD 16
+
+/**
+ * Snapshot encodings, chosen for every BST type when a snapshot is saved.
+ *
+ * BST_SNAPSHOT_RAW    - the keys as an int64_t array.
+ *
+ * BST_SNAPSHOT_PACKED - the keys in blocks of BST_SNAPSHOT_BLOCK_KEYS, each
+ *  block stores the gaps between consecutive keys bit-packed at the width of
+ *  its largest gap. Dense key sets shrink to a few bits per key.
+ */
+typedef enum bst_snapshot_format {
+    BST_SNAPSHOT_RAW = 0,
+    BST_SNAPSHOT_PACKED,
+} bst_snapshot_format_t;
+
+/**
+ * Snapshot file header, followed by count int64_t keys in ascending order in
+ * native byte order. The balanced layout is implied by the order, the middle
+ * key of any range is the root of the subtree holding that range, so a tree is
+ * rebuilt from it without a single comparison.
+ *
+ * checksum is FNV-1a over the 64-bit keys.
+ */
+typedef struct bst_snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t key_size;
+    uint64_t count;
+    uint64_t checksum;
+} bst_snapshot_header_t;
+
+/**
+ * Compressed snapshot file header. The blocks follow it, then
+ * BST_SNAPSHOT_PACKED_PAD zero bytes and, at index_offset, one
+ * bst_snapshot_block_t per block. A block of n keys holds the n - 1 gaps
+ * key[i] - key[i - 1] - 1 as width bit little endian fields.
+ *
+ * checksum is FNV-1a over the 64-bit keys, as in the raw format.
+ */
+typedef struct bst_snapshot_packed_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_keys;
+    uint64_t count;
+    uint64_t blocks;
+    uint64_t index_offset;
+    uint64_t checksum;
+} bst_snapshot_packed_header_t;
+
+/**
+ * Sparse block index entry, the first key of a block is stored here so a
+ * lookup decodes a single block.
+ */
+typedef struct bst_snapshot_block {
+    int64_t first;
+    uint64_t offset;
+    uint32_t width;
+    uint32_t reserved;
+} bst_snapshot_block_t;
+
+/**
+ * Streaming snapshot writer, keys are appended in ascending order and the
+ * header is written on close.
+ */
+typedef struct bst_snapshot_writer {
+    int fd;
+    char *tmp_path;
+    const char *path;
+    int64_t *buffer;
+    size_t buffered;
+    uint64_t count;
+    uint64_t checksum;
+    int failed;
+    bst_snapshot_format_t format;
+    uint8_t *packed;             // encoded blocks of one buffer
+    bst_snapshot_block_t *index; // block index, written on close
+    size_t blocks;
+    size_t index_capacity;
+    uint64_t offset; // file offset of the next block
+} bst_snapshot_writer_t;
+
+/**
+ * Mapped snapshot, keys point into the read only file mapping. A compressed
+ * snapshot is decoded into decoded and the file is not kept mapped.
+ */
+typedef struct bst_snapshot {
+    void *map;
+    size_t size;
+    const int64_t *keys;
+    size_t count;
+    int64_t *decoded;
+} bst_snapshot_t;
+
+/**
+ * Mapped compressed snapshot searched in place, blocks are decoded on demand.
+ */
+typedef struct bst_snapshot_packed {
+    void *map;
+    size_t size;
+    const uint8_t *data;
+    const bst_snapshot_block_t *index;
+    size_t blocks;
+    size_t count;
+} bst_snapshot_packed_t;
+
+/**
+ * Snapshot written in the background by a forked child from its copy-on-write
+ * view of the tree. The child reports its result through pipe.
+ */
+typedef struct bst_snapshot_job {
+    pid_t pid;
+    int pipe;
+    double fork_ms;
+} bst_snapshot_job_t;
+
+/**
+ * Background snapshot costs.
+ *
+ * fork_ms     - time the caller spent in fork(), the tree is quiesced for it.
+ *
+ * duration_ms - time the child took to write and sync the snapshot.
+ *
+ * cow_kb      - memory the child ended up owning alone, mostly pages the
+ *  parent copied on write while the child ran.
+ */
+typedef struct bst_snapshot_job_stats {
+    double fork_ms;
+    double duration_ms;
+    size_t cow_kb;
+} bst_snapshot_job_stats_t;
+
+// Prototypes
+/**
+ * Sets the encoding of snapshots saved from now on by every BST type. Loading
+ * detects the encoding of each file.
+ *
+ * @param format the snapshot encoding.
+ */
+void bst_snapshot_set_format(bst_snapshot_format_t format);
+
+/**
+ * @return the encoding of new snapshots.
+ */
+bst_snapshot_format_t bst_snapshot_format(void);
+
+/**
+ * Starts writing a snapshot to path. The snapshot is written to a temporary
+ * file next to path and renamed over it on close, an existing snapshot is
+ * only replaced by a complete one.
+ *
+ * @param writer writer to initialize.
+ * @param path   snapshot file path, must stay valid until close.
+ * @return
+ * SUCCESS        - writer ready.
+ *
+ * MALLOC_FAILURE - failed to allocate the write buffers.
+ *
+ * IO_FAILURE     - failed to create the temporary file.
+ */
+BST_ERROR bst_snapshot_writer_open(bst_snapshot_writer_t *writer,
+                                   const char *path);
+
+/**
+ * Appends a key, keys must be appended in strictly ascending order.
+ *
+ * @param writer the writer.
+ * @param key    the key.
+ */
+void bst_snapshot_writer_append(bst_snapshot_writer_t *writer, int64_t key);
+
+/**
+ * Finishes the snapshot, or discards it when abort is set or a write failed.
+ *
+ * @param writer the writer.
+ * @param abort  1 to discard the snapshot.
+ * @return
+ * SUCCESS    - snapshot written, synced and renamed to path.
+ *
+ * IO_FAILURE - a write failed or abort was set, path is untouched.
+ */
+BST_ERROR bst_snapshot_writer_close(bst_snapshot_writer_t *writer, int abort);
+
+/**
+ * Maps a snapshot and validates its header, size, checksum and key order. A
+ * compressed snapshot is decoded block by block into an allocated array.
+ *
+ * @param path the snapshot file path.
+ * @param snap snapshot to fill.
+ * @return
+ * SUCCESS          - keys and count are set.
+ *
+ * IO_FAILURE       - failed to open or map the file.
+ *
+ * MALLOC_FAILURE   - failed to allocate the decoded keys.
+ *
+ * INVALID_SNAPSHOT - not a snapshot, unsupported version, truncated, checksum
+ *  mismatch or keys out of order. Nothing stays mapped.
+ */
+BST_ERROR bst_snapshot_map(const char *path, bst_snapshot_t *snap);
+
+/**
+ * Unmaps a snapshot mapped by bst_snapshot_map().
+ *
+ * @param snap the snapshot.
+ */
+void bst_snapshot_unmap(bst_snapshot_t *snap);
+
+/**
+ * Maps a compressed snapshot for read only use without decoding it. Every
+ * block is decoded once to validate the checksum and key order.
+ *
+ * @param path   the snapshot file path.
+ * @param packed view to fill.
+ * @return
+ * SUCCESS          - the view is ready.
+ *
+ * IO_FAILURE       - failed to open or map the file.
+ *
+ * INVALID_SNAPSHOT - not a compressed snapshot, or invalid as in
+ *  bst_snapshot_map(). Nothing stays mapped.
+ */
+BST_ERROR bst_snapshot_packed_map(const char *path,
+                                  bst_snapshot_packed_t *packed);
+
+/**
+ * Searches a compressed snapshot, decoding only the block that may hold the
+ * value.
+ *
+ * @param packed the view.
+ * @param value  the value to find.
+ * @return
+ * VALUE_EXISTS      - value found.
+ *
+ * VALUE_NONEXISTENT - value not found.
+ *
+ * BST_EMPTY         - the snapshot has no keys.
+ */
+BST_ERROR bst_snapshot_packed_search(const bst_snapshot_packed_t *packed,
+                                     int64_t value);
+
+/**
+ * Finds the smallest key of a compressed snapshot.
+ *
+ * @param packed the view.
+ * @param value  pointer where the key is stored.
+ * @return
+ * SUCCESS   - key found.
+ *
+ * BST_EMPTY - the snapshot has no keys.
+ */
+BST_ERROR bst_snapshot_packed_min(const bst_snapshot_packed_t *packed,
+                                  int64_t *value);
+
+/**
+ * Finds the largest key of a compressed snapshot, decoding the last block.
+ *
+ * @param packed the view.
+ * @param value  pointer where the key is stored.
+ * @return
+ * SUCCESS   - key found.
+ *
+ * BST_EMPTY - the snapshot has no keys.
+ */
+BST_ERROR bst_snapshot_packed_max(const bst_snapshot_packed_t *packed,
+                                  int64_t *value);
+
+/**
+ * Unmaps a view mapped by bst_snapshot_packed_map().
+ *
+ * @param packed the view.
+ */
+void bst_snapshot_packed_unmap(bst_snapshot_packed_t *packed);
+
+/**
+ * Forks a child that writes a snapshot to path with save(ctx, writer) and
+ * exits. The caller must keep the tree unchanged until this returns, after
+ * that the child works on its copy-on-write view and the tree may change.
+ *
+ * @param job  job to start.
+ * @param path snapshot file path.
+ * @param save appends every key in order, returns 0 on failure. Runs in the
+ *  child with a single thread, it must not take locks.
+ * @param ctx  save context, usually the BST.
+ * @return
+ * SUCCESS        - the child is running, bst_snapshot_job_wait() reaps it.
+ *
+ * IO_FAILURE     - failed to create the result pipe.
+ *
+ * MALLOC_FAILURE - fork() failed, out of memory or processes.
+ */
+BST_ERROR bst_snapshot_fork(bst_snapshot_job_t *job, const char *path,
+                            int (*save)(void *, bst_snapshot_writer_t *),
+                            void *ctx);
+
+/**
+ * Waits for a background snapshot to finish.
+ *
+ * @param job   the job.
+ * @param stats costs of the snapshot, may be NULL.
+ * @return
+ * The result of writing the snapshot in the child, as bst_*_save(), or
+ * UNKNOWN when the child died without reporting one.
+ */
+BST_ERROR bst_snapshot_job_wait(bst_snapshot_job_t *job,
+                                bst_snapshot_job_stats_t *stats);
+#endif // BST_SNAPSHOT_H_
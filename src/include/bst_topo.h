@@ -0,0 +1,139 @@
+/*
+Universidade Aberta
+File: bst_topo.h
+Author: Hugo Gonçalves, 2100562
+
+CPU topology and thread placement
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_TOPO_H_
+#define BST_TOPO_H_
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bst_common.h"
+
+// Where Linux describes the CPUs
+#define BST_TOPO_SYSFS "/sys/devices/system/cpu"
+
+/**
+ * Thread placements.
+ *
+ * BST_TOPO_COMPACT - fill a core, SMT siblings included, before the next one,
+ *  and a package before the next one.
+ *
+ * BST_TOPO_SCATTER - one thread per core, alternating between packages, SMT
+ *  siblings only once every core has a thread.
+ *
+ * BST_TOPO_LIST    - the CPUs of a list, in list order.
+ */
+enum bst_topo_placement {
+    BST_TOPO_COMPACT = 1,
+    BST_TOPO_SCATTER,
+    BST_TOPO_LIST,
+};
+
+/**
+ * A CPU the process may run on. core numbers the cores of the machine from 0,
+ * SMT siblings share it.
+ */
+typedef struct bst_topo_cpu {
+    int cpu;
+    int package;
+    int core;
+    int thread; // position among the SMT siblings of the core
+    int rank;   // position of the core in its package
+} bst_topo_cpu_t;
+
+/**
+ * CPUs both online and in the affinity mask of the process, in compact order.
+ */
+typedef struct bst_topo {
+    bst_topo_cpu_t *cpus;
+    size_t count;
+} bst_topo_t;
+
+// Prototypes
+/**
+ * Reads the CPU topology. A CPU without topology files, as in some containers,
+ * is taken as a core of its own in package 0.
+ *
+ * @param root BST_TOPO_SYSFS or a copy of it.
+ * @param topo topology to fill, released with bst_topo_free().
+ * @return
+ * SUCCESS        - cpus and count are set, count is at least 1.
+ *
+ * IO_FAILURE     - failed to read the online CPUs.
+ *
+ * MALLOC_FAILURE - failed to allocate the CPUs.
+ */
+BST_ERROR bst_topo_load(const char *root, bst_topo_t *topo);
+
+/**
+ * Chooses the CPU of each of n threads. Threads wrap around once every CPU of
+ * the placement has one.
+ *
+ * @param topo      the topology.
+ * @param placement one of enum bst_topo_placement.
+ * @param list      CPU list of BST_TOPO_LIST in the sysfs format, "0-3,8,10".
+ * @param n         the number of threads.
+ * @param cpus      n CPU numbers to fill.
+ * @return
+ * SUCCESS          - cpus is set.
+ *
+ * MALLOC_FAILURE   - failed to allocate the placement.
+ *
+ * INVALID_CPU_LIST - list is malformed or names a CPU outside the topology.
+ */
+BST_ERROR bst_topo_place(const bst_topo_t *topo, int placement,
+                         const char *list, size_t n, int *cpus);
+
+/**
+ * @param topo the topology.
+ * @param cpu  CPU number.
+ * @return the CPU in topo, NULL when it is not there.
+ */
+const bst_topo_cpu_t *bst_topo_find(const bst_topo_t *topo, int cpu);
+
+/**
+ * Pins a thread to one CPU with pthread_setaffinity_np().
+ *
+ * @param thread the thread.
+ * @param cpu    CPU number.
+ * @return
+ * SUCCESS          - the thread only runs on cpu.
+ *
+ * INVALID_CPU_LIST - cpu is out of range or the thread may not run on it.
+ */
+BST_ERROR bst_topo_pin(pthread_t thread, int cpu);
+
+/**
+ * Releases a topology read by bst_topo_load().
+ *
+ * @param topo the topology.
+ */
+void bst_topo_free(bst_topo_t *topo);
+#endif // BST_TOPO_H_
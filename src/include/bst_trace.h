@@ -0,0 +1,163 @@
+/*
+Universidade Aberta
+File: bst_trace.h
+Author: Hugo Gonçalves, 2100562
+
+Per thread operation trace ring files
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_TRACE_H_
+#define BST_TRACE_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bst_common.h"
+
+#define BST_TRACE_MAGIC "BSTTRCE"
+#define BST_TRACE_VERSION 1
+
+// Records kept per thread before the oldest are overwritten, 24 MB files
+#define BST_TRACE_DEFAULT_RECORDS (1u << 20)
+
+typedef enum bst_trace_op {
+    BST_TRACE_ADD = 1,
+    BST_TRACE_SEARCH = 2,
+    BST_TRACE_MIN = 3,
+    BST_TRACE_MAX = 4,
+    BST_TRACE_DELETE = 5,
+} bst_trace_op_t;
+
+/**
+ * One traced operation. time_ns is CLOCK_MONOTONIC, comparable between the
+ * threads of one process. key is 0 for min and max.
+ */
+typedef struct bst_trace_record {
+    uint64_t time_ns;
+    int64_t key;
+    uint32_t op;
+    uint32_t result;
+} bst_trace_record_t;
+
+/**
+ * Trace file header, followed by capacity records used as a ring. Record i
+ * is stored in slot i % capacity, so once written exceeds capacity the file
+ * holds the last capacity records.
+ */
+typedef struct bst_trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t thread;
+    uint64_t capacity;
+    uint64_t written;
+} bst_trace_header_t;
+
+/**
+ * Trace file mapped for recording or replay.
+ */
+typedef struct bst_trace {
+    void *map;
+    size_t size;
+    bst_trace_header_t *header;
+    bst_trace_record_t *records;
+    int fd; // -1 when mapped for replay
+} bst_trace_t;
+
+// Prototypes
+/**
+ * Creates a trace file, replacing any file at path. Records go straight to a
+ * shared file mapping, what was recorded survives a crash of the process.
+ *
+ * Check the bitmask of err for possible error combinations:
+ * SUCCESS        - pointer to the trace is returned.
+ *
+ * MALLOC_FAILURE - failed to allocate the trace.
+ *
+ * IO_FAILURE     - failed to create, size or map path.
+ *
+ * @param path     the trace file path.
+ * @param thread   number of the recording thread, kept in the header.
+ * @param capacity records kept before the oldest are overwritten.
+ * @param err      NULL (no effect) or allocated pointer to store any errors
+ * @return NULL or trace
+ */
+bst_trace_t *bst_trace_create(const char *path, uint32_t thread,
+                              size_t capacity, BST_ERROR *err);
+
+/**
+ * Records an operation - Not thread safe, one trace per thread.
+ *
+ * @param trace  trace created by bst_trace_create().
+ * @param op     the operation.
+ * @param key    the operation key, 0 for min and max.
+ * @param result what the operation returned.
+ */
+void bst_trace_record(bst_trace_t *trace, bst_trace_op_t op, int64_t key,
+                      BST_ERROR result);
+
+/**
+ * Maps a trace file read only for replay.
+ *
+ * Check the bitmask of err for possible error combinations:
+ * SUCCESS        - pointer to the trace is returned.
+ *
+ * MALLOC_FAILURE - failed to allocate the trace.
+ *
+ * IO_FAILURE     - failed to open or map path.
+ *
+ * INVALID_TRACE  - not a trace file, unsupported version or truncated.
+ *
+ * @param path the trace file path.
+ * @param err  NULL (no effect) or allocated pointer to store any errors
+ * @return NULL or trace
+ */
+bst_trace_t *bst_trace_open(const char *path, BST_ERROR *err);
+
+/**
+ * @param trace the trace.
+ * @return the number of records held, at most its capacity.
+ */
+size_t bst_trace_count(const bst_trace_t *trace);
+
+/**
+ * @param trace the trace.
+ * @param i     record index, 0 is the oldest record held.
+ * @return the record.
+ */
+const bst_trace_record_t *bst_trace_at(const bst_trace_t *trace, size_t i);
+
+/**
+ * Closes a trace. A recorded trace that never wrapped is cut to the records
+ * written.
+ *
+ * @param trace the trace.
+ * @return
+ * SUCCESS    - trace closed.
+ *
+ * BST_NULL   - when provided trace pointer is null.
+ *
+ * IO_FAILURE - failed to cut or close a recorded trace.
+ */
+BST_ERROR bst_trace_close(bst_trace_t **trace);
+#endif // BST_TRACE_H_
@@ -0,0 +1,221 @@
+/*
+Universidade Aberta
+File: bst_wal.h
+Author: Hugo Gonçalves, 2100562
+
+Write-ahead log with group commit
+
+MIT License
+
+Copyright (c) 2024 Hugo Gonçalves
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to
+deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef BST_WAL_H_
+#define BST_WAL_H_
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bst_common.h"
+
+// Records each thread buffer holds before it first grows
+#define BST_WAL_BUFFER_RECORDS 256
+
+// Longest time in microseconds a record nobody waits on stays buffered
+#define BST_WAL_FLUSH_INTERVAL_US 1000
+
+typedef enum bst_wal_op {
+    BST_WAL_ADD = 1,
+    BST_WAL_DELETE = 2,
+} bst_wal_op_t;
+
+/**
+ * Log record, the log file is a plain sequence of them in native byte order.
+ * Records of one group commit are not sorted by seq, replay sorts them.
+ *
+ * check is FNV-1a over seq, value and op folded to 32 bits, a torn or zero
+ * filled tail after a crash fails it and ends the log.
+ */
+typedef struct bst_wal_record {
+    uint64_t seq;
+    int64_t value;
+    uint32_t op;
+    uint32_t check;
+} bst_wal_record_t;
+
+/**
+ * Per thread record buffer. Owned by one appending thread, drained by the log
+ * writer, both under mtx.
+ */
+typedef struct bst_wal_buffer {
+    pthread_mutex_t mtx;
+    bst_wal_record_t *records;
+    size_t count;
+    size_t capacity;
+    atomic_int state;
+    struct bst_wal *wal;
+    struct bst_wal_buffer *next;
+} bst_wal_buffer_t;
+
+typedef struct bst_wal {
+    int fd;
+    pthread_t writer;
+
+    // Next sequence number, taken under the appending thread buffer lock
+    _Atomic uint64_t next_seq;
+    _Atomic(bst_wal_buffer_t *) buffers;
+
+    // Guards everything below, commit waiters sleep on durable_cond and the
+    // log writer on work_cond
+    pthread_mutex_t mtx;
+    pthread_cond_t work_cond;
+    pthread_cond_t durable_cond;
+    uint64_t durable;
+    uint64_t requested;
+    int stop;
+    int failed;
+
+    // Group commit statistics
+    uint64_t records;
+    uint64_t commits;
+    uint64_t max_batch;
+    uint64_t bytes;
+
+    // Log writer batch, only touched by the log writer
+    bst_wal_record_t *batch;
+    size_t batch_capacity;
+} bst_wal_t;
+
+typedef struct bst_wal_stats {
+    // Records made durable
+    uint64_t records;
+
+    // Group commits, one write and one fdatasync each
+    uint64_t commits;
+
+    // Most records made durable by a single commit
+    uint64_t max_batch;
+
+    // Bytes written to the log
+    uint64_t bytes;
+} bst_wal_stats_t;
+
+// Prototypes
+/**
+ * Opens or creates the log at path and starts its log writer thread. An
+ * existing log is kept, a torn tail left by a crash is cut off and sequence
+ * numbers continue after its last record.
+ *
+ * @param path the log file path.
+ * @param err  SUCCESS, MALLOC_FAILURE, IO_FAILURE, or UNKNOWN if the log
+ *  writer thread failed to start. Ignored if NULL.
+ * @return the log or NULL on failure.
+ */
+bst_wal_t *bst_wal_open(const char *path, BST_ERROR *err);
+
+/**
+ * Appends a record to the calling thread buffer without waiting for it. The
+ * log writer makes it durable with the next group commit.
+ *
+ * @param wal   the log.
+ * @param op    BST_WAL_ADD or BST_WAL_DELETE.
+ * @param value the added or deleted value.
+ * @param seq   set to the record sequence number, pass it to bst_wal_wait().
+ * @return
+ * SUCCESS        - record buffered.
+ *
+ * MALLOC_FAILURE - failed to grow the thread buffer.
+ */
+BST_ERROR bst_wal_append(bst_wal_t *wal, bst_wal_op_t op, int64_t value,
+                         uint64_t *seq);
+
+/**
+ * Waits until seq and every record before it are durable. Threads waiting at
+ * the same time share one write and one fdatasync.
+ *
+ * @param wal the log.
+ * @param seq a sequence number returned by bst_wal_append().
+ * @return
+ * SUCCESS    - seq is on disk.
+ *
+ * IO_FAILURE - a log write or sync failed, the log accepts no more commits.
+ */
+BST_ERROR bst_wal_wait(bst_wal_t *wal, uint64_t seq);
+
+/**
+ * Appends a record and waits until it is durable.
+ *
+ * @param wal   the log.
+ * @param op    BST_WAL_ADD or BST_WAL_DELETE.
+ * @param value the added or deleted value.
+ * @return SUCCESS, MALLOC_FAILURE or IO_FAILURE, see bst_wal_append() and
+ *  bst_wal_wait().
+ */
+BST_ERROR bst_wal_commit(bst_wal_t *wal, bst_wal_op_t op, int64_t value);
+
+/**
+ * Replays the log at path in sequence order through apply.
+ *
+ * To recover a BST load the last snapshot and replay the whole log on top of
+ * it. Adds and deletes are idempotent and the last record for a value decides
+ * whether it is in the tree, so records the snapshot already holds are
+ * harmless. The log must only be truncated when a snapshot holds every record
+ * in it.
+ *
+ * @param path     the log file path.
+ * @param apply    called once per record with ctx, VALUE_EXISTS and
+ *  VALUE_NONEXISTENT results are expected and ignored.
+ * @param ctx      passed to apply, usually the address of the BST pointer.
+ * @param replayed set to the number of replayed records. Ignored if NULL.
+ * @return
+ * SUCCESS        - log replayed, a missing log replays nothing.
+ *
+ * MALLOC_FAILURE - failed to allocate the replay buffer or apply returned
+ *  MALLOC_FAILURE.
+ *
+ * IO_FAILURE     - failed to read the log.
+ */
+BST_ERROR bst_wal_replay(const char *path,
+                         BST_ERROR (*apply)(void *ctx, bst_wal_op_t op,
+                                            int64_t value),
+                         void *ctx, size_t *replayed);
+
+/**
+ * Gets the group commit statistics.
+ *
+ * @param wal   the log.
+ * @param stats statistics to fill.
+ */
+void bst_wal_stats(bst_wal_t *wal, bst_wal_stats_t *stats);
+
+/**
+ * Commits every buffered record, stops the log writer and closes the log.
+ * Threads must not append while it runs.
+ *
+ * @param wal the log, set to NULL.
+ * @return
+ * SUCCESS    - every record is durable.
+ *
+ * IO_FAILURE - the last commit or closing the log failed.
+ */
+BST_ERROR bst_wal_close(bst_wal_t **wal);
+#endif // BST_WAL_H_
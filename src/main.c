@@ -1,20 +1,35 @@
 #include <ctype.h>
+#include <dlfcn.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "bst_at/include/bst_at.h"
 #include "bst_mt_cgl/include/bst_mt_cgl.h"
 #include "bst_mt_fgl/include/bst_mt_fgl.h"
+#include "bst_paged/include/bst_paged.h"
 #include "bst_st/include/bst_st.h"
+#include "include/bst_arena.h"
+#include "include/bst_dist.h"
+#include "include/bst_engine.h"
+#include "include/bst_hist.h"
+#include "include/bst_keys.h"
+#include "include/bst_perf.h"
+#include "include/bst_rand.h"
+#include "include/bst_result.h"
+#include "include/bst_topo.h"
+#include "include/bst_trace.h"
+#include "include/bst_wal.h"
 
 const char *usage() {
     const char *msg = "\
@@ -23,6 +38,8 @@ Usage:\n\
 \n\
 Options:\n\
 \t-n Set the number of operations\n\
+\t-f <file> Use the keys in file instead of 0..n-1 shuffled, - reads stdin. Text with one key per line, native int64\n\
+\t\tbinary or a snapshot. -n defaults to the number of keys and may not exceed it.\n\
 \t-o Set write probability over read operations. Ex 60 for 60% inserts\n\
 \t\tThis option is ignored for insert, write and read strategies.\n\
 \t-t Set the number of threads, operations are evenly distributed. Ignored for BST ST type.\n\
@@ -33,15 +50,62 @@ Options:\n\
 \t\twriteb     - Random inserts, deletes and rebalance with random generated numbers\n\
 \t\tread       - Random search, min, max, height and width. -o sets the number of elements in the read.\n\
 \t\tread_write - Random inserts, deletes, search, min, max, height and width with random generated numbers.\n\
+\t\treplay     - Replays the traces of option -T, one thread per trace. ST replays them merged by time.\n\
+\t\tycsb_a     - YCSB workload A, 50% searches, 50% updates, zipfian keys. Half the keys are loaded first.\n\
+\t\tycsb_b     - YCSB workload B, 95% searches, 5% updates, zipfian keys.\n\
+\t\tycsb_c     - YCSB workload C, searches only, zipfian keys.\n\
+\t\tycsb_d     - YCSB workload D, 95% searches, 5% inserts, latest keys.\n\
+\t\tycsb_e     - YCSB workload E, 95% scans of up to 100 consecutive keys, 5% inserts, zipfian keys.\n\
+\t\tycsb_f     - YCSB workload F, 50% searches, 50% read-modify-writes, zipfian keys.\n\
 \t-a Set the BST type to Atomic, can be set with -c, -g and -l to test multiple BST types\n\
 \t-c Set the BST type to ST, can be set with -a, -g and -l to test multiple BST types\n\
 \t-g Set the BST type to MT Coarse-Grained Lock, can be set with -a, -c and -l to test multiple BST types\n\
 \t-l Set the BST type to MT Fine-Grained Lock, can be set with -a, -c and -g to test multiple BST types\n\
+\t-p Set the BST type to the disk resident paged B+tree, can be set with the other types\n\
+\t-E <engine.so> Test the BST engine a shared object exports as bst_engine, see include/bst_engine.h. Can be set\n\
+\t\tmore than once and with the built-in BST types\n\
+\t-b <frames> Set the paged tree buffer pool capacity in 4 KB pages, default 1024\n\
+\t-i Print the node size and node lock of each BST type and exit\n\
+\t-H Allocate tree nodes from 2 MB aligned arenas advised to use transparent huge pages\n\
+\t-w <path> Commit every successful add and delete to a write-ahead log at path before counting it.\n\
+\t\tThe log is recreated for each run and replayed into a new BST afterwards to check recovery.\n\
+\t-C <path> Write a background snapshot to path halfway through each ST and CGL run from a forked child\n\
+\t-R <dir> Record the operations of each thread to dir/thread-<n>.trace, each run replaces the last one\n\
+\t-T <dir> Read the traces of strategy replay from dir/thread-<n>.trace\n\
+\t-P Replay with the recorded pacing between operations instead of back to back\n\
+\t-L <path> Write the full latency histogram of each operation type of each run to path\n\
+\t-D <seconds> Run each test for seconds instead of until -n operations are done, sampling the throughput\n\
+\t\tevery 100 ms. -n still sets the keys each thread uses.\n\
+\t-S <seed> Seed of the key shuffle and of the random streams of the test threads, default from the clock\n\
+\t-A <placement> Pin each test thread to a CPU: compact fills the SMT siblings of a core first, scatter uses one\n\
+\t\tthread per core before any sibling and list:<cpus> takes the CPUs in order, example list:0-3,8\n\
+\t-e Count cycles, instructions, cache and branch misses, context switches and page faults of every test thread\n\
+\t\twith perf_event_open, only the software events when there is no hardware PMU\n\
+\t-j <path> Also write the results to path as JSON lines, with the build, the machine and the command line\n\
+\t-d <dist> Key distribution of searches and deletes: uniform (default), zipf[:<theta>], hotspot:<frac>:<prob>\n\
+\t\tor latest[:<theta>]. theta defaults to 0.99.\n\
     \n";
 
     return msg;
 }
 
+// Build of the -j results, set by CMake
+#ifndef BST_GIT_HASH
+#define BST_GIT_HASH ""
+#endif
+
+#ifndef BST_COMPILER
+#define BST_COMPILER __VERSION__
+#endif
+
+#ifndef BST_C_FLAGS
+#define BST_C_FLAGS ""
+#endif
+
+#ifndef BST_BUILD_TYPE
+#define BST_BUILD_TYPE ""
+#endif
+
 // Robert Jenkins' 96 bit Mix Function
 // https://web.archive.org/web/20070111091013/http://www.concentric.net/~Ttwang/tech/inthash.htm
 uint64_t mix(uint64_t a, uint64_t b, uint64_t c) {
@@ -85,11 +149,9 @@ void swap(int64_t *a, int64_t *b) {
 
 // https://en.wikipedia.org/wiki/Fisher%E2%80%93Yates_shuffle
 // shuffle an array of signed long integers
-void fisher_yates_shuffle(const size_t n, int64_t *a) {
-    srand(mix(clock(), time(NULL), getpid()));
-
+void fisher_yates_shuffle(const size_t n, int64_t *a, bst_rand_t *rng) {
     for (size_t i = n - 1; i > 0; i--) {
-        const size_t j = rand() % i;
+        const size_t j = bst_rand_below(rng, i + 1);
 
         swap(&a[j], &a[i]);
     }
@@ -120,13 +182,121 @@ str2int_errno str2int(int64_t *out, const char *s) {
     return STR2LLINT_SUCCESS;
 }
 
+// Parses -d uniform|zipf[:<theta>]|hotspot:<frac>:<prob>|latest[:<theta>],
+// returns 0 for an invalid spec
+int parse_dist(bst_dist_t *dist, const char *s) {
+    char *end;
+
+    if (strcmp(s, "uniform") == 0) {
+        bst_dist_init(dist, BST_DIST_UNIFORM, BST_DIST_DEFAULT_THETA, 0, 0);
+        return 1;
+    }
+
+    if (strncmp(s, "zipf", 4) == 0 || strncmp(s, "latest", 6) == 0) {
+        const bst_dist_kind_t kind =
+            s[0] == 'z' ? BST_DIST_ZIPF : BST_DIST_LATEST;
+        const char *p = s + (kind == BST_DIST_ZIPF ? 4 : 6);
+        double theta = BST_DIST_DEFAULT_THETA;
+
+        if (*p == ':') {
+            errno = 0;
+            theta = strtod(p + 1, &end);
+            if (errno != 0 || end == p + 1 || *end != '\0' || !(theta > 0)) {
+                return 0;
+            }
+        } else if (*p != '\0') {
+            return 0;
+        }
+
+        bst_dist_init(dist, kind, theta, 0, 0);
+        return 1;
+    }
+
+    if (strncmp(s, "hotspot:", 8) == 0) {
+        errno = 0;
+        const double frac = strtod(s + 8, &end);
+        if (errno != 0 || end == s + 8 || *end != ':' || !(frac > 0) ||
+            frac > 1) {
+            return 0;
+        }
+
+        const char *p = end + 1;
+        const double prob = strtod(p, &end);
+        if (errno != 0 || end == p || *end != '\0' || !(prob >= 0) ||
+            prob > 1) {
+            return 0;
+        }
+
+        bst_dist_init(dist, BST_DIST_HOTSPOT, BST_DIST_DEFAULT_THETA, frac,
+                      prob);
+        return 1;
+    }
+
+    return 0;
+}
+
 enum bst_type {
     ST = (1u << 1),
     CGL = (1u << 2),
     FGL = (1u << 3),
     AT = (1u << 4),
+    PAGED = (1u << 5),
+};
+
+// The engines linked into the harness and the type selecting each one
+const struct {
+    enum bst_type type;
+    const bst_engine_ops *engine;
+} builtin_engines[] = {
+    {ST, &bst_st_engine},
+    {CGL, &bst_mt_cgl_engine},
+    {FGL, &bst_mt_fgl_engine},
+    {AT, &bst_at_engine},
+    {PAGED, &bst_paged_engine},
 };
 
+#define BUILTIN_ENGINES (sizeof builtin_engines / sizeof builtin_engines[0])
+
+// Prints <bst_type>,<node_size>,<node_lock> for each BST engine, the built-in
+// ones and then the -E plugins
+void print_build_info(const bst_engine_ops **plugins, const size_t count) {
+    for (size_t i = 0; i < BUILTIN_ENGINES + count; i++) {
+        const bst_engine_ops *e = i < BUILTIN_ENGINES
+                                      ? builtin_engines[i].engine
+                                      : plugins[i - BUILTIN_ENGINES];
+
+        printf("%s,%zu,%s\n", e->name, e->node_size, e->node_lock);
+    }
+}
+
+// Loads the engine a -E shared object exports, the object stays loaded until
+// the process exits
+const bst_engine_ops *load_engine(const char *path) {
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "%s\n", dlerror());
+        PANIC("Failed to load the engine of option -E");
+    }
+
+    const bst_engine_ops *e = dlsym(handle, BST_ENGINE_SYMBOL);
+    if (e == NULL) {
+        PANIC("The engine of option -E does not export " BST_ENGINE_SYMBOL);
+    }
+
+    if (e->abi_version != BST_ENGINE_ABI_VERSION) {
+        PANIC("The engine of option -E was built for another bst_engine.h");
+    }
+
+    if (e->name == NULL || e->node_lock == NULL || e->new == NULL ||
+        e->free == NULL || e->add == NULL || e->search == NULL ||
+        e->min == NULL || e->max == NULL || e->delete == NULL ||
+        e->count == NULL || e->stats == NULL) {
+        PANIC("The engine of option -E is missing an operation");
+    }
+
+    return e;
+}
+
 enum test_strat {
     // Insert only
     INSERT = (1u << 1),
@@ -139,8 +309,61 @@ enum test_strat {
 
     // Random inserts, deletes, search, min, max, height and width
     READ_WRITE = (1u << 4),
+
+    // Recorded operations from traces
+    REPLAY = (1u << 5),
+
+    // YCSB core workloads A to F
+    YCSB_A = (1u << 6),
+    YCSB_B = (1u << 7),
+    YCSB_C = (1u << 8),
+    YCSB_D = (1u << 9),
+    YCSB_E = (1u << 10),
+    YCSB_F = (1u << 11),
 };
 
+#define YCSB_PRESETS (YCSB_A | YCSB_B | YCSB_C | YCSB_D | YCSB_E | YCSB_F)
+
+// YCSB's default maxscanlength
+#define YCSB_MAX_SCAN 100
+
+/**
+ * YCSB core workload, mapped onto this API. An update adds a key that is
+ * already in the tree, a scan searches up to YCSB_MAX_SCAN consecutive keys
+ * from a picked key and a read-modify-write searches a key then updates it.
+ * The shares of the operations add up to 1.
+ */
+typedef struct ycsb_mix {
+    enum test_strat strat;
+    const char *name;
+    double read;
+    double update;
+    double insert;
+    double scan;
+    double rmw;
+    bst_dist_kind_t dist;
+    const char *dist_name;
+} ycsb_mix;
+
+const ycsb_mix ycsb_mixes[] = {
+    {YCSB_A, "YCSB_A", 0.5, 0.5, 0, 0, 0, BST_DIST_ZIPF, "zipf"},
+    {YCSB_B, "YCSB_B", 0.95, 0.05, 0, 0, 0, BST_DIST_ZIPF, "zipf"},
+    {YCSB_C, "YCSB_C", 1, 0, 0, 0, 0, BST_DIST_ZIPF, "zipf"},
+    {YCSB_D, "YCSB_D", 0.95, 0, 0.05, 0, 0, BST_DIST_LATEST, "latest"},
+    {YCSB_E, "YCSB_E", 0, 0, 0.05, 0.95, 0, BST_DIST_ZIPF, "zipf"},
+    {YCSB_F, "YCSB_F", 0.5, 0, 0, 0, 0.5, BST_DIST_ZIPF, "zipf"},
+};
+
+const ycsb_mix *ycsb_find(const enum test_strat strat) {
+    for (size_t i = 0; i < sizeof ycsb_mixes / sizeof ycsb_mixes[0]; i++) {
+        if (ycsb_mixes[i].strat == strat) {
+            return &ycsb_mixes[i];
+        }
+    }
+
+    return NULL;
+}
+
 typedef struct test_bst_metrics {
     size_t inserts;
     size_t searches;
@@ -150,6 +373,7 @@ typedef struct test_bst_metrics {
     size_t widths;
     size_t deletes;
     size_t rebalances;
+    size_t mismatches; // replayed results that differ from the trace
 } test_bst_metrics;
 
 test_bst_metrics *bst_metrics_new() {
@@ -163,55 +387,76 @@ test_bst_metrics *bst_metrics_new() {
     m->widths = 0;
     m->deletes = 0;
     m->rebalances = 0;
+    m->mismatches = 0;
 
     return m;
 }
 
+/**
+ * Operations a test thread has done, on a cache line of its own.
+ */
+typedef struct test_progress {
+    _Atomic uint64_t done;
+    char pad[64 - sizeof(uint64_t)];
+} test_progress;
+
 typedef struct test_bst_s {
     size_t operations;
     size_t start;
-    int64_t *values;
+    const int64_t *values;
+    const bst_dist_t *dist; // picks the keys searched and deleted
+    const ycsb_mix *ycsb;
+    bst_rand_t rng; // random stream of the thread, a new one every run
     test_bst_metrics *metrics;
     float write_prob;
     void *bst;
-    BST_ERROR (*add)(const void **, int64_t);
-    BST_ERROR (*search)(const void **, int64_t);
-    BST_ERROR (*min)(const void **, int64_t *);
-    BST_ERROR (*max)(const void **, int64_t *);
-    BST_ERROR (*delete)(const void **, int64_t);
+    bst_wal_t *wal;
+    const char *checkpoint_path;
+    bst_snapshot_job_t *job; // set for the thread starting the checkpoint
+    bst_trace_t *trace;      // set when recording with -R
+    bst_hist_t *hist;        // latencies, one histogram per bst_trace_op_t
+    bst_trace_t **replay;    // traces replayed by this thread
+    size_t replay_count;
+    uint64_t replay_base; // earliest recorded time of all the traces
+    int pacing;
+    uint64_t started_ns; // set by the worker as the start gate opens
+    uint64_t stopped_ns;
+    bst_perf_t perf;     // -e counters of the thread over the run
+    atomic_int *stop;        // set for -D runs, the thread runs until it is set
+    test_progress *progress; // operations done, read by the -D sampler
+    const bst_engine_ops *engine;
 } test_bst_s;
 
-void set_st_functions(test_bst_s *t) {
-    t->add = (BST_ERROR(*)(const void **, int64_t))bst_st_add;
-    t->search = (BST_ERROR(*)(const void **, int64_t))bst_st_search;
-    t->min = (BST_ERROR(*)(const void **, int64_t *))bst_st_min;
-    t->max = (BST_ERROR(*)(const void **, int64_t *))bst_st_max;
-    t->delete = (BST_ERROR(*)(const void **, int64_t))bst_st_delete;
-}
-
-void set_mt_cgl_functions(test_bst_s *t) {
-    t->add = (BST_ERROR(*)(const void **, int64_t))bst_mt_cgl_add;
-    t->search = (BST_ERROR(*)(const void **, int64_t))bst_mt_cgl_search;
-    t->min = (BST_ERROR(*)(const void **, int64_t *))bst_mt_cgl_min;
-    t->max = (BST_ERROR(*)(const void **, int64_t *))bst_mt_cgl_max;
-    t->delete = (BST_ERROR(*)(const void **, int64_t))bst_mt_cgl_delete;
-}
-
-void set_mt_fgl_functions(test_bst_s *t) {
-    t->add = (BST_ERROR(*)(const void **, int64_t))bst_mt_fgl_add;
-    t->search = (BST_ERROR(*)(const void **, int64_t))bst_mt_fgl_search;
-    t->min = (BST_ERROR(*)(const void **, int64_t *))bst_mt_fgl_min;
-    t->max = (BST_ERROR(*)(const void **, int64_t *))bst_mt_fgl_max;
-    t->delete = (BST_ERROR(*)(const void **, int64_t))bst_mt_fgl_delete;
-}
+typedef struct worker_pool worker_pool;
 
-void set_at_functions(test_bst_s *t) {
-    t->add = (BST_ERROR(*)(const void **, int64_t))bst_at_add;
-    t->search = (BST_ERROR(*)(const void **, int64_t))bst_at_search;
-    t->min = (BST_ERROR(*)(const void **, int64_t *))bst_at_min;
-    t->max = (BST_ERROR(*)(const void **, int64_t *))bst_at_max;
-    t->delete = (BST_ERROR(*)(const void **, int64_t))bst_at_delete;
-}
+/**
+ * Options shared by every test, set from the command line.
+ */
+typedef struct test_options {
+    size_t repeat;
+    float write_prob;
+    const char *wal_path;
+    size_t frames;
+    const char *checkpoint_path;
+    const char *record_dir;
+    bst_trace_t **replay;
+    size_t replay_count;
+    uint64_t replay_base;
+    int pacing;
+    FILE *hist_dump;
+    worker_pool *pool;
+    bst_dist_t dist;
+    const char *dist_name;
+    int dist_set; // -d given, replaces the distribution of the YCSB presets
+    int64_t duration; // -D seconds, 0 runs -n operations
+    uint64_t seed;
+    bst_rand_t *streams; // jumped ahead for every thread of every run
+    const bst_topo_t *topo;
+    const int *cpus; // -A CPU of each worker, NULL when not pinned
+    int perf;        // -e
+    FILE *json;      // -j results, NULL when not set
+    const bst_result_t *meta; // environment of the -j results
+} test_options;
 
 void init_metrics(test_bst_metrics *metrics) {
     metrics->deletes = 0;
@@ -222,21 +467,140 @@ void init_metrics(test_bst_metrics *metrics) {
     metrics->rebalances = 0;
     metrics->searches = 0;
     metrics->widths = 0;
+    metrics->mismatches = 0;
+}
+
+// Appends a column to the results of a run, see bst_result_add()
+#define COLUMN(row, kind, name, ...)                                           \
+    if (bst_result_add((row), BST_RESULT_##kind, (name), __VA_ARGS__) !=       \
+        SUCCESS) {                                                             \
+        PANIC("Failed to allocate the results");                               \
+    }
+
+// Operation types of the latency histograms and their CSV names
+#define OP_TYPES 5
+
+const char *op_name(const size_t i) {
+    static const char *names[OP_TYPES] = {"add", "search", "min", "max",
+                                          "delete"};
+    return names[i];
+}
+
+// CLOCK_MONOTONIC in nanoseconds
+uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// Counts the latency of an operation started at started, and records it with
+// its result when -R is set
+void record_op(const test_bst_s *data, const bst_trace_op_t op,
+               const int64_t key, const BST_ERROR result,
+               const uint64_t started) {
+    bst_hist_record(&data->hist[op - BST_TRACE_ADD], now_ns() - started);
+
+    if (data->trace != NULL) {
+        bst_trace_record(data->trace, op, key, result);
+    }
+}
+
+// Whether an operation found or changed what it looked for, the BST types
+// report it with different bits
+int trace_outcome(const bst_trace_op_t op, const BST_ERROR result) {
+    if (op == BST_TRACE_SEARCH) {
+        return (result & (SUCCESS | VALUE_EXISTS)) != 0;
+    }
+
+    return (result & SUCCESS) == SUCCESS;
+}
+
+// Dir/thread-<n>.trace, the trace file of a thread for -R and -T
+void trace_path(char *path, const size_t len, const char *dir,
+                const size_t thread) {
+    if ((size_t)snprintf(path, len, "%s/thread-%zu.trace", dir, thread) >=
+        len) {
+        PANIC("Trace directory path is too long");
+    }
+}
+
+// Makes a successful add or delete durable before it counts, when -w is set
+void wal_log(const test_bst_s *data, const bst_wal_op_t op,
+             const int64_t value) {
+    if (data->wal != NULL &&
+        (bst_wal_commit(data->wal, op, value) & SUCCESS) != SUCCESS) {
+        PANIC("Failed to commit WAL record");
+    }
+}
+
+// Starts the background checkpoint halfway through the first thread, when -C
+// is set
+void checkpoint_start(const test_bst_s *data, const size_t i) {
+    if (data->job != NULL && i == data->operations / 2 &&
+        (data->engine->save_background((void **)&data->bst,
+                                       data->checkpoint_path, data->job) &
+         SUCCESS) != SUCCESS) {
+        PANIC("Failed to start the background checkpoint");
+    }
+}
+
+// Adds a value, an imported key set (-f) may repeat keys
+BST_ERROR test_add(const test_bst_s *data, const int64_t value) {
+    const uint64_t started = now_ns();
+    const BST_ERROR be = data->engine->add((void **)&data->bst, value);
+    record_op(data, BST_TRACE_ADD, value, be, started);
+
+    if ((be & SUCCESS) != SUCCESS && (be & VALUE_EXISTS) != VALUE_EXISTS) {
+        PANIC("Failed to add element");
+    }
+
+    if ((be & SUCCESS) == SUCCESS) {
+        wal_log(data, BST_WAL_ADD, value);
+    }
+
+    return be;
+}
+
+// Whether a thread goes on to operation i, after operations for -n runs and
+// until the stop flag is set for -D runs
+int test_running(const test_bst_s *data, const size_t i) {
+    atomic_store_explicit(&data->progress->done, i, memory_order_relaxed);
+
+    // A thread without keys has nothing to do, even for -D runs
+    if (data->stop != NULL && data->operations > 0) {
+        return !atomic_load_explicit(data->stop, memory_order_relaxed);
+    }
+
+    return i < data->operations;
+}
+
+// Index of the key inserted by operation i, -D runs wrap around the keys of
+// the thread
+size_t test_key(const test_bst_s *data, const size_t i) {
+    return data->start + i % data->operations;
+}
+
+// Index of a key to search or delete after i operations, -d picks it among
+// the keys inserted so far
+size_t test_pick(const test_bst_s *data, bst_rand_t *rng, const size_t i) {
+    const size_t used = i < 1 ? 1 : i < data->operations ? i : data->operations;
+    return data->start + bst_dist_next(data->dist, rng, used);
+}
+
+BST_ERROR wal_apply_st(void *ctx, const bst_wal_op_t op, const int64_t value) {
+    return op == BST_WAL_ADD ? bst_st_add(ctx, value)
+                             : bst_st_delete(ctx, value);
 }
 
 void *bst_st_test_insert_thread(void *vargp) {
     const test_bst_s *data = (test_bst_s *)vargp;
-    const size_t operations = data->operations;
-    const size_t start = data->start;
     const int64_t *values = data->values;
     test_bst_metrics metrics;
     init_metrics(&metrics);
 
-    for (size_t i = 0; i < operations; i++) {
-        if ((data->add((const void **)&data->bst, values[start + i]) &
-             SUCCESS) != SUCCESS) {
-            PANIC("Failed to add element");
-        }
+    for (size_t i = 0; test_running(data, i); i++) {
+        checkpoint_start(data, i);
+        test_add(data, values[test_key(data, i)]);
         metrics.inserts++;
     }
 
@@ -246,31 +610,33 @@ void *bst_st_test_insert_thread(void *vargp) {
 
 void *bst_st_test_write_thread(void *vargp) {
     const test_bst_s *data = (test_bst_s *)vargp;
-    const size_t operations = data->operations;
-    const size_t start = data->start;
     const int64_t *values = data->values;
     test_bst_metrics metrics;
     init_metrics(&metrics);
 
-    uint seed = mix(clock(), time(NULL), getpid());
+    bst_rand_t rng = data->rng;
 
-    for (size_t i = 0; i < operations; i++) {
-        const int op = i < 3 ? 0 : rand_r(&seed) % 2;
+    for (size_t i = 0; test_running(data, i); i++) {
+        checkpoint_start(data, i);
+        const int op = i < 3 ? 0 : bst_rand_below(&rng, 2);
 
         if (op == 0) {
-            if ((data->add((const void **)&data->bst, values[start + i]) &
-                 SUCCESS) != SUCCESS) {
-                PANIC("Failed to add element");
-            }
+            test_add(data, values[test_key(data, i)]);
             metrics.inserts++;
         } else {
-            const BST_ERROR be = data->delete (
-                (const void **)&data->bst, values[start + rand_r(&seed) % i]);
+            const int64_t value = values[test_pick(data, &rng, i)];
+            const uint64_t started = now_ns();
+            const BST_ERROR be =
+                data->engine->delete((void **)&data->bst, value);
+            record_op(data, BST_TRACE_DELETE, value, be, started);
             if ((be & SUCCESS) != SUCCESS &&
                 (be & VALUE_NONEXISTENT) != VALUE_NONEXISTENT &&
                 (be & BST_EMPTY) != BST_EMPTY) {
                 PANIC("Failed to delete element");
             }
+            if ((be & SUCCESS) == SUCCESS) {
+                wal_log(data, BST_WAL_DELETE, value);
+            }
             metrics.deletes++;
         }
     }
@@ -282,21 +648,22 @@ void *bst_st_test_write_thread(void *vargp) {
 
 void *bst_st_test_read_thread(void *vargp) {
     const test_bst_s *data = (test_bst_s *)vargp;
-    const size_t operations = data->operations;
-    const size_t start = data->start;
     const int64_t *values = data->values;
     test_bst_metrics metrics;
     init_metrics(&metrics);
 
-    uint seed = mix(clock(), time(NULL), getpid());
+    bst_rand_t rng = data->rng;
 
-    for (size_t i = 0; i < operations; i++) {
-        const int op = rand_r(&seed) % 3;
+    for (size_t i = 0; test_running(data, i); i++) {
+        checkpoint_start(data, i);
+        const int op = bst_rand_below(&rng, 3);
 
         if (op == 0) {
+            const int64_t value = values[test_pick(data, &rng, i)];
+            const uint64_t started = now_ns();
             const BST_ERROR be =
-                data->search((const void **)&data->bst,
-                             values[start + rand_r(&seed) % (i != 0 ? i : 1)]);
+                data->engine->search((void **)&data->bst, value);
+            record_op(data, BST_TRACE_SEARCH, value, be, started);
             if ((be & SUCCESS) != SUCCESS && (be & BST_EMPTY) != BST_EMPTY &&
                 (be & VALUE_EXISTS) != VALUE_EXISTS &&
                 (be & VALUE_NONEXISTENT) != VALUE_NONEXISTENT) {
@@ -304,13 +671,17 @@ void *bst_st_test_read_thread(void *vargp) {
             }
             metrics.searches++;
         } else if (op == 1) {
-            const BST_ERROR be = data->min((const void **)&data->bst, NULL);
+            const uint64_t started = now_ns();
+            const BST_ERROR be = data->engine->min((void **)&data->bst, NULL);
+            record_op(data, BST_TRACE_MIN, 0, be, started);
             if ((be & SUCCESS) != SUCCESS && (be & BST_EMPTY) != BST_EMPTY) {
                 PANIC("Failed to find BST min");
             }
             metrics.mins++;
         } else {
-            const BST_ERROR be = data->max((const void **)&data->bst, NULL);
+            const uint64_t started = now_ns();
+            const BST_ERROR be = data->engine->max((void **)&data->bst, NULL);
+            record_op(data, BST_TRACE_MAX, 0, be, started);
             if ((be & SUCCESS) != SUCCESS && (be & BST_EMPTY) != BST_EMPTY) {
                 PANIC("Failed to find BST max");
             }
@@ -324,48 +695,48 @@ void *bst_st_test_read_thread(void *vargp) {
 
 void *bst_st_test_read_write_thread(void *vargp) {
     const test_bst_s *data = (test_bst_s *)vargp;
-    const size_t operations = data->operations;
-    const size_t start = data->start;
     const int64_t *values = data->values;
     test_bst_metrics metrics;
     init_metrics(&metrics);
 
-    uint seed = mix(clock(), time(NULL), getpid());
-
-    for (size_t i = 0; i < operations; i++) {
+    bst_rand_t rng = data->rng;
 
+    for (size_t i = 0; test_running(data, i); i++) {
+        checkpoint_start(data, i);
         const int prob = i < 3                   ? 1
                          : data->write_prob == 0 ? 0
                          : data->write_prob == 1 ? 1
-                         : rand_r(&seed) < (int)(data->write_prob * RAND_MAX)
-                             ? 1
-                             : 0;
+                         : bst_rand_double(&rng) < data->write_prob;
 
         if (prob) {
-            const int op = i < 3 ? 0 : rand_r(&seed) % 2;
+            const int op = i < 3 ? 0 : bst_rand_below(&rng, 2);
             if (op == 0) {
-                if ((data->add((const void **)&data->bst, values[start + i]) &
-                     SUCCESS) != SUCCESS) {
-                    PANIC("Failed to add element");
-                }
+                test_add(data, values[test_key(data, i)]);
                 metrics.inserts++;
             } else {
+                const int64_t value = values[test_pick(data, &rng, i)];
+                const uint64_t started = now_ns();
                 const BST_ERROR be =
-                    data->delete ((const void **)&data->bst,
-                                  values[start + rand_r(&seed) % i]);
+                    data->engine->delete((void **)&data->bst, value);
+                record_op(data, BST_TRACE_DELETE, value, be, started);
                 if ((be & SUCCESS) != SUCCESS &&
                     (be & VALUE_NONEXISTENT) != VALUE_NONEXISTENT &&
                     (be & BST_EMPTY) != BST_EMPTY) {
                     PANIC("Failed to delete element");
                 }
+                if ((be & SUCCESS) == SUCCESS) {
+                    wal_log(data, BST_WAL_DELETE, value);
+                }
                 metrics.deletes++;
             }
         } else {
-            const int op = rand_r(&seed) % 3;
+            const int op = bst_rand_below(&rng, 3);
             if (op == 0) {
+                const int64_t value = values[test_pick(data, &rng, i)];
+                const uint64_t started = now_ns();
                 const BST_ERROR be =
-                    data->search((const void **)&data->bst,
-                                 values[start + rand_r(&seed) % i]);
+                    data->engine->search((void **)&data->bst, value);
+                record_op(data, BST_TRACE_SEARCH, value, be, started);
                 if ((be & SUCCESS) != SUCCESS &&
                     (be & BST_EMPTY) != BST_EMPTY &&
                     (be & VALUE_EXISTS) != VALUE_EXISTS &&
@@ -374,7 +745,10 @@ void *bst_st_test_read_write_thread(void *vargp) {
                 }
                 metrics.searches++;
             } else if (op == 1) {
-                const BST_ERROR be = data->min((const void **)&data->bst, NULL);
+                const uint64_t started = now_ns();
+                const BST_ERROR be =
+                    data->engine->min((void **)&data->bst, NULL);
+                record_op(data, BST_TRACE_MIN, 0, be, started);
                 if ((be & SUCCESS) != SUCCESS &&
                     (be & BST_EMPTY) != BST_EMPTY &&
                     (be & VALUE_EXISTS) != VALUE_EXISTS &&
@@ -383,7 +757,10 @@ void *bst_st_test_read_write_thread(void *vargp) {
                 }
                 metrics.mins++;
             } else {
-                const BST_ERROR be = data->max((const void **)&data->bst, NULL);
+                const uint64_t started = now_ns();
+                const BST_ERROR be =
+                    data->engine->max((void **)&data->bst, NULL);
+                record_op(data, BST_TRACE_MAX, 0, be, started);
                 if ((be & SUCCESS) != SUCCESS &&
                     (be & BST_EMPTY) != BST_EMPTY) {
                     PANIC("Failed to find BST max");
@@ -397,218 +774,991 @@ void *bst_st_test_read_write_thread(void *vargp) {
     return NULL;
 }
 
-void bst_test(const int64_t operations, const size_t threads,
-              const enum bst_type bt, const enum test_strat strat,
-              const size_t repeat, int64_t *values, float write_prob) {
-    char *bst_type = NULL;
-    char *strat_type = NULL;
+// Holds a replayed operation back until its recorded offset from the first
+// recorded operation has passed since the start gate opened, when -P is set
+void replay_wait(const test_bst_s *data, const bst_trace_record_t *rec) {
+    const uint64_t at_ns = data->started_ns + rec->time_ns - data->replay_base;
+    const struct timespec at = {.tv_sec = at_ns / 1000000000,
+                                .tv_nsec = at_ns % 1000000000};
 
-    void *(*function)(void *) = NULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL);
+}
 
-    switch (bt) {
-    case ST:
-        bst_type = "ST";
-        break;
-    case CGL:
-        bst_type = "CGL";
-        break;
-    case FGL:
-        bst_type = "FGL";
-        break;
-    case AT:
-        bst_type = "AT";
-        break;
-    }
+void *bst_st_test_replay_thread(void *vargp) {
+    const test_bst_s *data = (test_bst_s *)vargp;
+    test_bst_metrics metrics;
+    init_metrics(&metrics);
 
-    switch (strat) {
-    case INSERT:
-        strat_type = "INSERT";
-        function = bst_st_test_insert_thread;
-        break;
-    case WRITE:
-        strat_type = "WRITE";
-        function = bst_st_test_write_thread;
-        break;
-    case READ:
-        strat_type = "READ";
-        function = bst_st_test_read_thread;
-        break;
-    case READ_WRITE:
-        strat_type = "READ_WRITE";
-        function = bst_st_test_read_write_thread;
-        break;
-    }
+    size_t next[data->replay_count];
+    memset(next, 0, sizeof next);
 
-    const size_t ti = operations / threads;
-    const size_t tr = operations % threads;
+    for (size_t i = 0; test_running(data, i); i++) {
+        checkpoint_start(data, i);
 
-    test_bst_s t_data[threads];
+        // Earliest pending record, a thread replaying several traces merges
+        // them by time
+        const bst_trace_record_t *rec = NULL;
+        size_t from = 0;
 
-    for (size_t i = 0; i < threads; i++) {
-        test_bst_s *t = &t_data[i];
-        t->operations = ti;
-        t->start = i * ti;
-        t->values = values;
-        t->write_prob = write_prob;
-        t->metrics = bst_metrics_new();
-        switch (bt) {
-        case ST:
-            set_st_functions(t);
-            break;
-        case CGL:
-            set_mt_cgl_functions(t);
-            break;
-        case FGL:
-            set_mt_fgl_functions(t);
-            break;
-        case AT:
-            set_at_functions(t);
-            break;
+        for (size_t t = 0; t < data->replay_count; t++) {
+            if (next[t] < bst_trace_count(data->replay[t])) {
+                const bst_trace_record_t *c =
+                    bst_trace_at(data->replay[t], next[t]);
+                if (rec == NULL || c->time_ns < rec->time_ns) {
+                    rec = c;
+                    from = t;
+                }
+            }
         }
 
-        if (i + 1 >= threads) {
-            t->operations += tr;
+        if (rec == NULL) {
+            break;
         }
-    }
 
-    for (int64_t r = 0; r < repeat; r++) {
-        struct timeval start, end;
+        next[from]++;
 
-        const void *bst = NULL;
-        const void *bst__ = NULL;
+        if (data->pacing) {
+            replay_wait(data, rec);
+        }
 
-        const int add_elements = strat == READ ? 1 : 0;
+        BST_ERROR be = UNKNOWN;
+        const uint64_t started = now_ns();
 
-        switch (bt) {
-        case ST:
-            bst = bst_st_new(NULL);
-            bst__ = &bst;
-            if (add_elements) {
-                for (int i = 0; i < operations; i++) {
-                    bst_st_add((bst_st_t **)bst__, values[i]);
-                }
+        switch (rec->op) {
+        case BST_TRACE_ADD:
+            be = test_add(data, rec->key);
+            metrics.inserts++;
+            break;
+        case BST_TRACE_DELETE:
+            be = data->engine->delete((void **)&data->bst, rec->key);
+            record_op(data, BST_TRACE_DELETE, rec->key, be, started);
+            if ((be & SUCCESS) != SUCCESS &&
+                (be & VALUE_NONEXISTENT) != VALUE_NONEXISTENT &&
+                (be & BST_EMPTY) != BST_EMPTY) {
+                PANIC("Failed to delete element");
+            }
+            if ((be & SUCCESS) == SUCCESS) {
+                wal_log(data, BST_WAL_DELETE, rec->key);
             }
+            metrics.deletes++;
             break;
-        case CGL:
-            bst = bst_mt_cgl_new(NULL);
-            bst__ = &bst;
-            if (add_elements) {
-                for (int i = 0; i < operations; i++) {
-                    bst_mt_cgl_add((bst_mt_cgl_t **)bst__, values[i]);
-                }
+        case BST_TRACE_SEARCH:
+            be = data->engine->search((void **)&data->bst, rec->key);
+            record_op(data, BST_TRACE_SEARCH, rec->key, be, started);
+            if ((be & SUCCESS) != SUCCESS && (be & BST_EMPTY) != BST_EMPTY &&
+                (be & VALUE_EXISTS) != VALUE_EXISTS &&
+                (be & VALUE_NONEXISTENT) != VALUE_NONEXISTENT) {
+                PANIC("Failed to search element");
             }
+            metrics.searches++;
             break;
-        case FGL:
-            bst = bst_mt_fgl_new(NULL);
-            bst__ = &bst;
-            if (add_elements) {
-                for (int i = 0; i < operations; i++) {
-                    bst_mt_fgl_add((bst_mt_fgl_t **)bst__, values[i]);
-                }
+        case BST_TRACE_MIN:
+            be = data->engine->min((void **)&data->bst, NULL);
+            record_op(data, BST_TRACE_MIN, 0, be, started);
+            if ((be & SUCCESS) != SUCCESS && (be & BST_EMPTY) != BST_EMPTY) {
+                PANIC("Failed to find BST min");
             }
+            metrics.mins++;
             break;
-        case AT:
-            bst = bst_at_new(NULL);
-            bst__ = &bst;
-            if (add_elements) {
-                for (int i = 0; i < operations; i++) {
-                    bst_at_add((bst_at_t **)bst__, values[i]);
-                }
+        case BST_TRACE_MAX:
+            be = data->engine->max((void **)&data->bst, NULL);
+            record_op(data, BST_TRACE_MAX, 0, be, started);
+            if ((be & SUCCESS) != SUCCESS && (be & BST_EMPTY) != BST_EMPTY) {
+                PANIC("Failed to find BST max");
             }
+            metrics.maxs++;
             break;
+        default:
+            PANIC("Unknown operation in trace");
         }
 
-        for (size_t i = 0; i < threads; i++) {
-            t_data[i].bst = (void *)bst;
+        if (trace_outcome(rec->op, be) != trace_outcome(rec->op, rec->result)) {
+            metrics.mismatches++;
         }
+    }
 
-        gettimeofday(&start, NULL);
-        pthread_t thread[threads];
-        for (int i = 0; i < threads; i++) {
-            if (pthread_create(&thread[i], NULL, function, &t_data[i])) {
-                PANIC("pthread_create() failure");
-            }
-        }
+    *data->metrics = metrics;
+    return NULL;
+}
 
-        for (int i = 0; i < threads; i++) {
-            if (pthread_join(thread[i], NULL)) {
-                PANIC("pthread_join() failure");
+// Searches a key of a YCSB preset
+void ycsb_search(const test_bst_s *data, const int64_t value) {
+    const uint64_t started = now_ns();
+    const BST_ERROR be = data->engine->search((void **)&data->bst, value);
+    record_op(data, BST_TRACE_SEARCH, value, be, started);
+    if ((be & SUCCESS) != SUCCESS && (be & BST_EMPTY) != BST_EMPTY &&
+        (be & VALUE_EXISTS) != VALUE_EXISTS &&
+        (be & VALUE_NONEXISTENT) != VALUE_NONEXISTENT) {
+        PANIC("Failed to search element");
+    }
+}
+
+void *bst_st_test_ycsb_thread(void *vargp) {
+    const test_bst_s *data = (test_bst_s *)vargp;
+    const size_t operations = data->operations;
+    const size_t start = data->start;
+    const int64_t *values = data->values;
+    const ycsb_mix *preset = data->ycsb;
+    test_bst_metrics metrics;
+    init_metrics(&metrics);
+
+    bst_rand_t rng = data->rng;
+
+    // The first half of the keys was loaded before the run, inserts take the
+    // next ones
+    size_t loaded = operations / 2 > 0 ? operations / 2 : 1;
+
+    // Upper bounds of the operation shares, one draw picks the operation
+    const double insert = preset->insert;
+    const double update = insert + preset->update;
+    const double scan = update + preset->scan;
+    const double rmw = scan + preset->rmw;
+
+    for (size_t i = 0; test_running(data, i); i++) {
+        checkpoint_start(data, i);
+        const double op = bst_rand_double(&rng);
+        const int64_t value =
+            values[start + bst_dist_next(data->dist, &rng, loaded)];
+
+        if (op < insert && loaded < operations) {
+            test_add(data, values[start + loaded++]);
+            metrics.inserts++;
+        } else if (op < update) {
+            test_add(data, value);
+            metrics.inserts++;
+        } else if (op < scan) {
+            const int64_t length = 1 + bst_rand_below(&rng, YCSB_MAX_SCAN);
+            for (int64_t k = 0; k < length && value <= INT64_MAX - k; k++) {
+                ycsb_search(data, value + k);
+                metrics.searches++;
             }
+        } else if (op < rmw) {
+            ycsb_search(data, value);
+            test_add(data, value);
+            metrics.searches++;
+            metrics.inserts++;
+        } else {
+            ycsb_search(data, value);
+            metrics.searches++;
         }
+    }
 
-        gettimeofday(&end, NULL);
-        const double time_taken =
-            end.tv_sec + end.tv_usec / 1e6 - start.tv_sec - start.tv_usec / 1e6;
+    *data->metrics = metrics;
+    return NULL;
+}
 
-        size_t nc = 0, height = 0, width = 0;
-        int64_t min = 0, max = 0;
+// Throughput sampling period of -D runs
+#define SAMPLE_INTERVAL_MS 100
+
+/**
+ * Samples the operations done by the threads of a -D run every
+ * SAMPLE_INTERVAL_MS into series, as operations per second, and sets the stop
+ * flag once the run has lasted duration_ns.
+ */
+typedef struct test_sampler {
+    test_progress *progress;
+    size_t threads;
+    atomic_int *stop;
+    uint64_t duration_ns;
+    double *series;
+    size_t samples;
+    size_t capacity;
+} test_sampler;
+
+void *test_sampler_thread(void *vargp) {
+    test_sampler *sampler = vargp;
+    const uint64_t begin = now_ns();
+    const uint64_t end = begin + sampler->duration_ns;
+    uint64_t last_ns = begin, last_done = 0;
+
+    for (uint64_t k = 1; !atomic_load(sampler->stop); k++) {
+        uint64_t at_ns = begin + k * SAMPLE_INTERVAL_MS * 1000000ull;
+        at_ns = at_ns < end ? at_ns : end;
+
+        const struct timespec at = {.tv_sec = at_ns / 1000000000,
+                                    .tv_nsec = at_ns % 1000000000};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL);
+
+        uint64_t done = 0;
+        for (size_t i = 0; i < sampler->threads; i++) {
+            done += atomic_load_explicit(&sampler->progress[i].done,
+                                         memory_order_relaxed);
+        }
 
-        switch (bt) {
-        case ST:
-            nc = ((bst_st_t *)bst)->count;
-            bst_st_min((bst_st_t **)bst__, &min);
-            bst_st_max((bst_st_t **)bst__, &max);
-            bst_st_free((bst_st_t **)bst__);
-            break;
-        case CGL:
-            bst_mt_cgl_node_count((bst_mt_cgl_t **)bst__, &nc);
-            bst_mt_cgl_min((bst_mt_cgl_t **)bst__, &min);
-            bst_mt_cgl_max((bst_mt_cgl_t **)bst__, &max);
-            bst_mt_cgl_free((bst_mt_cgl_t **)bst__);
-            break;
-        case FGL:
-            bst_mt_fgl_node_count((bst_mt_fgl_t **)bst__, &nc);
-            bst_mt_fgl_min((bst_mt_fgl_t **)bst__, &min);
-            bst_mt_fgl_max((bst_mt_fgl_t **)bst__, &max);
-            bst_mt_fgl_free((bst_mt_fgl_t **)bst__);
-            break;
-        case AT:
-            bst_at_node_count((bst_at_t **)bst__, &nc);
-            bst_at_min((bst_at_t **)bst__, &min);
-            bst_at_max((bst_at_t **)bst__, &max);
-            bst_at_free((bst_at_t **)bst__);
-            break;
+        const uint64_t now = now_ns();
+        if (sampler->samples < sampler->capacity && now > last_ns) {
+            sampler->series[sampler->samples++] =
+                (done - last_done) / ((now - last_ns) / 1e9);
         }
 
-        size_t inserts = 0;
-        size_t searches = 0;
-        size_t mins = 0;
-        size_t maxs = 0;
-        size_t heights = 0;
-        size_t widths = 0;
-        size_t deletes = 0;
-        size_t rebalances = 0;
+        last_ns = now;
+        last_done = done;
 
-        for (size_t i = 0; i < threads; i++) {
-            inserts += t_data[i].metrics->inserts;
-            searches += t_data[i].metrics->searches;
-            mins += t_data[i].metrics->mins;
-            maxs += t_data[i].metrics->maxs;
-            heights += t_data[i].metrics->heights;
-            widths += t_data[i].metrics->widths;
-            deletes += t_data[i].metrics->deletes;
-            rebalances += t_data[i].metrics->rebalances;
+        if (at_ns >= end) {
+            atomic_store(sampler->stop, 1);
         }
+    }
 
-        printf("%s,", bst_type);
-        printf("%s,", strat_type);
-        printf("%zu,", operations);
-        printf("%zu,", threads);
-        printf("%ld,", nc);
-        printf("%ld,", min);
-        printf("%ld,", max);
-        printf("%ld,", height);
-        printf("%ld,", width);
-        printf("%f,", time_taken);
-        printf("%ld,", inserts);
-        printf("%ld,", searches);
-        printf("%ld,", mins);
-        printf("%ld,", maxs);
-        printf("%ld,", heights);
-        printf("%ld,", widths);
-        printf("%ld,", deletes);
-        printf("%ld\n", rebalances);
-        fflush(stdout);
+    return NULL;
+}
+
+typedef struct worker {
+    worker_pool *pool;
+    size_t id;
+    pthread_t thread;
+} worker;
+
+/**
+ * Harness threads, created once and reused by every test and repetition so
+ * thread creation is never part of a measurement. Each run wakes the first
+ * active workers, which wait for each other at the start gate before calling
+ * the test function on their test_bst_s. With -A every worker stays on its
+ * CPU for the whole process.
+ */
+struct worker_pool {
+    worker *workers;
+    size_t count;
+    pthread_mutex_t mtx;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    uint64_t generation; // bumped for every run
+    size_t running;      // workers of the current run still busy
+    int stop;
+    void *(*function)(void *);
+    test_bst_s *data;
+    size_t active;
+    pthread_barrier_t gate;
+    int perf; // workers count their runs with bst_perf
+};
+
+void *worker_main(void *vargp) {
+    worker *w = vargp;
+    worker_pool *pool = w->pool;
+    uint64_t seen = 0;
+
+    // Counters only follow the thread that opens them
+    bst_perf_t perf;
+    if (pool->perf && bst_perf_open(&perf) != SUCCESS) {
+        PANIC("Failed to open the performance counters of option -e");
+    }
+
+    pthread_mutex_lock(&pool->mtx);
+
+    for (;;) {
+        while (!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_cond, &pool->mtx);
+        }
+
+        if (pool->stop) {
+            break;
+        }
+
+        seen = pool->generation;
+
+        if (w->id >= pool->active) {
+            continue;
+        }
+
+        void *(*function)(void *) = pool->function;
+        test_bst_s *t = &pool->data[w->id];
+        pthread_mutex_unlock(&pool->mtx);
+
+        pthread_barrier_wait(&pool->gate);
+        if (pool->perf) {
+            bst_perf_start(&perf);
+        }
+
+        t->started_ns = now_ns();
+        function(t);
+        t->stopped_ns = now_ns();
+
+        if (pool->perf) {
+            bst_perf_stop(&perf);
+            t->perf = perf;
+        }
+
+        pthread_mutex_lock(&pool->mtx);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->mtx);
+
+    if (pool->perf) {
+        bst_perf_close(&perf);
+    }
+
+    return NULL;
+}
+
+// cpus holds the CPU of each worker, NULL leaves them to the scheduler. perf
+// has every worker count its runs.
+worker_pool *worker_pool_new(const size_t count, const int *cpus,
+                             const int perf) {
+    worker_pool *pool = calloc(1, sizeof(worker_pool));
+    if (pool == NULL) {
+        PANIC("Failed to allocate the worker pool");
+    }
+
+    pool->workers = calloc(count, sizeof(worker));
+    if (pool->workers == NULL) {
+        PANIC("Failed to allocate the worker pool");
+    }
+
+    pool->count = count;
+    pool->perf = perf;
+    pthread_mutex_init(&pool->mtx, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (size_t i = 0; i < count; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main,
+                           &pool->workers[i])) {
+            PANIC("pthread_create() failure");
+        }
+
+        if (cpus != NULL &&
+            bst_topo_pin(pool->workers[i].thread, cpus[i]) != SUCCESS) {
+            PANIC("pthread_setaffinity_np() failure");
+        }
+    }
+
+    return pool;
+}
+
+// Runs function on the first n workers, one test_bst_s each, and returns when
+// all of them are done
+void worker_pool_run(worker_pool *pool, void *(*function)(void *),
+                     test_bst_s *data, const size_t n) {
+    if (n > pool->count) {
+        PANIC("More threads than workers in the pool");
+    }
+
+    if (pthread_barrier_init(&pool->gate, NULL, n)) {
+        PANIC("pthread_barrier_init() failure");
+    }
+
+    pthread_mutex_lock(&pool->mtx);
+    pool->function = function;
+    pool->data = data;
+    pool->active = n;
+    pool->running = n;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->mtx);
+    }
+    pthread_mutex_unlock(&pool->mtx);
+
+    pthread_barrier_destroy(&pool->gate);
+}
+
+void worker_pool_free(worker_pool *pool) {
+    pthread_mutex_lock(&pool->mtx);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mtx);
+
+    for (size_t i = 0; i < pool->count; i++) {
+        if (pthread_join(pool->workers[i].thread, NULL)) {
+            PANIC("pthread_join() failure");
+        }
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mtx);
+    free(pool->workers);
+    free(pool);
+}
+
+// UTC time in ISO 8601, at least 21 bytes
+void iso_time(char *buf, const size_t size, const time_t t) {
+    struct tm tm;
+    strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&t, &tm));
+}
+
+// First model name of /proc/cpuinfo, empty when there is none
+void cpu_model(char *buf, const size_t size) {
+    buf[0] = '\0';
+
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (f == NULL) {
+        return;
+    }
+
+    char line[512];
+
+    while (fgets(line, sizeof line, f) != NULL) {
+        const char *v = strchr(line, ':');
+
+        if (strncmp(line, "model name", 10) == 0 && v != NULL) {
+            v += strspn(v + 1, " \t") + 1;
+            snprintf(buf, size, "%s", v);
+            buf[strcspn(buf, "\n")] = '\0';
+            break;
+        }
+    }
+
+    fclose(f);
+}
+
+// Fields of every -j result: the build, the machine and the command line
+void result_meta(bst_result_t *meta, const int argc, char **argv,
+                 const char *placement) {
+    struct utsname uts;
+    char model[256];
+    char started[32];
+
+    if (uname(&uts) != 0) {
+        PANIC("uname() failure");
+    }
+
+    cpu_model(model, sizeof model);
+    iso_time(started, sizeof started, time(NULL));
+
+    char *command = NULL;
+    size_t command_size = 0;
+    FILE *f = open_memstream(&command, &command_size);
+
+    for (int i = 0; i < argc; i++) {
+        fprintf(f, i == 0 ? "%s" : " %s", argv[i]);
+    }
+
+    fclose(f);
+
+    COLUMN(meta, TEXT, "git_hash", "%s", BST_GIT_HASH);
+    COLUMN(meta, TEXT, "compiler", "%s", BST_COMPILER);
+    COLUMN(meta, TEXT, "c_flags", "%s", BST_C_FLAGS);
+    COLUMN(meta, TEXT, "build_type", "%s", BST_BUILD_TYPE);
+    COLUMN(meta, TEXT, "cpu_model", "%s", model);
+    COLUMN(meta, NUMBER, "cpus_online", "%ld",
+           sysconf(_SC_NPROCESSORS_ONLN));
+    COLUMN(meta, TEXT, "kernel", "%s %s %s", uts.sysname, uts.release,
+           uts.version);
+    COLUMN(meta, TEXT, "machine", "%s", uts.machine);
+    COLUMN(meta, TEXT, "host", "%s", uts.nodename);
+    COLUMN(meta, TEXT, "placement", "%s", placement);
+    COLUMN(meta, TEXT, "command", "%s", command);
+    COLUMN(meta, TEXT, "started_at", "%s", started);
+
+    free(command);
+}
+
+// Appends the -e columns, summed over the threads. A column is empty when a
+// counter it needs is not counted.
+void add_perf(bst_result_t *row, const test_bst_s *t_data,
+              const size_t threads, const size_t performed,
+              const int enabled) {
+    uint64_t sum[BST_PERF_COUNTERS] = {0};
+    int counted[BST_PERF_COUNTERS];
+
+    for (size_t j = 0; j < BST_PERF_COUNTERS; j++) {
+        counted[j] = enabled;
+        for (size_t i = 0; enabled && i < threads; i++) {
+            counted[j] = counted[j] && bst_perf_available(&t_data[i].perf, j);
+            sum[j] += t_data[i].perf.value[j];
+        }
+    }
+
+    const double ops = performed > 0 ? performed : 1;
+
+    if (counted[BST_PERF_CYCLES] && counted[BST_PERF_INSTRUCTIONS] &&
+        sum[BST_PERF_CYCLES] > 0) {
+        COLUMN(row, NUMBER, "ipc", "%f",
+               (double)sum[BST_PERF_INSTRUCTIONS] / sum[BST_PERF_CYCLES]);
+    } else {
+        COLUMN(row, NUMBER, "ipc", "%s", "");
+    }
+
+    const struct {
+        int counter;
+        const char *name;
+    } per_op[] = {
+        {BST_PERF_CYCLES, "cycles_per_op"},
+        {BST_PERF_L1D_MISSES, "l1d_misses_per_op"},
+        {BST_PERF_LLC_MISSES, "llc_misses_per_op"},
+        {BST_PERF_BRANCH_MISSES, "branch_misses_per_op"},
+        {BST_PERF_TASK_CLOCK, "cpu_ns_per_op"},
+    };
+
+    for (size_t j = 0; j < sizeof per_op / sizeof per_op[0]; j++) {
+        if (counted[per_op[j].counter]) {
+            COLUMN(row, NUMBER, per_op[j].name, "%f",
+                   sum[per_op[j].counter] / ops);
+        } else {
+            COLUMN(row, NUMBER, per_op[j].name, "%s", "");
+        }
+    }
+
+    const struct {
+        int counter;
+        const char *name;
+    } totals[] = {
+        {BST_PERF_CONTEXT_SWITCHES, "context_switches"},
+        {BST_PERF_PAGE_FAULTS, "page_faults"},
+    };
+
+    for (size_t j = 0; j < sizeof totals / sizeof totals[0]; j++) {
+        if (counted[totals[j].counter]) {
+            COLUMN(row, NUMBER, totals[j].name, "%" PRIu64,
+                   sum[totals[j].counter]);
+        } else {
+            COLUMN(row, NUMBER, totals[j].name, "%s", "");
+        }
+    }
+}
+
+void bst_test(const int64_t operations, const size_t threads,
+              const bst_engine_ops *engine, const enum test_strat strat,
+              const int64_t *values, const test_options *opts) {
+    const char *bst_type = engine->name;
+    char *strat_type = NULL;
+
+    void *(*function)(void *) = NULL;
+
+    switch (strat) {
+    case INSERT:
+        strat_type = "INSERT";
+        function = bst_st_test_insert_thread;
+        break;
+    case WRITE:
+        strat_type = "WRITE";
+        function = bst_st_test_write_thread;
+        break;
+    case READ:
+        strat_type = "READ";
+        function = bst_st_test_read_thread;
+        break;
+    case READ_WRITE:
+        strat_type = "READ_WRITE";
+        function = bst_st_test_read_write_thread;
+        break;
+    case REPLAY:
+        strat_type = "REPLAY";
+        function = bst_st_test_replay_thread;
+        break;
+    default:
+        strat_type = (char *)ycsb_find(strat)->name;
+        function = bst_st_test_ycsb_thread;
+        break;
+    }
+
+    // The YCSB presets pick keys from their standard distribution unless -d
+    // is set
+    const ycsb_mix *ycsb = ycsb_find(strat);
+    const char *key_dist = opts->dist_name;
+    bst_dist_t ycsb_dist;
+
+    if (ycsb != NULL) {
+        bst_dist_init(&ycsb_dist, ycsb->dist, BST_DIST_DEFAULT_THETA, 0, 0);
+        if (!opts->dist_set) {
+            key_dist = ycsb->dist_name;
+        }
+    }
+
+    const size_t ti = operations / threads;
+    const size_t tr = operations % threads;
+
+    test_bst_s t_data[threads];
+    atomic_int stop;
+    test_progress *progress =
+        aligned_alloc(64, sizeof(test_progress) * threads);
+    if (progress == NULL) {
+        PANIC("Failed to allocate the thread progress");
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        test_bst_s *t = &t_data[i];
+        t->operations = ti;
+        t->start = i * ti;
+        t->values = values;
+        t->stop = opts->duration > 0 ? &stop : NULL;
+        t->progress = &progress[i];
+        t->dist = ycsb != NULL && !opts->dist_set ? &ycsb_dist : &opts->dist;
+        t->ycsb = ycsb;
+        t->write_prob = opts->write_prob;
+        t->checkpoint_path = opts->checkpoint_path;
+        t->metrics = bst_metrics_new();
+        t->trace = NULL;
+        t->hist = malloc(sizeof(bst_hist_t) * OP_TYPES);
+        if (t->hist == NULL) {
+            PANIC("Failed to allocate the latency histograms");
+        }
+        for (size_t j = 0; j < OP_TYPES; j++) {
+            bst_hist_reset(&t->hist[j]);
+        }
+        t->replay = NULL;
+        t->replay_count = 0;
+        t->replay_base = opts->replay_base;
+        t->pacing = opts->pacing;
+        t->engine = engine;
+
+        if (i + 1 >= threads) {
+            t->operations += tr;
+        }
+
+        // Trace j goes to thread j % threads, the recorded thread when there
+        // are as many threads as traces
+        if (strat == REPLAY) {
+            t->replay = malloc(sizeof(bst_trace_t *) *
+                               (opts->replay_count / threads + 1));
+            t->operations = 0;
+            for (size_t j = i; j < opts->replay_count; j += threads) {
+                t->replay[t->replay_count++] = opts->replay[j];
+                t->operations += bst_trace_count(opts->replay[j]);
+            }
+        }
+    }
+
+    for (size_t r = 0; r < opts->repeat; r++) {
+        const bst_engine_config_t config = {.frames = opts->frames};
+        void *bst = engine->new(&config, NULL);
+        if (bst == NULL) {
+            PANIC("Failed to create the BST");
+        }
+
+        // READ searches a filled tree
+        if (strat == READ) {
+            for (int i = 0; i < operations; i++) {
+                engine->add(&bst, values[i]);
+            }
+        }
+
+        // The YCSB load phase, the first half of the keys of each thread
+        if (ycsb != NULL) {
+            for (size_t i = 0; i < threads; i++) {
+                for (size_t j = 0; j < t_data[i].operations / 2; j++) {
+                    engine->add(&bst, values[t_data[i].start + j]);
+                }
+            }
+        }
+
+        bst_wal_t *wal = NULL;
+
+        if (opts->wal_path != NULL) {
+            // Every run starts from an empty log
+            unlink(opts->wal_path);
+
+            wal = bst_wal_open(opts->wal_path, NULL);
+            if (wal == NULL) {
+                PANIC("Failed to open the WAL");
+            }
+        }
+
+        bst_snapshot_job_t job = {.pid = -1};
+
+        for (size_t i = 0; i < threads; i++) {
+            t_data[i].bst = bst;
+            t_data[i].wal = wal;
+            t_data[i].job = NULL;
+        }
+
+        if (opts->checkpoint_path != NULL && engine->save_background != NULL) {
+            t_data[0].job = &job;
+        }
+
+        if (opts->record_dir != NULL) {
+            for (size_t i = 0; i < threads; i++) {
+                char path[PATH_MAX];
+                trace_path(path, sizeof path, opts->record_dir, i);
+
+                t_data[i].trace =
+                    bst_trace_create(path, i, BST_TRACE_DEFAULT_RECORDS, NULL);
+                if (t_data[i].trace == NULL) {
+                    PANIC("Failed to create the trace of option -R");
+                }
+            }
+        }
+
+        test_sampler sampler = {
+            .progress = progress,
+            .threads = threads,
+            .stop = &stop,
+            .duration_ns = opts->duration * 1000000000ull,
+        };
+        pthread_t sampler_thread;
+
+        atomic_store(&stop, 0);
+        for (size_t i = 0; i < threads; i++) {
+            atomic_store(&progress[i].done, 0);
+            t_data[i].rng = *opts->streams;
+            bst_rand_jump(opts->streams);
+        }
+
+        if (opts->duration > 0) {
+            sampler.capacity = opts->duration * 1000 / SAMPLE_INTERVAL_MS + 2;
+            sampler.series = malloc(sizeof(double) * sampler.capacity);
+            if (sampler.series == NULL) {
+                PANIC("Failed to allocate the throughput samples");
+            }
+
+            if (pthread_create(&sampler_thread, NULL, test_sampler_thread,
+                               &sampler)) {
+                PANIC("pthread_create() failure");
+            }
+        }
+
+        worker_pool_run(opts->pool, function, t_data, threads);
+
+        // A replay may run out of operations before the duration
+        if (opts->duration > 0) {
+            atomic_store(&stop, 1);
+            if (pthread_join(sampler_thread, NULL)) {
+                PANIC("pthread_join() failure");
+            }
+        }
+
+        // -D runs do as many operations as they can
+        size_t performed = 0;
+        for (size_t i = 0; i < threads; i++) {
+            performed += atomic_load(&progress[i].done);
+        }
+
+        // From the first thread through the start gate to the last one done,
+        // the spread is between the fastest and the slowest thread
+        uint64_t first = UINT64_MAX, last_start = 0, last = 0;
+        uint64_t fastest = UINT64_MAX, slowest = 0;
+
+        for (size_t i = 0; i < threads; i++) {
+            const test_bst_s *t = &t_data[i];
+            const uint64_t took = t->stopped_ns - t->started_ns;
+
+            first = t->started_ns < first ? t->started_ns : first;
+            last_start =
+                t->started_ns > last_start ? t->started_ns : last_start;
+            last = t->stopped_ns > last ? t->stopped_ns : last;
+            fastest = took < fastest ? took : fastest;
+            slowest = took > slowest ? took : slowest;
+        }
+
+        const double time_taken = (last - first) / 1e9;
+
+        for (size_t i = 0; i < threads; i++) {
+            if (t_data[i].trace != NULL &&
+                bst_trace_close(&t_data[i].trace) != SUCCESS) {
+                PANIC("Failed to close the trace of option -R");
+            }
+        }
+
+        // Node memory actually backed by huge pages, read before the tree is
+        // freed
+        const size_t huge_kb = bst_arena_huge_bytes() / 1024;
+
+        bst_wal_stats_t ws = {0};
+        bst_snapshot_job_stats_t cs = {0};
+
+        if (job.pid > 0) {
+            if (bst_snapshot_job_wait(&job, &cs) != SUCCESS) {
+                PANIC("Background checkpoint failed");
+            }
+
+            bst_snapshot_t snap;
+            if (bst_snapshot_map(opts->checkpoint_path, &snap) != SUCCESS) {
+                PANIC("Background checkpoint is not a valid snapshot");
+            }
+            bst_snapshot_unmap(&snap);
+        }
+
+        if (wal != NULL) {
+            bst_wal_stats(wal, &ws);
+            if (bst_wal_close(&wal) != SUCCESS) {
+                PANIC("Failed to close the WAL");
+            }
+        }
+
+        size_t nc = 0, height = 0, width = 0;
+        int64_t min = 0, max = 0;
+        bst_engine_stats_t es = {0};
+
+        engine->count(&bst, &nc);
+        engine->min(&bst, &min);
+        engine->max(&bst, &max);
+        engine->stats(&bst, &es);
+        engine->free(&bst);
+
+        // Recovery check, replaying the log must rebuild the same tree. READ
+        // and the YCSB presets fill the tree before the log is opened.
+        if (opts->wal_path != NULL && strat != READ && ycsb == NULL) {
+            bst_st_t *recovered = bst_st_new(NULL);
+
+            if ((bst_wal_replay(opts->wal_path, wal_apply_st, &recovered,
+                                NULL) &
+                 SUCCESS) != SUCCESS ||
+                recovered->count != nc) {
+                PANIC("WAL replay does not match the BST");
+            }
+
+            bst_st_free(&recovered);
+        }
+
+        size_t inserts = 0;
+        size_t searches = 0;
+        size_t mins = 0;
+        size_t maxs = 0;
+        size_t heights = 0;
+        size_t widths = 0;
+        size_t deletes = 0;
+        size_t rebalances = 0;
+        size_t mismatches = 0;
+
+        for (size_t i = 0; i < threads; i++) {
+            inserts += t_data[i].metrics->inserts;
+            searches += t_data[i].metrics->searches;
+            mins += t_data[i].metrics->mins;
+            maxs += t_data[i].metrics->maxs;
+            heights += t_data[i].metrics->heights;
+            widths += t_data[i].metrics->widths;
+            deletes += t_data[i].metrics->deletes;
+            rebalances += t_data[i].metrics->rebalances;
+            mismatches += t_data[i].metrics->mismatches;
+        }
+
+        bst_result_t row = {0};
+
+        COLUMN(&row, TEXT, "bst_type", "%s", bst_type);
+        COLUMN(&row, TEXT, "strategy", "%s", strat_type);
+        COLUMN(&row, NUMBER, "operations", "%zu", performed);
+        COLUMN(&row, NUMBER, "threads", "%zu", threads);
+        COLUMN(&row, NUMBER, "tree_node_count", "%ld", nc);
+        COLUMN(&row, NUMBER, "live_nodes", "%zu", es.memory.live_nodes);
+        COLUMN(&row, NUMBER, "node_bytes", "%zu", es.memory.node_bytes);
+        COLUMN(&row, NUMBER, "lock_bytes", "%zu", es.memory.lock_bytes);
+        COLUMN(&row, NUMBER, "meta_bytes", "%zu", es.memory.meta_bytes);
+        COLUMN(&row, NUMBER, "pending_bytes", "%zu", es.memory.pending_bytes);
+        COLUMN(&row, NUMBER, "node_allocs", "%zu", es.memory.allocs);
+        COLUMN(&row, NUMBER, "node_frees", "%zu", es.memory.frees);
+        COLUMN(&row, NUMBER, "tree_min", "%ld", min);
+        COLUMN(&row, NUMBER, "tree_max", "%ld", max);
+        COLUMN(&row, NUMBER, "tree_height", "%ld", height);
+        COLUMN(&row, NUMBER, "tree_width", "%ld", width);
+        COLUMN(&row, NUMBER, "time_taken", "%f", time_taken);
+        COLUMN(&row, NUMBER, "inserts", "%ld", inserts);
+        COLUMN(&row, NUMBER, "searches", "%ld", searches);
+        COLUMN(&row, NUMBER, "mins", "%ld", mins);
+        COLUMN(&row, NUMBER, "maxs", "%ld", maxs);
+        COLUMN(&row, NUMBER, "heights", "%ld", heights);
+        COLUMN(&row, NUMBER, "widths", "%ld", widths);
+        COLUMN(&row, NUMBER, "deletes", "%ld", deletes);
+        COLUMN(&row, NUMBER, "rebalances", "%ld", rebalances);
+        COLUMN(&row, NUMBER, "huge_page_kb", "%zu", huge_kb);
+        COLUMN(&row, NUMBER, "wal_commits_per_sec", "%f",
+               ws.commits / time_taken);
+        COLUMN(&row, NUMBER, "wal_avg_batch", "%f",
+               ws.commits ? (double)ws.records / ws.commits : 0.0);
+        COLUMN(&row, NUMBER, "wal_max_batch", "%" PRIu64, ws.max_batch);
+        COLUMN(&row, NUMBER, "pool_hits", "%" PRIu64, es.pool_hits);
+        COLUMN(&row, NUMBER, "pool_misses", "%" PRIu64, es.pool_misses);
+        COLUMN(&row, NUMBER, "pool_writebacks", "%" PRIu64,
+               es.pool_writebacks);
+        COLUMN(&row, NUMBER, "ckpt_fork_ms", "%f", cs.fork_ms);
+        COLUMN(&row, NUMBER, "ckpt_cow_kb", "%zu", cs.cow_kb);
+        COLUMN(&row, NUMBER, "ckpt_ms", "%f", cs.duration_ms);
+        COLUMN(&row, NUMBER, "replay_mismatches", "%zu", mismatches);
+
+        // Merged latency histograms, reset for the next run
+        bst_hist_t *merged = malloc(sizeof(bst_hist_t));
+        if (merged == NULL) {
+            PANIC("Failed to allocate the latency histograms");
+        }
+
+        for (size_t j = 0; j < OP_TYPES; j++) {
+            bst_hist_reset(merged);
+            for (size_t i = 0; i < threads; i++) {
+                bst_hist_merge(merged, &t_data[i].hist[j]);
+                bst_hist_reset(&t_data[i].hist[j]);
+            }
+
+            const double percentiles[] = {50, 90, 99, 99.9};
+            const char *suffixes[] = {"p50", "p90", "p99", "p999"};
+            char name[32];
+
+            for (size_t k = 0; k < 4; k++) {
+                snprintf(name, sizeof name, "%s_%s_ns", op_name(j),
+                         suffixes[k]);
+                COLUMN(&row, NUMBER, name, "%" PRIu64,
+                       bst_hist_percentile(merged, percentiles[k]));
+            }
+
+            snprintf(name, sizeof name, "%s_max_ns", op_name(j));
+            COLUMN(&row, NUMBER, name, "%" PRIu64, merged->max);
+
+            if (opts->hist_dump != NULL) {
+                for (size_t b = 0; b < BST_HIST_BUCKETS; b++) {
+                    if (merged->buckets[b] != 0) {
+                        fprintf(opts->hist_dump,
+                                "%s,%s,%zu,%s,%" PRIu64 ",%" PRIu64 "\n",
+                                bst_type, strat_type, r, op_name(j),
+                                bst_hist_bucket_max(b), merged->buckets[b]);
+                    }
+                }
+            }
+        }
+
+        free(merged);
+        COLUMN(&row, NUMBER, "ops_per_sec", "%f", performed / time_taken);
+        COLUMN(&row, NUMBER, "fastest_thread_s", "%f", fastest / 1e9);
+        COLUMN(&row, NUMBER, "slowest_thread_s", "%f", slowest / 1e9);
+        COLUMN(&row, NUMBER, "start_skew_us", "%f", (last_start - first) / 1e3);
+        COLUMN(&row, TEXT, "key_dist", "%s", key_dist);
+        COLUMN(&row, NUMBER, "seed", "%" PRIu64, opts->seed);
+
+        // Worker i runs thread i, SMT siblings share package and core
+        char *list = NULL;
+        size_t list_size = 0;
+        FILE *f = open_memstream(&list, &list_size);
+
+        for (size_t i = 0; opts->cpus != NULL && i < threads; i++) {
+            const bst_topo_cpu_t *c = bst_topo_find(opts->topo, opts->cpus[i]);
+
+            fprintf(f, i == 0 ? "%d/%d/%d" : ";%d/%d/%d", c->cpu, c->package,
+                    c->core);
+        }
+
+        fclose(f);
+        COLUMN(&row, TEXT, "cpu_map", "%s", list);
+        free(list);
+
+        add_perf(&row, t_data, threads, performed, opts->perf);
+
+        f = open_memstream(&list, &list_size);
+        for (size_t i = 0; i < sampler.samples; i++) {
+            fprintf(f, i == 0 ? "%.0f" : ";%.0f", sampler.series[i]);
+        }
+
+        fclose(f);
+        COLUMN(&row, LIST, "ops_per_sec_series", "%s", list);
+        free(list);
+        free(sampler.series);
+
+        bst_result_write_csv(&row, stdout);
+        fflush(stdout);
+
+        if (opts->json != NULL) {
+            char finished[32];
+            iso_time(finished, sizeof finished, time(NULL));
+
+            // The options of the test, operations counts the performed ones
+            COLUMN(&row, NUMBER, "requested_operations", "%" PRId64,
+                   operations);
+            COLUMN(&row, NUMBER, "write_prob", "%f", opts->write_prob);
+            COLUMN(&row, NUMBER, "duration", "%" PRId64, opts->duration);
+            COLUMN(&row, NUMBER, "run", "%zu", r);
+            COLUMN(&row, TEXT, "finished_at", "%s", finished);
+
+            if (bst_result_extend(&row, opts->meta) != SUCCESS) {
+                PANIC("Failed to allocate the results");
+            }
+
+            bst_result_write_json(&row, opts->json);
+            fflush(opts->json);
+        }
+
+        bst_result_free(&row);
 
         for (size_t i = 0; i < threads; i++) {
             t_data[i].metrics->inserts = 0;
@@ -619,12 +1769,17 @@ void bst_test(const int64_t operations, const size_t threads,
             t_data[i].metrics->widths = 0;
             t_data[i].metrics->deletes = 0;
             t_data[i].metrics->rebalances = 0;
+            t_data[i].metrics->mismatches = 0;
         }
     }
 
     for (size_t i = 0; i < threads; i++) {
         free(t_data[i].metrics);
+        free(t_data[i].replay);
+        free(t_data[i].hist);
     }
+
+    free(progress);
 }
 
 int main(const int argc, char **argv) {
@@ -632,15 +1787,125 @@ int main(const int argc, char **argv) {
     float write_prob = 0.5;
     enum bst_type type = 0;
     enum test_strat strat = 0;
+    const char *wal_path = NULL;
+    int64_t frames = BST_PAGED_DEFAULT_FRAMES;
+    const char *checkpoint_path = NULL;
+    const char *key_file = NULL;
+    const char *record_dir = NULL;
+    const char *trace_dir = NULL;
+    int pacing = 0;
+    const char *hist_path = NULL;
+    const char *dist_name = "uniform";
+    int dist_set = 0;
+    int64_t duration = 0;
+    uint64_t seed = mix(clock(), time(NULL), getpid());
+    int placement = 0;
+    const char *cpu_list = NULL;
+    int perf = 0;
+    int info = 0;
+    const char *json_path = NULL;
+    const char *placement_name = "";
+    const bst_engine_ops *plugins[argc];
+    size_t plugin_count = 0;
+    bst_dist_t dist;
+    parse_dist(&dist, dist_name);
 
     opterr = 0;
 
     int c;
-    while ((c = getopt(argc, argv, "hn:o:t:r:s:glca")) != -1)
+    while ((c = getopt(argc, argv,
+                       "hiHPew:b:C:f:R:T:L:D:S:A:E:j:d:n:o:t:r:s:glcap")) != -1)
         switch (c) {
         case 'h':
             fprintf(stdout, "%s", usage());
             exit(0);
+        case 'i':
+            info = 1;
+            break;
+        case 'H':
+            bst_arena_set_mode(BST_ARENA_HUGEPAGES);
+            break;
+        case 'w':
+            wal_path = optarg;
+            break;
+        case 'C':
+            checkpoint_path = optarg;
+            break;
+        case 'f':
+            key_file = optarg;
+            break;
+        case 'R':
+            record_dir = optarg;
+            break;
+        case 'T':
+            trace_dir = optarg;
+            break;
+        case 'P':
+            pacing = 1;
+            break;
+        case 'e':
+            perf = 1;
+            break;
+        case 'E':
+            plugins[plugin_count++] = load_engine(optarg);
+            break;
+        case 'j':
+            json_path = optarg;
+            break;
+        case 'L':
+            hist_path = optarg;
+            break;
+        case 'D':
+            if (str2int(&duration, optarg) != STR2LLINT_SUCCESS) {
+                PANIC("Invalid value for option -D");
+            }
+
+            if (duration < 1) {
+                PANIC("Invalid value for option -D");
+            }
+
+            break;
+        case 'S': {
+            int64_t s;
+            if (str2int(&s, optarg) != STR2LLINT_SUCCESS) {
+                PANIC("Invalid value for option -S");
+            }
+
+            seed = (uint64_t)s;
+            break;
+        }
+        case 'A':
+            if (strcmp(optarg, "compact") == 0) {
+                placement = BST_TOPO_COMPACT;
+            } else if (strcmp(optarg, "scatter") == 0) {
+                placement = BST_TOPO_SCATTER;
+            } else if (strncmp(optarg, "list:", 5) == 0) {
+                placement = BST_TOPO_LIST;
+                cpu_list = optarg + 5;
+            } else {
+                PANIC("Invalid value for option -A");
+            }
+
+            placement_name = optarg;
+            break;
+        case 'd':
+            if (!parse_dist(&dist, optarg)) {
+                PANIC("Invalid value for option -d");
+            }
+
+            dist_name = optarg;
+            dist_set = 1;
+            break;
+        case 'b':
+            if (str2int(&frames, optarg) != STR2LLINT_SUCCESS) {
+                PANIC("Invalid value for option -b");
+            }
+
+            if (frames < BST_PAGED_MIN_FRAMES) {
+                PANIC("Invalid value for option -b");
+            }
+
+            break;
         case 'n':
             if (str2int(&operations, optarg) != STR2LLINT_SUCCESS) {
                 PANIC("Invalid value for option -n");
@@ -707,6 +1972,17 @@ int main(const int argc, char **argv) {
                 break;
             }
 
+            if (strncmp(optarg, "replay", 6) == 0) {
+                strat = strat | REPLAY;
+                break;
+            }
+
+            if (strncmp(optarg, "ycsb_", 5) == 0 && optarg[5] >= 'a' &&
+                optarg[5] <= 'f' && optarg[6] == '\0') {
+                strat = strat | (YCSB_A << (optarg[5] - 'a'));
+                break;
+            }
+
             PANIC("Invalid value for option -s");
         case 'g':
             type = type | CGL;
@@ -720,8 +1996,37 @@ int main(const int argc, char **argv) {
         case 'a':
             type = type | AT;
             break;
+        case 'p':
+            type = type | PAGED;
+            break;
         case '?':
-            if (optopt == 'o') {
+            if (optopt == 'w') {
+                PANIC("Option -w requires an argument.");
+            } else if (optopt == 'b') {
+                PANIC("Option -b requires an argument.");
+            } else if (optopt == 'C') {
+                PANIC("Option -C requires an argument.");
+            } else if (optopt == 'f') {
+                PANIC("Option -f requires an argument.");
+            } else if (optopt == 'R') {
+                PANIC("Option -R requires an argument.");
+            } else if (optopt == 'T') {
+                PANIC("Option -T requires an argument.");
+            } else if (optopt == 'L') {
+                PANIC("Option -L requires an argument.");
+            } else if (optopt == 'D') {
+                PANIC("Option -D requires an argument.");
+            } else if (optopt == 'S') {
+                PANIC("Option -S requires an argument.");
+            } else if (optopt == 'A') {
+                PANIC("Option -A requires an argument.");
+            } else if (optopt == 'E') {
+                PANIC("Option -E requires an argument.");
+            } else if (optopt == 'j') {
+                PANIC("Option -j requires an argument.");
+            } else if (optopt == 'd') {
+                PANIC("Option -d requires an argument.");
+            } else if (optopt == 'o') {
                 PANIC("Option -o requires an argument.");
             } else if (optopt == 'n') {
                 PANIC("Option -n requires an argument.");
@@ -742,11 +2047,16 @@ int main(const int argc, char **argv) {
             abort();
         }
 
-    if (operations == 0) {
+    if (info) {
+        print_build_info(plugins, plugin_count);
+        exit(0);
+    }
+
+    if (operations == 0 && key_file == NULL && strat != REPLAY) {
         PANIC("Number of operations not set.")
     }
 
-    if (type == 0) {
+    if (type == 0 && plugin_count == 0) {
         PANIC("BST type not set.")
     }
 
@@ -754,82 +2064,246 @@ int main(const int argc, char **argv) {
         PANIC("Test strategy type not set.")
     }
 
-    int64_t *values = malloc(sizeof *values * operations);
+    bst_trace_t **replay = NULL;
+    size_t replay_count = 0;
+    size_t replay_ops = 0;
+    uint64_t replay_base = UINT64_MAX;
 
-    for (int64_t i = 0; i < operations; i++) {
-        values[i] = i;
-    }
+    if ((strat & REPLAY) == REPLAY) {
+        if (trace_dir == NULL) {
+            PANIC("Strategy replay requires option -T.")
+        }
 
-    fisher_yates_shuffle(operations, values);
+        // Recording truncates the traces being replayed
+        struct stat rs, ts;
+        if (record_dir != NULL && stat(record_dir, &rs) == 0 &&
+            stat(trace_dir, &ts) == 0 && rs.st_dev == ts.st_dev &&
+            rs.st_ino == ts.st_ino) {
+            PANIC("Options -R and -T must name different directories.")
+        }
 
-    // Execute possible combinations per strat
-    if ((type & ST) == ST && (strat & INSERT) == INSERT) {
-        bst_test(operations, 1, ST, INSERT, repeat, values, write_prob);
-    }
+        // Traces are numbered from 0 up to the first missing one
+        for (;;) {
+            char path[PATH_MAX];
+            trace_path(path, sizeof path, trace_dir, replay_count);
 
-    if ((type & ST) == ST && (strat & WRITE) == WRITE) {
-        bst_test(operations, 1, ST, WRITE, repeat, values, write_prob);
-    }
+            if (access(path, F_OK) != 0) {
+                break;
+            }
 
-    if ((type & ST) == ST && (strat & READ) == READ) {
-        bst_test(operations, 1, ST, READ, repeat, values, write_prob);
-    }
+            replay =
+                realloc(replay, sizeof(bst_trace_t *) * (replay_count + 1));
+            if (replay == NULL) {
+                PANIC("Failed to allocate the traces of option -T");
+            }
 
-    if ((type & ST) == ST && (strat & READ_WRITE) == READ_WRITE) {
-        bst_test(operations, 1, ST, READ_WRITE, repeat, values, write_prob);
-    }
+            bst_trace_t *trace = bst_trace_open(path, NULL);
+            if (trace == NULL) {
+                PANIC("Failed to open a trace of option -T");
+            }
 
-    if ((type & CGL) == CGL && (strat & INSERT) == INSERT) {
-        bst_test(operations, threads, CGL, INSERT, repeat, values, write_prob);
+            if (bst_trace_count(trace) > 0 &&
+                bst_trace_at(trace, 0)->time_ns < replay_base) {
+                replay_base = bst_trace_at(trace, 0)->time_ns;
+            }
+
+            replay[replay_count++] = trace;
+            replay_ops += bst_trace_count(trace);
+        }
+
+        if (replay_count == 0) {
+            PANIC("No traces found in the directory of option -T.")
+        }
     }
 
-    if ((type & CGL) == CGL && (strat & WRITE) == WRITE) {
-        bst_test(operations, threads, CGL, WRITE, repeat, values, write_prob);
+    // The shuffle and then every test thread draw from their own stream
+    bst_rand_t rng;
+    bst_rand_seed(&rng, seed);
+
+    bst_keys_t imported = {0};
+    int64_t *generated = NULL;
+    const int64_t *values = NULL;
+
+    if (key_file != NULL) {
+        // Loaded before any test, it is not timed
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if ((bst_keys_load(key_file, cpus > 0 ? cpus : 1, &imported) &
+             SUCCESS) != SUCCESS) {
+            PANIC("Failed to load the keys of option -f");
+        }
+
+        if (imported.count == 0) {
+            PANIC("No keys in the file of option -f");
+        }
+
+        if (operations == 0) {
+            operations = imported.count;
+        }
+
+        if ((size_t)operations > imported.count) {
+            PANIC("Option -n exceeds the number of keys of option -f");
+        }
+
+        values = imported.keys;
+    } else if (operations > 0) {
+        generated = malloc(sizeof *generated * operations);
+
+        for (int64_t i = 0; i < operations; i++) {
+            generated[i] = i;
+        }
+
+        fisher_yates_shuffle(operations, generated, &rng);
+        values = generated;
     }
 
-    if ((type & CGL) == CGL && (strat & READ) == READ) {
-        bst_test(operations, threads, CGL, READ, repeat, values, write_prob);
+    bst_rand_jump(&rng);
+
+    FILE *hist_dump = NULL;
+
+    if (hist_path != NULL) {
+        hist_dump = fopen(hist_path, "w");
+        if (hist_dump == NULL) {
+            PANIC("Failed to create the file of option -L");
+        }
+
+        fprintf(hist_dump, "bst_type,strategy,run,op,latency_ns,count\n");
     }
 
-    if ((type & CGL) == CGL && (strat & READ_WRITE) == READ_WRITE) {
-        bst_test(operations, threads, CGL, READ_WRITE, repeat, values,
-                 write_prob);
+    if (perf) {
+        bst_perf_t probe;
+
+        if (bst_perf_open(&probe) != SUCCESS) {
+            PANIC("Performance counters are unavailable for option -e");
+        }
+
+        if (!bst_perf_available(&probe, BST_PERF_CYCLES)) {
+            ERROR("No hardware performance counters, option -e only counts "
+                  "software events\n");
+        }
+
+        bst_perf_close(&probe);
     }
 
-    if ((type & FGL) == FGL && (strat & INSERT) == INSERT) {
-        bst_test(operations, threads, FGL, INSERT, repeat, values, write_prob);
+    FILE *json = NULL;
+    bst_result_t meta = {0};
+
+    if (json_path != NULL) {
+        json = fopen(json_path, "w");
+        if (json == NULL) {
+            PANIC("Failed to create the file of option -j");
+        }
+
+        result_meta(&meta, argc, argv, placement_name);
     }
 
-    if ((type & FGL) == FGL && (strat & WRITE) == WRITE) {
-        bst_test(operations, threads, FGL, WRITE, repeat, values, write_prob);
+    const size_t workers =
+        (size_t)threads > replay_count ? (size_t)threads : replay_count;
+    bst_topo_t topo = {0};
+    int *cpus = NULL;
+
+    if (placement != 0) {
+        if (bst_topo_load(BST_TOPO_SYSFS, &topo) != SUCCESS) {
+            PANIC("Failed to read the CPU topology of option -A");
+        }
+
+        cpus = malloc(sizeof(int) * workers);
+        if (cpus == NULL) {
+            PANIC("Failed to allocate the CPUs of option -A");
+        }
+
+        if (bst_topo_place(&topo, placement, cpu_list, workers, cpus) !=
+            SUCCESS) {
+            PANIC("Invalid CPU list for option -A");
+        }
     }
 
-    if ((type & FGL) == FGL && (strat & READ) == READ) {
-        bst_test(operations, threads, FGL, READ, repeat, values, write_prob);
+    const test_options opts = {
+        .repeat = repeat,
+        .write_prob = write_prob,
+        .wal_path = wal_path,
+        .frames = frames,
+        .checkpoint_path = checkpoint_path,
+        .record_dir = record_dir,
+        .replay = replay,
+        .replay_count = replay_count,
+        .replay_base = replay_base,
+        .pacing = pacing,
+        .hist_dump = hist_dump,
+        .pool = worker_pool_new(workers, cpus, perf),
+        .dist = dist,
+        .dist_name = dist_name,
+        .dist_set = dist_set,
+        .duration = duration,
+        .seed = seed,
+        .streams = &rng,
+        .topo = &topo,
+        .cpus = cpus,
+        .perf = perf,
+        .json = json,
+        .meta = &meta,
+    };
+
+    // The selected built-in engines and then the plugins
+    const bst_engine_ops *engines[BUILTIN_ENGINES + plugin_count];
+    size_t engine_count = 0;
+
+    for (size_t i = 0; i < BUILTIN_ENGINES; i++) {
+        if ((type & builtin_engines[i].type) == builtin_engines[i].type) {
+            engines[engine_count++] = builtin_engines[i].engine;
+        }
     }
 
-    if ((type & FGL) == FGL && (strat & READ_WRITE) == READ_WRITE) {
-        bst_test(operations, threads, FGL, READ_WRITE, repeat, values,
-                 write_prob);
+    for (size_t i = 0; i < plugin_count; i++) {
+        engines[engine_count++] = plugins[i];
     }
 
-    if ((type & AT) == AT && (strat & INSERT) == INSERT) {
-        bst_test(operations, threads, AT, INSERT, repeat, values, write_prob);
+    // Execute possible combinations per strat
+    const enum test_strat strats[] = {
+        INSERT, WRITE,  READ,   READ_WRITE, REPLAY, YCSB_A,
+        YCSB_B, YCSB_C, YCSB_D, YCSB_E,     YCSB_F,
+    };
+
+    for (size_t i = 0; i < engine_count; i++) {
+        for (size_t j = 0; j < sizeof strats / sizeof strats[0]; j++) {
+            const bst_engine_ops *e = engines[i];
+            const enum test_strat st = strats[j];
+
+            if ((strat & st) != st) {
+                continue;
+            }
+
+            // Single threaded engines run one thread, replay a thread per
+            // trace
+            const size_t n = !e->threaded   ? 1
+                             : st == REPLAY ? replay_count
+                                            : (size_t)threads;
+
+            bst_test(st == REPLAY ? (int64_t)replay_ops : operations, n, e, st,
+                     values, &opts);
+        }
     }
 
-    if ((type & AT) == AT && (strat & WRITE) == WRITE) {
-        bst_test(operations, threads, AT, WRITE, repeat, values, write_prob);
+    for (size_t i = 0; i < replay_count; i++) {
+        bst_trace_close(&replay[i]);
     }
 
-    if ((type & AT) == AT && (strat & READ) == READ) {
-        bst_test(operations, threads, AT, READ, repeat, values, write_prob);
+    worker_pool_free(opts.pool);
+
+    if (hist_dump != NULL && fclose(hist_dump) != 0) {
+        PANIC("Failed to write the file of option -L");
     }
 
-    if ((type & AT) == AT && (strat & READ_WRITE) == READ_WRITE) {
-        bst_test(operations, threads, AT, READ_WRITE, repeat, values,
-                 write_prob);
+    if (json != NULL && fclose(json) != 0) {
+        PANIC("Failed to write the file of option -j");
     }
 
-    free(values);
+    bst_result_free(&meta);
+
+    free(cpus);
+    bst_topo_free(&topo);
+    free(replay);
+    free(generated);
+    bst_keys_free(&imported);
     return 0;
 }